@@ -1,39 +1,70 @@
 #include "ara.h"
-#include "raylib.h"
-#include <cstdint>
-#include <iostream>
-#include <cmath>
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <chrono>
 
-void ARA::improve_path() {
-    while (!m_opened.empty() && m_g[coord_to_idx(m_to)] > m_opened.top().fvalue) {
-        PositionWithFvalue bestToExpand = m_opened.top();
-        m_opened.pop();
+ARA::ARA(const char *input, int width, int height,
+         Position from, Position to,
+         float initial_weight, float weight_decrease,
+         std::function<float(Position, Position)> heuristic)
+    : m_h(heuristic), m_input(input), m_width(width), m_height(height),
+      m_from(from), m_to(to), m_weight(initial_weight), m_weight_decrease(weight_decrease)
+{
+    const size_t size = size_t(width) * size_t(height);
+    m_ctx.begin(size_t(width), size_t(height));
+    m_incons_bits.assign((size + 63) / 64, 0);
+    const size_t fromIdx = coord_to_idx(m_from);
+    m_ctx.set(fromIdx, 0.f, -1);
+    m_ctx.open.push(uint32_t(fromIdx), open_key(fromIdx, m_weight));
+}
+
+void ARA::add_incons(size_t idx) {
+    if (is_incons(idx))
+        return;
+    m_incons_bits[idx / 64] |= uint64_t(1) << (idx % 64);
+    m_incons.push_back(uint32_t(idx));
+}
 
-        Position curPos = bestToExpand.pos;
-        m_closed[coord_to_idx(curPos)] = m_closed_marker;
-        m_sum_expanded += 1;
-        m_now_expanded += 1;
+// returns false if the budget ran out before the iteration converged
+bool ARA::improve_path() {
+    using clock = std::chrono::steady_clock;
+    const clock::time_point start = clock::now();
+    const size_t toIdx = coord_to_idx(m_to);
+    float goalG = m_ctx.g(toIdx);
+    IndexedHeap<SearchContext::OpenKey> &open = m_ctx.open;
+    const size_t maxExpanded = m_budget.maxExpanded ? m_budget.maxExpanded : std::numeric_limits<size_t>::max();
+    while (!open.empty() && goalG > open.top_key().f) {
+        if (m_stats.expandedLast >= maxExpanded)
+            return false;
+        // reading the clock every expansion costs more than the expansion itself
+        if ((m_stats.expandedLast & 63) == 63 &&
+            std::chrono::duration<float, std::milli>(clock::now() - start).count() >= m_budget.maxMs)
+            return false;
+
+        const size_t curIdx = open.pop();
+        const Position curPos = idx_to_pos(curIdx);
+        const float curG = m_ctx.g(curIdx);
+        m_ctx.close(curIdx);
+        m_stats.expandedLast += 1;
+        m_stats.expandedTotal += 1;
         auto checkNeighbour = [&](Position p)
         {
             // out of bounds
-            if (p.x < 0 || p.y < 0 || p.x >= int(m_width) || p.y >= int(m_height))
+            if (p.x < 0 || p.y < 0 || p.x >= m_width || p.y >= m_height)
                 return;
-            int idx = coord_to_idx(p);
-            // not empty
-            if (m_input[idx] == '#')
+            const size_t idx = coord_to_idx(p);
+            if (!dungeon::is_passable(m_input[idx]))
                 return;
-            float edgeWeight = m_input[idx] == 'o' ? 10.f : 1.f;
-            float gScore = m_g[coord_to_idx(curPos)] + 1.f * edgeWeight; // we're exactly 1 unit away
-            if (m_g[idx] > gScore)
+            const float gScore = curG + dungeon::move_cost(m_input[idx]);
+            if (m_ctx.g(idx) > gScore)
             {
-                m_g[idx] = gScore;
-                if (m_closed[idx] != m_closed_marker) {
-                    m_opened.push({p, fvalue(p, m_weight)});
-                } else {
-                    m_incons.insert(coord_to_idx(p));
-                }
-                m_prev[idx] = curPos;
-                m_currentFvalueMin = std::min(m_currentFvalueMin, fvalue(p, 1));
+                m_ctx.set(idx, gScore, int(curIdx));
+                if (!m_ctx.is_closed(idx))
+                    open.update(uint32_t(idx), open_key(idx, m_weight));
+                else
+                    add_incons(idx);
+                if (idx == toIdx)
+                    goalG = gScore;
             }
         };
         checkNeighbour({curPos.x + 1, curPos.y + 0});
@@ -41,63 +72,59 @@ void ARA::improve_path() {
         checkNeighbour({curPos.x + 0, curPos.y + 1});
         checkNeighbour({curPos.x + 0, curPos.y - 1});
     }
+    return true;
 }
 
-void ARA::try_improve_path() 
-{
-    improve_path();
-    
-    // Print logs
-    m_e = std::min(m_weight, m_g[coord_to_idx(m_to)] / m_currentFvalueMin);
-    std::cout << "ARA e' = " << m_e << "  weight = " << m_weight << "\n";
-    std::cout << "num opened = " << m_opened.size() << " num incons = " << m_incons.size() << "\n";
-    std::cout << "[path cost = " << calcPathCost(get_path()) << " sum_expanded = " << m_sum_expanded << " now_expanded = " << m_now_expanded << "]\n";
-    m_now_expanded = 0;
+void ARA::finish_iteration() {
+    IndexedHeap<SearchContext::OpenKey> &open = m_ctx.open;
+    const float goalG = m_ctx.g(coord_to_idx(m_to));
+    const bool found = goalG < std::numeric_limits<float>::max();
 
-    // decrease weight
-    m_weight -= m_weight_decrease;
-    m_weight = std::max(m_weight, 1.f);
+    // e' = min(w, g(goal) / min over OPEN and INCONS of g + h)
+    float minF = goalG;
+    for (uint32_t idx : open.ids())
+        minF = std::min(minF, open_key(idx, 1.f).f);
+    for (uint32_t idx : m_incons)
+        minF = std::min(minF, open_key(idx, 1.f).f);
+    m_stats.weight = m_weight;
+    if (found)
+        m_stats.suboptimality = minF > 0.f ? std::min(m_weight, goalG / minF) : 1.f;
+    m_stats.pathCost = found ? goalG : std::numeric_limits<float>::infinity();
+    m_stats.opened = open.size();
+    m_stats.incons = m_incons.size();
+    m_stats.iterations += 1;
+    m_done = m_weight <= 1.f;
 
-    // Update the priorities for all s in OPEN according to fvalue(s)
-    std::vector<Position> openedPositions;
-    openedPositions.reserve(m_opened.size());
-    while(!m_opened.empty()) {
-        openedPositions.push_back(m_opened.top().pos);
-        m_opened.pop();
-    }
-    for (const Position& pos: openedPositions) {
-        m_opened.push({pos, fvalue(pos, m_weight)});
-    }
+    // decrease weight
+    m_weight = std::max(m_weight - m_weight_decrease, 1.f);
 
-    // Move states from INCONS into OPEN (correct weight)
-    for (const int idx : m_incons) {
-        Position pos = idx_to_pos(idx);
-        m_opened.push({pos, fvalue(pos, m_weight)});
+    // Move states from INCONS into OPEN, then update the priorities of all of OPEN in place
+    for (uint32_t idx : m_incons) {
+        m_incons_bits[idx / 64] &= ~(uint64_t(1) << (idx % 64));
+        if (!open.contains(idx))
+            open.push(idx, open_key(idx, m_weight));
     }
     m_incons.clear();
+    open.rekey([&](uint32_t idx) { return open_key(idx, m_weight); });
+}
 
-    // CLOSED = empty
-    m_closed_marker += 1;
+bool ARA::try_improve_path()
+{
+    m_stats.expandedLast = 0;
+    // CLOSED = empty, done before the search rather than after it
+    // so CLOSED of the last iteration stays available for visualisation
+    if (!m_in_progress)
+        m_ctx.reset_closed();
+    m_in_progress = !improve_path();
+    m_stats.budgetExhausted = m_in_progress;
+    if (!m_in_progress)
+        finish_iteration();
+    return !m_in_progress;
 }
 
 std::vector<Position> ARA::get_path()
 {
-    Position curPos = m_to;
-    std::vector<Position> res = {curPos};
-    while (m_prev[coord_to_idx(curPos)] != Position{-1, -1})
-    {
-        curPos = m_prev[coord_to_idx(curPos)];
-        res.insert(res.begin(), curPos);
-    }
+    std::vector<Position> res;
+    get_path(res);
     return res;
 }
-
-void ARA::draw_expanded() {
-    for (int i = 0; i < m_closed.size(); ++i) {
-        if (m_closed[i] == m_closed_marker - 1) { // closed in last improve
-            Position expanded_pos = idx_to_pos(i);
-            const Rectangle rect = {float(expanded_pos.x), float(expanded_pos.y), 1.f, 1.f};
-            DrawRectangleRec(rect, Color{uint8_t(m_g[i]), uint8_t(m_g[i]), 0, 100});
-        }
-    }
-}
\ No newline at end of file
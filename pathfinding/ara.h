@@ -1,44 +1,45 @@
 #pragma once
 #include "math.h"
+#include "searchContext.h"
 #include <vector>
 #include <functional>
-#include <stdio.h>
 #include <limits>
-#include <queue>
-#include <unordered_set>
+#include <cstdint>
 
-struct PositionWithFvalue {
-    Position pos;
-    float fvalue;
+// Limits one try_improve_path call, an unfinished iteration resumes on the next call
+struct ARABudget {
+    size_t maxExpanded = std::numeric_limits<size_t>::max(); // 0 means no limit, like the default
+    float maxMs = std::numeric_limits<float>::infinity();
 };
 
-class Compare
-{
-public:
-    bool operator() (const PositionWithFvalue& a, const PositionWithFvalue& b)
-    {
-        return a.fvalue > b.fvalue;
-    }
+struct ARAStats {
+    float weight = 0.f;        // weight of the last finished iteration
+    float suboptimality = std::numeric_limits<float>::infinity(); // e', bound of cost / optimal cost
+    float pathCost = std::numeric_limits<float>::infinity();
+    size_t expandedLast = 0;   // during the last try_improve_path call
+    size_t expandedTotal = 0;
+    size_t opened = 0;
+    size_t incons = 0;
+    size_t iterations = 0;     // finished weight iterations
+    bool budgetExhausted = false; // the last call stopped in the middle of an iteration
 };
 
 class ARA {
-    int coord_to_idx(Position pos) { return pos.x + pos.y * m_width; }
-    Position idx_to_pos(int idx) { return {idx % m_width, idx / m_width}; }
-    void improve_path();
-    float fvalue(Position pos, float weight) {
-        return m_g[coord_to_idx(pos)] + weight * m_h(pos, m_to);
+    size_t coord_to_idx(Position pos) const { return size_t(pos.x + pos.y * m_width); }
+    Position idx_to_pos(size_t idx) const { return {int(idx) % m_width, int(idx) / m_width}; }
+    bool improve_path();
+    void finish_iteration();
+    SearchContext::OpenKey open_key(size_t idx, float weight) const {
+        const float g = m_ctx.g(idx);
+        return {g + weight * m_h(idx_to_pos(idx), m_to), g};
     }
-    // for debug
-    float calcPathCost(const std::vector<Position>& path) {
-        float path_cost = 0;
-        for (int i = 1; i < path.size(); ++i) {
-            float edgeWeight = m_input[coord_to_idx(path[i])] == 'o' ? 10.f : 1.f;
-            path_cost += edgeWeight;
-        }
-        return path_cost;
-    }
-    std::vector<float> m_g;
-    std::function<float(Position, Position)> m_h;  
+    bool is_incons(size_t idx) const { return (m_incons_bits[idx / 64] >> (idx % 64)) & 1u; }
+    void add_incons(size_t idx);
+
+    // g, back pointers, CLOSED and OPEN, kept between try_improve_path calls,
+    // so it can't be shared with other searches
+    SearchContext m_ctx;
+    std::function<float(Position, Position)> m_h;
     const char *m_input;
     int m_width;
     int m_height;
@@ -46,35 +47,30 @@ class ARA {
     Position m_to;
     float m_weight;
     float m_weight_decrease;
-    std::priority_queue<PositionWithFvalue, std::vector<PositionWithFvalue>, Compare> m_opened;
-    std::vector<int> m_closed;
-    int m_closed_marker;
-    std::vector<Position> m_prev;
-    std::unordered_set<int> m_incons;
-    float m_currentFvalueMin;
-    int m_sum_expanded;
-    int m_now_expanded;
-    float m_e;
+    std::vector<uint64_t> m_incons_bits; // INCONS membership
+    std::vector<uint32_t> m_incons;      // INCONS members, to move them to OPEN without a full scan
+    ARABudget m_budget;
+    ARAStats m_stats;
+    bool m_in_progress = false; // an iteration was interrupted by the budget
+    bool m_done = false;        // finished an iteration with weight 1, the path is optimal
 public:
-    ARA(const char *input, int width, int height, 
+    ARA(const char *input, int width, int height,
         Position from, Position to,
         float initial_weight, float weight_decrease,
-        std::function<float(Position, Position)> heuristic) 
-        : m_input(input), m_width(width), m_height(height), m_from(from), m_to(to), m_weight(initial_weight), m_weight_decrease(weight_decrease), m_h(heuristic) 
-    {
-        int input_size = width * height;
-        m_g.resize(input_size, std::numeric_limits<float>::max());
-        m_g[coord_to_idx(m_from)] = 0;
-        m_opened.push({from, fvalue(from, m_weight)});
-        m_closed.resize(input_size, 0);
-        m_closed_marker = 1;
-        m_prev.resize(input_size, {-1,-1});
-        m_currentFvalueMin = std::numeric_limits<float>::max();
-        m_sum_expanded = 0;
-        m_now_expanded = 0;
-        m_e = std::numeric_limits<float>::max();
-    }
-    void try_improve_path();
+        std::function<float(Position, Position)> heuristic);
+    ARA(const ARA &) = delete;
+    ARA &operator=(const ARA &) = delete;
+
+    // runs the current weight iteration within the budget, returns true if it finished
+    bool try_improve_path();
     std::vector<Position> get_path();
-    void draw_expanded();
-};
\ No newline at end of file
+    void get_path(std::vector<Position> &path) const { m_ctx.write_path(coord_to_idx(m_to), path); }
+
+    void set_budget(const ARABudget &budget) { m_budget = budget; }
+    float current_weight() const { return m_weight; }
+    bool done() const { return m_done; }
+    const ARAStats &stats() const { return m_stats; }
+    // for visualisation: nodes closed during the last iteration
+    bool is_expanded_last(Position pos) const { return m_ctx.is_closed(coord_to_idx(pos)); }
+    float g_value(Position pos) const { return m_ctx.g(coord_to_idx(pos)); }
+};
@@ -0,0 +1,602 @@
+// Headless comparison of the grid searches in pathfinding/ and w7 HPA.
+// Generates seeded drunk dungeons, runs every algorithm over the same queries
+// and writes one CSV row per (query, algorithm) to stdout, summary goes to stderr.
+// expanded is -1 for algorithms that don't count expansions, suboptimality is
+// cost / optimal A* cost, status is ok, no_path or budget (IDA* variants ran out of expansions).
+//
+// *_alt algorithms use the ALT heuristic with --landmarks landmarks per map.
+// hpa rows count portals expanded, the summary also gives the abstract search time alone.
+// hpa_cursor walks the same abstract path with HierarchicalPathCursor instead of a BFS per leg.
+// --hpa-edits N flips N random cells per map after the queries and times the HPA graph repair
+// against the full build. Every map then freezes its portal graph and compares memory and
+// portal to portal query time of the builder and the frozen CSR layout.
+// --portal-cache FILE writes every map's w7 portal cache there and compares startup with a cold build.
+// --service-batch N also times one turn of N requests per map (most of them chasing a single
+// goal, some repeated) through PathQueryService against a plain GridAStar loop.
+// --dmap-sizes 50,200,1000 times the w4 Dijkstra map backends on --maps dungeons of each size
+// instead and exits, see bench/dmapBench.h. --dmap-threads 1,4,16 are the job graph thread counts.
+//
+//   pathfinding_bench [--maps N] [--queries N] [--seed N] [--size N]
+//                     [--weight W] [--ida-budget N] [--landmarks K] [--algorithms a,b,c]
+//                     [--hpa-edits N] [--portal-cache FILE] [--service-batch N] [--service-threads N]
+//                     [--dmap-sizes a,b,c] [--dmap-threads a,b,c]
+#include "../math.h"
+#include "../dungeonGen.h"
+#include "../dungeonUtils.h"
+#include "../gridSearch.h"
+#include "../gridAStar.h"
+#include "../ara.h"
+#include "../idaStar.h"
+#include "../jps.h"
+#include "../landmarks.h"
+#include "../pathQueryService.h"
+#include "hpaRunner.h"
+#include "dmapBench.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+struct BenchOptions
+{
+  size_t maps = 10;
+  size_t queries = 20;
+  unsigned seed = 1;
+  size_t width = 100;
+  size_t height = 100;
+  float weight = 2.5f;
+  size_t idaBudget = 1000000;
+  size_t landmarks = 8;
+  size_t hpaEdits = 0;
+  const char *portalCache = nullptr;
+  size_t serviceBatch = 0; // 0 - skip the path service
+  size_t serviceThreads = 4;
+  std::vector<std::string> algorithms; // empty - run all
+  std::vector<size_t> dmapSizes;       // not empty - only the dmap benchmark
+  std::vector<size_t> dmapThreads = {1, 2, 4, 8, 16};
+};
+
+struct BenchMap
+{
+  std::vector<char> tiles;
+  size_t width = 0;
+  size_t height = 0;
+  unsigned seed = 0;
+  std::unique_ptr<HpaRunner> hpa;
+  Landmarks landmarks;
+};
+
+struct QueryResult
+{
+  std::vector<Position> path;
+  long long expanded = -1; // -1 if the algorithm doesn't count expansions
+  bool outOfBudget = false;
+};
+
+struct Algorithm
+{
+  std::string name;
+  std::function<QueryResult(BenchMap &, Position, Position)> run;
+};
+
+static std::vector<Algorithm> make_algorithms(const BenchOptions &opt)
+{
+  std::vector<Algorithm> algos;
+  algos.push_back({"astar_reference", [](BenchMap &m, Position from, Position to)
+  {
+    QueryResult res;
+    SearchStats stats;
+    res.path = find_path_a_star(m.tiles.data(), m.width, m.height, from, to, 1.f, &stats);
+    res.expanded = static_cast<long long>(stats.expanded);
+    return res;
+  }});
+  algos.push_back({"astar", [](BenchMap &m, Position from, Position to)
+  {
+    static GridAStar astar;
+    QueryResult res;
+    res.path = astar.find_path(m.tiles.data(), m.width, m.height, from, to, 1.f);
+    res.expanded = static_cast<long long>(astar.expanded());
+    return res;
+  }});
+  algos.push_back({"astar_alt", [](BenchMap &m, Position from, Position to)
+  {
+    static GridAStar astar;
+    QueryResult res;
+    astar.set_landmarks(&m.landmarks);
+    res.path = astar.find_path(m.tiles.data(), m.width, m.height, from, to, 1.f);
+    res.expanded = static_cast<long long>(astar.expanded());
+    return res;
+  }});
+  algos.push_back({"astar_bidir", [](BenchMap &m, Position from, Position to)
+  {
+    static GridAStar astar;
+    QueryResult res;
+    astar.find_path_bidirectional(m.tiles.data(), m.width, m.height, from, to, res.path);
+    res.expanded = static_cast<long long>(astar.expanded());
+    return res;
+  }});
+  algos.push_back({"astar_bidir_alt", [](BenchMap &m, Position from, Position to)
+  {
+    static GridAStar astar;
+    QueryResult res;
+    astar.set_landmarks(&m.landmarks);
+    astar.find_path_bidirectional(m.tiles.data(), m.width, m.height, from, to, res.path);
+    res.expanded = static_cast<long long>(astar.expanded());
+    return res;
+  }});
+  algos.push_back({"wastar", [weight = opt.weight](BenchMap &m, Position from, Position to)
+  {
+    static GridAStar astar;
+    QueryResult res;
+    res.path = astar.find_path(m.tiles.data(), m.width, m.height, from, to, weight);
+    res.expanded = static_cast<long long>(astar.expanded());
+    return res;
+  }});
+  algos.push_back({"jps", [](BenchMap &m, Position from, Position to)
+  {
+    static SearchContext ctx;
+    QueryResult res;
+    SearchStats stats;
+    find_path_jps(ctx, m.tiles.data(), m.width, m.height, from, to, res.path, &stats);
+    res.expanded = static_cast<long long>(stats.expanded);
+    return res;
+  }});
+  algos.push_back({"jps_alt", [](BenchMap &m, Position from, Position to)
+  {
+    static SearchContext ctx;
+    QueryResult res;
+    SearchStats stats;
+    find_path_jps(ctx, m.tiles.data(), m.width, m.height, from, to, res.path, &stats, &m.landmarks);
+    res.expanded = static_cast<long long>(stats.expanded);
+    return res;
+  }});
+  algos.push_back({"ara_first", [](BenchMap &m, Position from, Position to)
+  {
+    ARA ara(m.tiles.data(), int(m.width), int(m.height), from, to, 5.f, 0.5f, heuristic);
+    ara.try_improve_path();
+    QueryResult res;
+    res.path = ara.get_path();
+    res.expanded = static_cast<long long>(ara.stats().expandedTotal);
+    return res;
+  }});
+  algos.push_back({"ara_final", [](BenchMap &m, Position from, Position to)
+  {
+    ARA ara(m.tiles.data(), int(m.width), int(m.height), from, to, 5.f, 0.5f, heuristic);
+    while (!ara.done())
+      ara.try_improve_path();
+    QueryResult res;
+    res.path = ara.get_path();
+    res.expanded = static_cast<long long>(ara.stats().expandedTotal);
+    return res;
+  }});
+  algos.push_back({"ara_alt_final", [](BenchMap &m, Position from, Position to)
+  {
+    const Landmarks &landmarks = m.landmarks;
+    ARA ara(m.tiles.data(), int(m.width), int(m.height), from, to, 5.f, 0.5f,
+            [&landmarks](Position a, Position b) { return landmarks.heuristic(a, b); });
+    while (!ara.done())
+      ara.try_improve_path();
+    QueryResult res;
+    res.path = ara.get_path();
+    res.expanded = static_cast<long long>(ara.stats().expandedTotal);
+    return res;
+  }});
+  algos.push_back({"ida", [budget = opt.idaBudget](BenchMap &m, Position from, Position to)
+  {
+    QueryResult res;
+    SearchStats stats;
+    res.path = find_ida_star_path(m.tiles.data(), m.width, m.height, from, to, &stats, budget);
+    res.expanded = static_cast<long long>(stats.expanded);
+    res.outOfBudget = res.path.empty() && stats.expanded >= budget;
+    return res;
+  }});
+  algos.push_back({"ida_tt", [budget = opt.idaBudget](BenchMap &m, Position from, Position to)
+  {
+    QueryResult res;
+    SearchStats stats;
+    res.path = find_ida_star_tt_path(m.tiles.data(), m.width, m.height, from, to, &stats, budget);
+    res.expanded = static_cast<long long>(stats.expanded);
+    res.outOfBudget = res.path.empty() && stats.expanded >= budget;
+    return res;
+  }});
+  algos.push_back({"hpa", [](BenchMap &m, Position from, Position to)
+  {
+    QueryResult res;
+    std::vector<GridCell> cells;
+    if (m.hpa->find_path({from.x, from.y}, {to.x, to.y}, cells))
+      for (const GridCell &c : cells)
+        res.path.push_back({c.x, c.y});
+    res.expanded = static_cast<long long>(m.hpa->last_expanded());
+    return res;
+  }});
+  algos.push_back({"hpa_alt", [](BenchMap &m, Position from, Position to)
+  {
+    QueryResult res;
+    std::vector<GridCell> cells;
+    if (m.hpa->find_path({from.x, from.y}, {to.x, to.y}, cells, true))
+      for (const GridCell &c : cells)
+        res.path.push_back({c.x, c.y});
+    res.expanded = static_cast<long long>(m.hpa->last_expanded());
+    return res;
+  }});
+  algos.push_back({"hpa_cursor", [](BenchMap &m, Position from, Position to)
+  {
+    QueryResult res;
+    std::vector<GridCell> cells;
+    if (m.hpa->find_path_cursor({from.x, from.y}, {to.x, to.y}, cells))
+      for (const GridCell &c : cells)
+        res.path.push_back({c.x, c.y});
+    res.expanded = static_cast<long long>(m.hpa->last_expanded());
+    return res;
+  }});
+  for (size_t levels = 1; levels <= hpaMaxLevels; ++levels)
+    algos.push_back({"hpa_l" + std::to_string(levels), [levels](BenchMap &m, Position from, Position to)
+    {
+      QueryResult res;
+      std::vector<GridCell> cells;
+      if (m.hpa->find_path_levels({from.x, from.y}, {to.x, to.y}, cells, levels))
+        for (const GridCell &c : cells)
+          res.path.push_back({c.x, c.y});
+      res.expanded = static_cast<long long>(m.hpa->last_expanded());
+      return res;
+    }});
+
+  if (opt.algorithms.empty())
+    return algos;
+  std::vector<Algorithm> selected;
+  for (const std::string &name : opt.algorithms)
+    for (const Algorithm &algo : algos)
+      if (algo.name == name)
+        selected.push_back(algo);
+  return selected;
+}
+
+// ARA returns a single-cell "path" when the goal is unreachable
+static bool is_valid_path(const std::vector<Position> &path, Position from, Position to)
+{
+  return !path.empty() && path.front() == from && path.back() == to;
+}
+
+struct ServiceSummary
+{
+  double serialUs = 0.0;
+  double serviceUs = 0.0;
+  size_t mismatches = 0; // service path cost differs from the serial one beyond the weight bound
+};
+
+// one turn of monsters: 3/4 chase the same goal, every 8th request repeats the previous one
+static void run_service_batch(PathQueryService &service, const BenchMap &m, const BenchOptions &opt, ServiceSummary &summary)
+{
+  std::default_random_engine rng(m.seed * 7919u);
+  const Position player = dungeon::find_walkable_tile(m.tiles.data(), m.width, m.height, rng);
+  std::vector<std::pair<Position, Position>> queries;
+  for (size_t i = 0; i < opt.serviceBatch; ++i)
+  {
+    if (i % 8 == 7)
+    {
+      queries.push_back(queries.back());
+      continue;
+    }
+    const Position from = dungeon::find_walkable_tile(m.tiles.data(), m.width, m.height, rng);
+    queries.push_back({from, i % 4 == 3 ? dungeon::find_walkable_tile(m.tiles.data(), m.width, m.height, rng) : player});
+  }
+
+  static GridAStar astar;
+  std::vector<float> serialCosts;
+  std::vector<Position> path;
+  auto start = std::chrono::steady_clock::now();
+  for (const auto &[from, to] : queries)
+  {
+    astar.find_path(m.tiles.data(), m.width, m.height, from, to, 1.f, path);
+    serialCosts.push_back(calcPathCost(m.tiles.data(), m.width, path));
+  }
+  summary.serialUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+  std::vector<PathHandle> handles;
+  start = std::chrono::steady_clock::now();
+  for (const auto &[from, to] : queries)
+    handles.push_back(service.submit(make_grid_view(m), from, to));
+  service.flush();
+  for (PathHandle handle : handles)
+    service.wait(handle);
+  summary.serviceUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+  for (size_t i = 0; i < handles.size(); ++i)
+  {
+    service.take(handles[i], path);
+    if (calcPathCost(m.tiles.data(), m.width, path) != serialCosts[i])
+      summary.mismatches += 1;
+  }
+}
+
+// comma separated numbers
+static void parse_sizes(const char *val, std::vector<size_t> &sizes)
+{
+  std::string list = val;
+  size_t start = 0;
+  while (start <= list.size())
+  {
+    const size_t end = std::min(list.find(',', start), list.size());
+    if (end > start)
+      sizes.push_back(strtoull(list.substr(start, end - start).c_str(), nullptr, 10));
+    start = end + 1;
+  }
+}
+
+static bool parse_options(int argc, const char **argv, BenchOptions &opt)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    const char *arg = argv[i];
+    const char *val = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!val)
+    {
+      fprintf(stderr, "missing value for %s\n", arg);
+      return false;
+    }
+    ++i;
+    if (!strcmp(arg, "--maps"))
+      opt.maps = strtoull(val, nullptr, 10);
+    else if (!strcmp(arg, "--queries"))
+      opt.queries = strtoull(val, nullptr, 10);
+    else if (!strcmp(arg, "--seed"))
+      opt.seed = unsigned(strtoul(val, nullptr, 10));
+    else if (!strcmp(arg, "--size"))
+      opt.width = opt.height = strtoull(val, nullptr, 10);
+    else if (!strcmp(arg, "--weight"))
+      opt.weight = strtof(val, nullptr);
+    else if (!strcmp(arg, "--ida-budget"))
+      opt.idaBudget = strtoull(val, nullptr, 10);
+    else if (!strcmp(arg, "--landmarks"))
+      opt.landmarks = strtoull(val, nullptr, 10);
+    else if (!strcmp(arg, "--hpa-edits"))
+      opt.hpaEdits = strtoull(val, nullptr, 10);
+    else if (!strcmp(arg, "--portal-cache"))
+      opt.portalCache = val;
+    else if (!strcmp(arg, "--service-batch"))
+      opt.serviceBatch = strtoull(val, nullptr, 10);
+    else if (!strcmp(arg, "--service-threads"))
+      opt.serviceThreads = strtoull(val, nullptr, 10);
+    else if (!strcmp(arg, "--dmap-sizes"))
+      parse_sizes(val, opt.dmapSizes);
+    else if (!strcmp(arg, "--dmap-threads"))
+    {
+      opt.dmapThreads.clear();
+      parse_sizes(val, opt.dmapThreads);
+    }
+    else if (!strcmp(arg, "--algorithms"))
+    {
+      std::string list = val;
+      size_t start = 0;
+      while (start <= list.size())
+      {
+        const size_t end = std::min(list.find(',', start), list.size());
+        if (end > start)
+          opt.algorithms.push_back(list.substr(start, end - start));
+        start = end + 1;
+      }
+    }
+    else
+    {
+      fprintf(stderr, "unknown option %s\n", arg);
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, const char **argv)
+{
+  BenchOptions opt;
+  if (!parse_options(argc, argv, opt))
+    return 1;
+  if (!opt.dmapSizes.empty())
+  {
+    run_dmap_bench(opt.dmapSizes, opt.maps, opt.seed, opt.dmapThreads);
+    return 0;
+  }
+
+  std::vector<Algorithm> algos = make_algorithms(opt);
+  struct Summary
+  {
+    double timeUs = 0.0;
+    double expanded = 0.0;
+    double subopt = 0.0;
+    size_t solved = 0;
+    size_t runs = 0;
+    bool countsExpanded = false;
+  };
+  std::map<std::string, Summary> summary;
+  double landmarksMs = 0.0;
+  size_t landmarksBytes = 0;
+  double hpaBuildMs = 0.0;
+  double hpaRepairMs = 0.0;
+  size_t hpaRebuiltClusters = 0;
+  PortalGraphReport graphReport;
+  PortalCacheReport cacheReport;
+  size_t cacheStaleRejected = 0;
+  HpaSearchTotals hpaSearch[2];
+  double hierarchyMs = 0.0;
+  double cursorNsPerCell = 0.0;
+  size_t hierarchyBytes[hpaMaxLevels] = {};
+  size_t hierarchyPortals[hpaMaxLevels] = {};
+  std::unique_ptr<PathQueryService> service;
+  if (opt.serviceBatch > 0)
+    service = std::make_unique<PathQueryService>(opt.serviceThreads);
+  ServiceSummary serviceSummary;
+
+  // keep map density the same as the 100x100 sandbox settings
+  const size_t areaScale = std::max<size_t>(1, opt.width * opt.height / 10000);
+
+  printf("map,seed,query,from_x,from_y,to_x,to_y,algorithm,time_us,expanded,cost,suboptimality,status\n");
+  for (size_t mapIdx = 0; mapIdx < opt.maps; ++mapIdx)
+  {
+    BenchMap m;
+    m.width = opt.width;
+    m.height = opt.height;
+    m.seed = opt.seed + unsigned(mapIdx);
+    m.tiles.resize(m.width * m.height);
+    gen_drunk_dungeon(m.tiles.data(), m.width, m.height, 24 * areaScale, 100, m.seed, false);
+    spill_drunk_water(m.tiles.data(), m.width, m.height, 8 * areaScale, 10, m.seed);
+    m.hpa = std::make_unique<HpaRunner>(m.tiles.data(), m.width, m.height, opt.landmarks);
+    hpaBuildMs += m.hpa->build_ms();
+    hierarchyMs += m.hpa->hierarchy_build_ms();
+    for (size_t level = 0; level < hpaMaxLevels; ++level)
+    {
+      hierarchyBytes[level] += m.hpa->hierarchy_bytes(level + 1);
+      hierarchyPortals[level] += m.hpa->hierarchy_portals(level);
+    }
+    const auto landmarksStart = std::chrono::steady_clock::now();
+    m.landmarks.build(m.tiles.data(), m.width, m.height, opt.landmarks);
+    landmarksMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - landmarksStart).count();
+    landmarksBytes = m.landmarks.memory_bytes();
+
+    std::default_random_engine rng(m.seed);
+    for (size_t q = 0; q < opt.queries; ++q)
+    {
+      const Position from = dungeon::find_walkable_tile(m.tiles.data(), m.width, m.height, rng);
+      const Position to = dungeon::find_walkable_tile(m.tiles.data(), m.width, m.height, rng);
+      const std::vector<Position> optimalPath = find_path_a_star_heap(m.tiles.data(), m.width, m.height, from, to, 1.f);
+      const float optimalCost = calcPathCost(m.tiles.data(), m.width, optimalPath);
+
+      for (Algorithm &algo : algos)
+      {
+        const auto start = std::chrono::steady_clock::now();
+        QueryResult res = algo.run(m, from, to);
+        const double timeUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        const bool found = is_valid_path(res.path, from, to);
+        const float cost = found ? calcPathCost(m.tiles.data(), m.width, res.path) : 0.f;
+        const double subopt = found && optimalCost > 0.f ? double(cost) / double(optimalCost) : 1.0;
+        const char *status = found ? "ok" : res.outOfBudget ? "budget" : "no_path";
+        printf("%zu,%u,%zu,%d,%d,%d,%d,%s,%.1f,%lld,%.1f,%.4f,%s\n",
+               mapIdx, m.seed, q, from.x, from.y, to.x, to.y, algo.name.c_str(),
+               timeUs, res.expanded, double(cost), subopt, status);
+
+        Summary &s = summary[algo.name];
+        s.runs += 1;
+        s.timeUs += timeUs;
+        s.countsExpanded = res.expanded >= 0;
+        if (found)
+        {
+          s.solved += 1;
+          s.subopt += subopt;
+          s.expanded += double(std::max(res.expanded, 0ll));
+        }
+      }
+    }
+    if (service)
+      run_service_batch(*service, m, opt, serviceSummary);
+    // destructible walls, one cell per repair
+    std::default_random_engine editRng(m.seed + 1);
+    for (size_t e = 0; e < opt.hpaEdits; ++e)
+    {
+      const GridCell cell{int(editRng() % m.width), int(editRng() % m.height)};
+      hpaRebuiltClusters += m.hpa->toggle_cells({cell});
+      hpaRepairMs += m.hpa->last_repair_ms();
+    }
+    cursorNsPerCell += m.hpa->cursor_ns_per_cell();
+    for (bool useLandmarks : {false, true})
+    {
+      const HpaSearchTotals totals = m.hpa->search_totals(useLandmarks);
+      hpaSearch[useLandmarks].searches += totals.searches;
+      hpaSearch[useLandmarks].expanded += totals.expanded;
+      hpaSearch[useLandmarks].searchUs += totals.searchUs;
+      hpaSearch[useLandmarks].findUs += totals.findUs;
+    }
+    // after the edits, so the frozen copy also skips the slots a repair freed
+    const PortalGraphReport report = m.hpa->measure_portal_graphs(std::max<size_t>(opt.queries, 100), m.seed);
+    graphReport.portals += report.portals;
+    graphReport.builderBytes += report.builderBytes;
+    graphReport.frozenBytes += report.frozenBytes;
+    graphReport.fieldBytes += report.fieldBytes;
+    graphReport.fieldCells += report.fieldCells;
+    graphReport.builderQueryUs += report.builderQueryUs;
+    graphReport.frozenQueryUs += report.frozenQueryUs;
+    graphReport.mismatches += report.mismatches;
+    if (opt.portalCache)
+    {
+      const PortalCacheReport cache = m.hpa->measure_portal_cache(opt.portalCache, std::max<size_t>(opt.queries, 100), m.seed);
+      cacheReport.fileBytes += cache.fileBytes;
+      cacheReport.buildMs += cache.buildMs;
+      cacheReport.saveMs += cache.saveMs;
+      cacheReport.mapMs += cache.mapMs;
+      cacheReport.loadMs += cache.loadMs;
+      cacheReport.mismatches += cache.mismatches;
+      cacheStaleRejected += cache.staleRejected;
+    }
+  }
+
+  fprintf(stderr, "hpa: portal graph built in %.2f ms per map\n", hpaBuildMs / double(std::max<size_t>(opt.maps, 1)));
+  if (opt.hpaEdits > 0)
+  {
+    const double edits = double(opt.hpaEdits * std::max<size_t>(opt.maps, 1));
+    fprintf(stderr, "hpa: repair after a cell edit %.3f ms, %.1f clusters rebuilt\n", hpaRepairMs / edits,
+            double(hpaRebuiltClusters) / edits);
+  }
+  {
+    const double perThousand = 1000.0 / double(std::max<size_t>(graphReport.portals, 1));
+    const double maps = double(std::max<size_t>(opt.maps, 1));
+    fprintf(stderr, "hpa: %.0f portals per map, KiB per 1000 portals: builder %.1f, frozen %.1f\n", double(graphReport.portals) / maps,
+            double(graphReport.builderBytes) * perThousand / 1024.0, double(graphReport.frozenBytes) * perThousand / 1024.0);
+    fprintf(stderr, "hpa: portal to portal query builder %.1f us, frozen %.1f us, %zu costs off the Dijkstra optimum\n",
+            graphReport.builderQueryUs / maps, graphReport.frozenQueryUs / maps, graphReport.mismatches);
+    fprintf(stderr, "hpa: distance fields %.1f KiB per map, %.1f B per cell, %.1f KiB per 1000 portals\n",
+            double(graphReport.fieldBytes) / 1024.0 / maps,
+            double(graphReport.fieldBytes) / double(std::max<size_t>(graphReport.fieldCells, 1)),
+            double(graphReport.fieldBytes) * perThousand / 1024.0);
+  }
+  if (opt.portalCache)
+  {
+    const double maps = double(std::max<size_t>(opt.maps, 1));
+    fprintf(stderr, "hpa cache: %.1f KiB per map, cold build %.2f ms, save %.2f ms, mmap %.3f ms, load %.2f ms\n",
+            double(cacheReport.fileBytes) / 1024.0 / maps, cacheReport.buildMs / maps, cacheReport.saveMs / maps,
+            cacheReport.mapMs / maps, cacheReport.loadMs / maps);
+    fprintf(stderr, "hpa cache: %zu cost mismatches, stale cache rejected on %zu of %zu maps\n", cacheReport.mismatches,
+            cacheStaleRejected, opt.maps);
+  }
+  {
+    const double maps = double(std::max<size_t>(opt.maps, 1));
+    fprintf(stderr, "hpa hierarchy: built in %.2f ms per map, factor 3\n", hierarchyMs / maps);
+    for (size_t level = 0; level < hpaMaxLevels; ++level)
+      fprintf(stderr, "hpa_l%zu: %.0f portals on the top level, %.1f KiB per map\n", level + 1,
+              double(hierarchyPortals[level]) / maps, double(hierarchyBytes[level]) / 1024.0 / maps);
+  }
+  for (bool useLandmarks : {false, true})
+    if (hpaSearch[useLandmarks].searches > 0)
+    {
+      const HpaSearchTotals &totals = hpaSearch[useLandmarks];
+      fprintf(stderr, "%s: abstract search %.1f us of %.1f us in find_path, %.1f portals expanded\n",
+              useLandmarks ? "hpa_alt" : "hpa", totals.searchUs / double(totals.searches),
+              totals.findUs / double(totals.searches), double(totals.expanded) / double(totals.searches));
+    }
+  if (cursorNsPerCell > 0.0)
+    fprintf(stderr, "hpa_cursor: %.1f ns per cell walked\n", cursorNsPerCell / double(std::max<size_t>(opt.maps, 1)));
+  fprintf(stderr, "landmarks: %zu per map, %.2f ms to build, %zu KiB\n", opt.landmarks,
+          landmarksMs / double(std::max<size_t>(opt.maps, 1)), landmarksBytes / 1024);
+  fprintf(stderr, "%-18s %12s %12s %10s %8s\n", "algorithm", "mean_us", "mean_exp", "subopt", "solved");
+  for (const Algorithm &algo : algos)
+  {
+    const Summary &s = summary[algo.name];
+    const double solved = double(std::max<size_t>(s.solved, 1));
+    fprintf(stderr, "%-18s %12.1f %12.1f %10.4f %4zu/%zu\n", algo.name.c_str(),
+            s.timeUs / double(std::max<size_t>(s.runs, 1)), s.countsExpanded ? s.expanded / solved : -1.0,
+            s.subopt / solved, s.solved, s.runs);
+  }
+  if (service)
+  {
+    const PathServiceStats st = service->stats();
+    const double maps = double(std::max<size_t>(opt.maps, 1));
+    fprintf(stderr, "path service: %zu requests per turn, %zu threads, serial %.1f us, service %.1f us per turn\n",
+            opt.serviceBatch, service->threads(), serviceSummary.serialUs / maps, serviceSummary.serviceUs / maps);
+    fprintf(stderr, "  %zu searches for %zu requests (%zu deduplicated, %zu coalesced), %zu cost mismatches\n",
+            st.searches, st.submitted, st.deduplicated, st.coalesced, serviceSummary.mismatches);
+  }
+  return 0;
+}
@@ -0,0 +1,382 @@
+#include "dmapBench.h"
+#include "../dungeonGen.h"
+#include "../dungeonUtils.h"
+#include "../../w4/dmapEngine.h"
+#include "../../w4/dmapJobs.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+
+using dmaps::DmapBackend;
+using dmaps::DmapSeed;
+using dmaps::invalid_tile_value;
+
+struct DmapBackendInfo
+{
+  const char *name;
+  DmapBackend backend;
+};
+
+static const DmapBackendInfo dmapBackends[] = {
+  {"scan", DmapBackend::Scan},
+  {"queue", DmapBackend::Queue},
+  {"sweep", DmapBackend::Sweep},
+};
+constexpr size_t dmapBackendCount = sizeof(dmapBackends) / sizeof(dmapBackends[0]);
+constexpr size_t dmapKindCount = 5;        // approach, melee, wizard, explore, flee
+constexpr size_t dmapIncrementalKinds = 4; // all but flee, every approach value is a flee seed
+constexpr size_t dmapTurns = 20;
+constexpr size_t dmapMonstersMoved = 2; // per turn, the player moves as well
+constexpr size_t dmapJobRuns = 5;       // job graph runs per map and thread count
+
+// a player and a few monsters, the way w4 process_turn sees them
+struct DmapScene
+{
+  Position player;
+  std::vector<Position> monsters;
+};
+
+// seeds of one w4 map before process_dmap
+struct DmapSeeds
+{
+  const char *name;
+  std::vector<DmapSeed> seeds;
+};
+
+static bool is_floor(const std::vector<char> &tiles, size_t width, size_t height, Position p)
+{
+  return p.x >= 0 && p.y >= 0 && size_t(p.x) < width && size_t(p.y) < height && tiles[size_t(p.y) * width + size_t(p.x)] == dungeon::floor;
+}
+
+static uint32_t cell_of(Position p, size_t width)
+{
+  return uint32_t(size_t(p.y) * width + size_t(p.x));
+}
+
+// gen_wizard_attack_map: a diamond of radius 4 around every enemy
+static void add_wizard_ring(std::vector<DmapSeed> &seeds, Position p, const std::vector<char> &tiles, size_t width, size_t height)
+{
+  const int radius = 4;
+  for (int i = -radius; i <= radius; ++i)
+  {
+    const int j = radius - std::abs(i);
+    for (Position s : {Position{p.x + j, p.y - i}, Position{p.x - j, p.y - i}})
+      if (is_floor(tiles, width, height, s))
+        seeds.push_back({cell_of(s, width), 0.f});
+  }
+}
+
+// approach, melee, wizard and explore seeds, flee comes from the approach map
+static std::vector<DmapSeeds> make_dmap_seeds(const DmapScene &scene, const std::vector<char> &tiles, size_t width, size_t height)
+{
+  std::vector<DmapSeeds> res;
+  res.push_back({"approach", {{cell_of(scene.player, width), 0.f}}});
+
+  res.push_back({"melee", {}});
+  for (Position p : scene.monsters)
+    res.back().seeds.push_back({cell_of(p, width), 0.f});
+
+  res.push_back({"wizard", {}});
+  for (Position p : scene.monsters)
+    add_wizard_ring(res.back().seeds, p, tiles, width, height);
+
+  // gen_explore_map: every tile the player hasn't seen yet, here all but a square around the player
+  res.push_back({"explore", {}});
+  const int seen = 10;
+  for (size_t y = 0; y < height; ++y)
+    for (size_t x = 0; x < width; ++x)
+      if (std::abs(int(x) - scene.player.x) > seen || std::abs(int(y) - scene.player.y) > seen)
+        res.back().seeds.push_back({uint32_t(y * width + x), 0.f});
+  return res;
+}
+
+// the eight maps of w4 process_turn but flee: monsters alternate between the blue and the red team,
+// the first one is the hive, every team attacks the player and the other team
+static std::vector<DmapSeeds> make_turn_seeds(const DmapScene &scene, const std::vector<char> &tiles, size_t width, size_t height)
+{
+  std::vector<DmapSeeds> res = make_dmap_seeds(scene, tiles, width, height);
+  DmapSeeds explore = std::move(res.back());
+  res.resize(1);
+  res.push_back({"hive", {{cell_of(scene.monsters[0], width), 0.f}}});
+  const char *melee[2] = {"blue_melee", "red_melee"};
+  const char *wizard[2] = {"blue_wizard", "red_wizard"};
+  for (size_t team = 0; team < 2; ++team)
+  {
+    DmapSeeds meleeSeeds{melee[team], {{cell_of(scene.player, width), 0.f}}};
+    DmapSeeds wizardSeeds{wizard[team], {}};
+    add_wizard_ring(wizardSeeds.seeds, scene.player, tiles, width, height);
+    for (size_t i = 0; i < scene.monsters.size(); ++i)
+      if (i % 2 != team)
+      {
+        meleeSeeds.seeds.push_back({cell_of(scene.monsters[i], width), 0.f});
+        add_wizard_ring(wizardSeeds.seeds, scene.monsters[i], tiles, width, height);
+      }
+    res.push_back(std::move(meleeSeeds));
+    res.push_back(std::move(wizardSeeds));
+  }
+  res.push_back(std::move(explore));
+  return res;
+}
+
+static void fill_dmap(std::vector<float> &map, size_t count, const std::vector<DmapSeed> &seeds)
+{
+  map.assign(count, invalid_tile_value);
+  for (const DmapSeed &seed : seeds)
+    map[seed.cell] = seed.value;
+}
+
+// the player and a couple of monsters step to a random neighbour, or stay if they rolled a wall
+static void step_scene(DmapScene &scene, const std::vector<char> &tiles, size_t width, size_t height, std::default_random_engine &rng)
+{
+  const Position dirs[4] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+  auto step = [&](Position &p)
+  {
+    const Position d = dirs[rng() % 4];
+    const Position next{p.x + d.x, p.y + d.y};
+    if (is_floor(tiles, width, height, next))
+      p = next;
+  };
+  step(scene.player);
+  for (size_t i = 0; i < dmapMonstersMoved; ++i)
+    step(scene.monsters[rng() % scene.monsters.size()]);
+}
+
+static double elapsed_us(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct DmapTotals
+{
+  double timeUs[dmapBackendCount] = {};
+  size_t mismatches[dmapBackendCount] = {};
+  size_t runs = 0;
+};
+
+struct DmapIncrementalTotals
+{
+  double updateUs = 0.0;
+  double rebuildUs = 0.0; // init_tiles and the queue backend over the same seeds
+  size_t cellsTouched = 0;
+  size_t rebuildCells = 0;
+  size_t mismatches = 0;
+  size_t turns = 0;
+};
+
+struct DmapJobTotals
+{
+  std::vector<double> wallUs; // per thread count
+  std::vector<double> jobsUs;
+  std::vector<size_t> mismatches;
+  size_t runs = 0;
+};
+
+static void flee_from(std::vector<float> &flee, const std::vector<float> &approach)
+{
+  flee = approach;
+  for (float &v : flee)
+    if (v < invalid_tile_value)
+      v *= -1.2f;
+}
+
+// every map of a turn rebuilt in full on DmapJobGraph, flee waits for approach,
+// checked against the same maps built on the calling thread
+static void time_job_graph(size_t size, size_t mapIdx, unsigned seed, const DmapScene &scene, const std::vector<char> &tiles,
+                           const std::vector<size_t> &threads, DmapJobTotals &totals)
+{
+  const std::vector<DmapSeeds> seeds = make_turn_seeds(scene, tiles, size, size);
+  const size_t count = size * size;
+  // flee last
+  std::vector<std::vector<float>> reference(seeds.size() + 1);
+  for (size_t k = 0; k < seeds.size(); ++k)
+  {
+    fill_dmap(reference[k], count, seeds[k].seeds);
+    dmaps::process_dmap(reference[k], tiles.data(), size, size);
+  }
+  flee_from(reference.back(), reference[0]);
+  dmaps::process_dmap(reference.back(), tiles.data(), size, size);
+
+  totals.wallUs.resize(threads.size());
+  totals.jobsUs.resize(threads.size());
+  totals.mismatches.resize(threads.size());
+  std::vector<std::vector<float>> maps(reference.size());
+  for (size_t t = 0; t < threads.size(); ++t)
+  {
+    dmaps::DmapJobGraph graph(threads[t]);
+    double wallUs = 0.0;
+    double jobsUs = 0.0;
+    size_t mismatches = 0;
+    for (size_t run = 0; run < dmapJobRuns; ++run)
+    {
+      size_t approachJob = 0;
+      for (size_t k = 0; k < seeds.size(); ++k)
+      {
+        const size_t job = graph.add([&, k]()
+        {
+          fill_dmap(maps[k], count, seeds[k].seeds);
+          dmaps::process_dmap(maps[k], tiles.data(), size, size);
+        });
+        if (k == 0)
+          approachJob = job;
+      }
+      graph.add([&]()
+      {
+        flee_from(maps.back(), maps[0]);
+        dmaps::process_dmap(maps.back(), tiles.data(), size, size);
+      }, {approachJob});
+      graph.run();
+      wallUs += graph.last_run_us();
+      jobsUs += graph.last_jobs_us();
+      for (size_t k = 0; k < maps.size(); ++k)
+        mismatches += memcmp(maps[k].data(), reference[k].data(), count * sizeof(float)) != 0;
+    }
+    printf("%zu,%zu,%u,turn,jobs%zu,%.1f,%zu,%zu\n", size, mapIdx, seed, threads[t], wallUs / dmapJobRuns,
+           count * maps.size(), mismatches);
+    totals.wallUs[t] += wallUs / dmapJobRuns;
+    totals.jobsUs[t] += jobsUs / dmapJobRuns;
+    totals.mismatches[t] += mismatches;
+  }
+  totals.runs += 1;
+}
+
+static void time_dmap(size_t size, size_t mapIdx, unsigned seed, const char *name, const std::vector<float> &seeded,
+                      const std::vector<char> &tiles, std::vector<float> &reference, DmapTotals &totals)
+{
+  std::vector<float> map;
+  for (size_t b = 0; b < dmapBackendCount; ++b)
+  {
+    map = seeded;
+    const auto start = std::chrono::steady_clock::now();
+    dmaps::process_dmap(map, tiles.data(), size, size, dmapBackends[b].backend);
+    const double timeUs = elapsed_us(start);
+    if (b == 0)
+      reference = map;
+    const bool mismatch = memcmp(map.data(), reference.data(), map.size() * sizeof(float)) != 0;
+    printf("%zu,%zu,%u,%s,%s,%.1f,%zu,%d\n", size, mapIdx, seed, name, dmapBackends[b].name, timeUs, map.size(), int(mismatch));
+    totals.timeUs[b] += timeUs;
+    totals.mismatches[b] += mismatch;
+  }
+  totals.runs += 1;
+}
+
+// the scene walks for dmapTurns turns, IncrementalDmap repairs every map and is checked against a full rebuild
+static void time_incremental(size_t size, size_t mapIdx, unsigned seed, DmapScene scene, const std::vector<char> &tiles,
+                             std::default_random_engine &rng, DmapIncrementalTotals *totals)
+{
+  const size_t count = size * size;
+  dmaps::IncrementalDmap dmaps[dmapIncrementalKinds];
+  std::vector<DmapSeeds> seeds = make_dmap_seeds(scene, tiles, size, size);
+  for (size_t k = 0; k < dmapIncrementalKinds; ++k)
+  {
+    dmaps[k].reset(size, size);
+    dmaps[k].set_seeds(seeds[k].seeds);
+    dmaps[k].update(tiles.data());
+  }
+  std::vector<float> rebuilt;
+  for (size_t turn = 0; turn < dmapTurns; ++turn)
+  {
+    step_scene(scene, tiles, size, size, rng);
+    seeds = make_dmap_seeds(scene, tiles, size, size);
+    for (size_t k = 0; k < dmapIncrementalKinds; ++k)
+    {
+      auto start = std::chrono::steady_clock::now();
+      dmaps[k].set_seeds(seeds[k].seeds);
+      dmaps[k].update(tiles.data());
+      const double updateUs = elapsed_us(start);
+
+      start = std::chrono::steady_clock::now();
+      fill_dmap(rebuilt, count, seeds[k].seeds);
+      dmaps::process_dmap(rebuilt, tiles.data(), size, size);
+      const double rebuildUs = elapsed_us(start);
+
+      const bool mismatch = memcmp(rebuilt.data(), dmaps[k].map().data(), count * sizeof(float)) != 0;
+      printf("%zu,%zu,%u,%s,incremental,%.1f,%zu,%d\n", size, mapIdx, seed, seeds[k].name, updateUs, dmaps[k].cells_touched(), int(mismatch));
+      totals[k].updateUs += updateUs;
+      totals[k].rebuildUs += rebuildUs;
+      totals[k].cellsTouched += dmaps[k].cells_touched();
+      totals[k].rebuildCells += count;
+      totals[k].mismatches += mismatch;
+      totals[k].turns += 1;
+    }
+  }
+}
+
+void run_dmap_bench(const std::vector<size_t> &sizes, size_t maps, unsigned seed, const std::vector<size_t> &threads)
+{
+  printf("size,map,seed,dmap,backend,time_us,cells,mismatch\n");
+  fprintf(stderr, "dmap sweep kernel: %s\n", dmaps::dmap_sweep_isa());
+  for (size_t size : sizes)
+  {
+    DmapTotals totals[dmapKindCount];
+    DmapIncrementalTotals incremental[dmapIncrementalKinds];
+    DmapJobTotals jobs;
+    const char *names[dmapKindCount] = {};
+    for (size_t mapIdx = 0; mapIdx < maps; ++mapIdx)
+    {
+      const unsigned mapSeed = seed + unsigned(mapIdx);
+      // same density as the 100x100 sandbox, w4 dungeons have no water
+      std::vector<char> tiles(size * size);
+      gen_drunk_dungeon(tiles.data(), size, size, std::max<size_t>(1, 24 * size * size / 10000), 100, mapSeed, false);
+
+      std::default_random_engine rng(mapSeed);
+      DmapScene scene;
+      scene.player = dungeon::find_walkable_tile(tiles.data(), size, size, rng);
+      scene.monsters.resize(4 + size * size / 2500);
+      for (Position &p : scene.monsters)
+        p = dungeon::find_walkable_tile(tiles.data(), size, size, rng);
+
+      const std::vector<DmapSeeds> seeds = make_dmap_seeds(scene, tiles, size, size);
+      std::vector<float> seeded;
+      std::vector<float> reference;
+      for (size_t k = 0; k < seeds.size(); ++k)
+      {
+        names[k] = seeds[k].name;
+        fill_dmap(seeded, size * size, seeds[k].seeds);
+        time_dmap(size, mapIdx, mapSeed, seeds[k].name, seeded, tiles, reference, totals[k]);
+        if (k == 0)
+        {
+          // gen_player_flee_map
+          std::vector<float> flee = reference;
+          for (float &v : flee)
+            if (v < invalid_tile_value)
+              v *= -1.2f;
+          names[dmapKindCount - 1] = "flee";
+          time_dmap(size, mapIdx, mapSeed, "flee", flee, tiles, reference, totals[dmapKindCount - 1]);
+        }
+      }
+      time_job_graph(size, mapIdx, mapSeed, scene, tiles, threads, jobs);
+      time_incremental(size, mapIdx, mapSeed, scene, tiles, rng, incremental);
+    }
+    for (size_t k = 0; k < dmapKindCount; ++k)
+    {
+      if (!names[k])
+        continue;
+      const double runs = double(std::max<size_t>(totals[k].runs, 1));
+      fprintf(stderr, "dmap %zux%zu %-8s scan %9.1f us", size, size, names[k], totals[k].timeUs[0] / runs);
+      for (size_t b = 1; b < dmapBackendCount; ++b)
+        fprintf(stderr, ", %s %8.1f us (x%.1f, %zu mismatches)", dmapBackends[b].name, totals[k].timeUs[b] / runs,
+                totals[k].timeUs[0] / std::max(totals[k].timeUs[b], 1e-3), totals[k].mismatches[b]);
+      fprintf(stderr, "\n");
+    }
+    for (size_t k = 0; k < dmapIncrementalKinds; ++k)
+    {
+      const DmapIncrementalTotals &t = incremental[k];
+      const double turns = double(std::max<size_t>(t.turns, 1));
+      fprintf(stderr, "dmap %zux%zu %-8s per turn: incremental %.0f cells %.1f us, rebuild %.0f cells %.1f us, %zu mismatches\n",
+              size, size, names[k], double(t.cellsTouched) / turns, t.updateUs / turns,
+              double(t.rebuildCells) / turns, t.rebuildUs / turns, t.mismatches);
+    }
+    const double runs = double(std::max<size_t>(jobs.runs, 1));
+    // threads past the hardware ones only take turns, their speedups say nothing
+    const size_t hardwareThreads = std::thread::hardware_concurrency();
+    for (size_t t = 0; t < threads.size(); ++t)
+      fprintf(stderr, "dmap %zux%zu turn jobs on %2zu threads %9.1f us, serial %9.1f us (x%.1f), vs 1 thread x%.1f, %zu mismatches%s\n",
+              size, size, threads[t], jobs.wallUs[t] / runs, jobs.jobsUs[t] / runs,
+              jobs.jobsUs[t] / std::max(jobs.wallUs[t], 1e-3), jobs.wallUs[0] / std::max(jobs.wallUs[t], 1e-3), jobs.mismatches[t],
+              threads[t] > hardwareThreads ? ", unverified: more threads than the cpu has" : "");
+  }
+}
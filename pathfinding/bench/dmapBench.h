@@ -0,0 +1,13 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+// Times the w4 dmap engines on `maps` seeded drunk dungeons of every size in `sizes`, seeds laid out
+// like w4 process_turn does. One CSV row per (map, dmap, backend) to stdout, summary to stderr.
+// The scan backend is the reference, mismatches count maps that differ from it in any bit,
+// queue and sweep are timed against it.
+// Then the player and a couple of monsters walk a tile a turn and IncrementalDmap repairs the maps,
+// cells is the number of cells an update touched, checked against a full rebuild.
+// Last, every map of a turn is rebuilt on DmapJobGraph with each of `threads` threads (dmap turn,
+// backend jobsN), the summary gives the speedup over one thread.
+void run_dmap_bench(const std::vector<size_t> &sizes, size_t maps, unsigned seed, const std::vector<size_t> &threads);
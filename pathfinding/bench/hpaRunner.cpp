@@ -0,0 +1,398 @@
+#include "hpaRunner.h"
+#include "../../w7/ecsTypes.h"
+#include "../../w7/hierarchicalPathfinder.h"
+#include "../../w7/portalGraph.h"
+#include "../../w7/portalCache.h"
+#include "../../w7/portalHierarchy.h"
+#include "../search/searchContext.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <random>
+
+struct HpaRunner::Impl
+{
+  DungeonData dd;
+  DungeonPortals portals;
+  FrozenPortalGraph frozen; // refrozen after every repair, the finders search it
+  PortalLandmarks portalLandmarks; // rebuilt with every refreeze
+  HierarchicalPathFinder finder;
+  HierarchicalPathFinder cursorFinder; // its own, find_path would skip the search for the endpoints of `finder`
+  PortalHierarchy hierarchy;
+  MultiLevelPathFinder levelFinder;
+  size_t lastExpanded = 0;
+  double buildMs = 0.0;
+  double hierarchyMs = 0.0;
+  double repairMs = 0.0;
+  size_t cursorCells = 0;
+  double cursorUs = 0.0;
+  HpaSearchTotals totals[2]; // without and with landmarks
+
+  // refinement scratch
+  std::vector<uint32_t> stamp;
+  uint32_t generation = 0;
+  std::vector<int> prev;
+  std::vector<int> queue;
+};
+
+HpaRunner::HpaRunner(const char *tiles, size_t width, size_t height, size_t landmarkCount) : m_impl(std::make_unique<Impl>())
+{
+  DungeonData &dd = m_impl->dd;
+  dd.width = width;
+  dd.height = height;
+  dd.tiles.resize(width * height);
+  for (size_t i = 0; i < width * height; ++i)
+    dd.tiles[i] = tiles[i] == dungeon::wall ? dungeon::wall : dungeon::floor;
+
+  const auto start = std::chrono::steady_clock::now();
+  m_impl->portals = build_portals(dd, 10);
+  m_impl->buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  freeze_portals(m_impl->portals, dd, m_impl->frozen);
+  const auto hierarchyStart = std::chrono::steady_clock::now();
+  m_impl->hierarchy = build_portal_hierarchy(m_impl->portals, dd, hpaMaxLevels);
+  m_impl->hierarchyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - hierarchyStart).count();
+  if (landmarkCount > 0)
+    m_impl->portalLandmarks = build_portal_landmarks(m_impl->frozen, landmarkCount);
+}
+
+HpaRunner::~HpaRunner() = default;
+
+double HpaRunner::build_ms() const
+{
+  return m_impl->buildMs;
+}
+
+size_t HpaRunner::last_expanded() const
+{
+  return m_impl->lastExpanded;
+}
+
+double HpaRunner::hierarchy_build_ms() const
+{
+  return m_impl->hierarchyMs;
+}
+
+size_t HpaRunner::hierarchy_bytes(size_t levels) const
+{
+  return m_impl->hierarchy.memory_bytes(levels);
+}
+
+size_t HpaRunner::hierarchy_portals(size_t level) const
+{
+  return level < m_impl->hierarchy.levels.size() ? m_impl->hierarchy.levels[level].portalCount : 0;
+}
+
+HpaSearchTotals HpaRunner::search_totals(bool useLandmarks) const
+{
+  return m_impl->totals[useLandmarks];
+}
+
+size_t HpaRunner::toggle_cells(const std::vector<GridCell> &cells)
+{
+  DungeonData &dd = m_impl->dd;
+  std::vector<IVec2> changed;
+  for (const GridCell &c : cells)
+  {
+    char &tile = dd.tiles[size_t(c.y) * dd.width + size_t(c.x)];
+    tile = tile == dungeon::wall ? dungeon::floor : dungeon::wall;
+    changed.push_back(IVec2{c.x, c.y});
+  }
+  const auto start = std::chrono::steady_clock::now();
+  const size_t rebuilt = repair_portals(m_impl->portals, dd, changed);
+  m_impl->repairMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  freeze_portals(m_impl->portals, dd, m_impl->frozen);
+  // the hierarchy has no repair of its own
+  m_impl->hierarchy = build_portal_hierarchy(m_impl->portals, dd, hpaMaxLevels);
+  if (m_impl->portalLandmarks.count > 0)
+    m_impl->portalLandmarks = build_portal_landmarks(m_impl->frozen, m_impl->portalLandmarks.count);
+  return rebuilt;
+}
+
+double HpaRunner::last_repair_ms() const
+{
+  return m_impl->repairMs;
+}
+
+// Refines one abstract edge: BFS from cur to the closest cell of the next portal,
+// limited to the clusters both portals touch.
+static bool refine_leg(const DungeonData &dd, const DungeonPortals &dp, const PathPortal &curPortal, const PathPortal &nextPortal,
+                       IVec2 &cur, std::vector<GridCell> &path,
+                       std::vector<uint32_t> &stamp, uint32_t &generation, std::vector<int> &prev, std::vector<int> &queue)
+{
+  const size_t ts = dp.tileSplit;
+  const size_t clustersW = dd.width / ts;
+  auto cluster_of = [&](size_t x, size_t y) { return (y / ts) * clustersW + x / ts; };
+  size_t allowed[4];
+  size_t numAllowed = 0;
+  auto allow_portal = [&](const PathPortal &portal)
+  {
+    const size_t ends[2] = {cluster_of(portal.startX, portal.startY), cluster_of(portal.endX, portal.endY)};
+    for (size_t c : ends)
+      if (std::find(allowed, allowed + numAllowed, c) == allowed + numAllowed)
+        allowed[numAllowed++] = c;
+  };
+  allow_portal(curPortal);
+  allow_portal(nextPortal);
+  auto is_target = [&](size_t x, size_t y)
+  {
+    return x >= nextPortal.startX && x <= nextPortal.endX && y >= nextPortal.startY && y <= nextPortal.endY;
+  };
+
+  generation += 1;
+  queue.clear();
+  const int startIdx = int(size_t(cur.y) * dd.width + size_t(cur.x));
+  stamp[size_t(startIdx)] = generation;
+  prev[size_t(startIdx)] = -1;
+  queue.push_back(startIdx);
+  for (size_t head = 0; head < queue.size(); ++head)
+  {
+    const int idx = queue[head];
+    const size_t x = size_t(idx) % dd.width;
+    const size_t y = size_t(idx) / dd.width;
+    if (is_target(x, y))
+    {
+      const size_t legStart = path.size();
+      for (int i = idx; i != startIdx; i = prev[size_t(i)])
+        path.push_back({i % int(dd.width), i / int(dd.width)});
+      std::reverse(path.begin() + std::ptrdiff_t(legStart), path.end());
+      cur = IVec2{int(x), int(y)};
+      return true;
+    }
+    const int dirs[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    for (const auto &dir : dirs)
+    {
+      const int nx = int(x) + dir[0];
+      const int ny = int(y) + dir[1];
+      if (nx < 0 || ny < 0 || nx >= int(dd.width) || ny >= int(dd.height))
+        continue;
+      const size_t nidx = size_t(ny) * dd.width + size_t(nx);
+      if (stamp[nidx] == generation || dd.tiles[nidx] == dungeon::wall)
+        continue;
+      if (std::find(allowed, allowed + numAllowed, cluster_of(size_t(nx), size_t(ny))) == allowed + numAllowed)
+        continue;
+      stamp[nidx] = generation;
+      prev[nidx] = idx;
+      queue.push_back(int(nidx));
+    }
+  }
+  return false;
+}
+
+// get_detailed_path only descends inside the cluster of the given cell and can stop on
+// plateaus at portals, so the abstract path is refined leg by leg here instead
+template<typename Finder>
+bool HpaRunner::refine_path(const Finder &finder, const std::vector<int> &portalPath, GridCell from, GridCell to, std::vector<GridCell> &path)
+{
+  Impl &impl = *m_impl;
+  const DungeonData &dd = impl.dd;
+  const DungeonPortals &dp = impl.portals;
+  impl.stamp.resize(dd.width * dd.height, 0);
+  impl.prev.resize(dd.width * dd.height, -1);
+  IVec2 cur{from.x, from.y};
+  path.push_back(from);
+  for (size_t i = 1; i < portalPath.size(); ++i)
+    if (!refine_leg(dd, dp, finder.get_portal(dp, size_t(portalPath[i - 1])), finder.get_portal(dp, size_t(portalPath[i])),
+                    cur, path, impl.stamp, impl.generation, impl.prev, impl.queue))
+      return false;
+  return cur == IVec2{to.x, to.y};
+}
+
+bool HpaRunner::find_path(GridCell from, GridCell to, std::vector<GridCell> &path, bool useLandmarks)
+{
+  DungeonData &dd = m_impl->dd;
+  DungeonPortals &dp = m_impl->portals;
+  HierarchicalPathFinder &finder = m_impl->finder;
+
+  path.clear();
+  const auto start = std::chrono::steady_clock::now();
+  finder.find_path(dp, m_impl->frozen, dd, IVec2{from.x, from.y}, IVec2{to.x, to.y}, useLandmarks ? &m_impl->portalLandmarks : nullptr);
+  const double findUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  m_impl->lastExpanded = finder.last_expanded();
+  HpaSearchTotals &totals = m_impl->totals[useLandmarks];
+  totals.searches += 1;
+  totals.expanded += finder.last_expanded();
+  totals.searchUs += finder.last_search_us();
+  totals.findUs += findUs;
+  const std::vector<int> &portalPath = finder.get_path();
+  if (portalPath.empty())
+    return false;
+  return refine_path(finder, portalPath, from, to, path);
+}
+
+bool HpaRunner::find_path_cursor(GridCell from, GridCell to, std::vector<GridCell> &path, size_t chunk)
+{
+  const DungeonData &dd = m_impl->dd;
+  const DungeonPortals &dp = m_impl->portals;
+  HierarchicalPathFinder &finder = m_impl->cursorFinder;
+  path.clear();
+  finder.find_path(dp, m_impl->frozen, dd, IVec2{from.x, from.y}, IVec2{to.x, to.y});
+  m_impl->lastExpanded = finder.last_expanded();
+  if (finder.get_path().empty())
+    return false;
+
+  // what a game agent does: a fixed buffer refilled while it walks
+  IVec2 cells[256];
+  chunk = std::clamp<size_t>(chunk, 1, std::size(cells));
+  const auto start = std::chrono::steady_clock::now();
+  HierarchicalPathCursor cursor(finder, dp, dd, IVec2{from.x, from.y});
+  size_t walked = 0;
+  for (size_t count = cursor.next(cells, chunk); count > 0; count = cursor.next(cells, chunk))
+  {
+    for (size_t i = 0; i < count; ++i)
+      path.push_back({cells[i].x, cells[i].y});
+    walked += count;
+  }
+  m_impl->cursorUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  m_impl->cursorCells += walked;
+  return !path.empty() && path.back().x == to.x && path.back().y == to.y;
+}
+
+double HpaRunner::cursor_ns_per_cell() const
+{
+  return m_impl->cursorCells > 0 ? m_impl->cursorUs * 1000.0 / double(m_impl->cursorCells) : 0.0;
+}
+
+bool HpaRunner::find_path_levels(GridCell from, GridCell to, std::vector<GridCell> &path, size_t levels)
+{
+  MultiLevelPathFinder &finder = m_impl->levelFinder;
+  path.clear();
+  const PortalLandmarks *landmarks = m_impl->portalLandmarks.count > 0 ? &m_impl->portalLandmarks : nullptr;
+  const bool found = finder.find_path(m_impl->hierarchy, m_impl->portals, m_impl->dd, IVec2{from.x, from.y}, IVec2{to.x, to.y}, levels, landmarks);
+  m_impl->lastExpanded = finder.last_expanded();
+  if (!found)
+    return false;
+  return refine_path(finder, finder.get_path(), from, to, path);
+}
+
+// Plain Dijkstra over the builder's conns with its own queue, shares no code with find_portal_path
+static float oracle_cost(const DungeonPortals &dp, uint32_t from, uint32_t to, std::vector<float> &dist)
+{
+  using Entry = std::pair<float, uint32_t>;
+  dist.assign(dp.portals.size(), -1.f);
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+  open.push({0.f, from});
+  while (!open.empty())
+  {
+    const auto [cost, cur] = open.top();
+    open.pop();
+    if (dist[cur] >= 0.f)
+      continue;
+    dist[cur] = cost;
+    if (cur == to)
+      return cost;
+    for (const PortalConnection &conn : dp.portals[cur].conns)
+      if (dist[conn.connIdx] < 0.f)
+        open.push({cost + conn.score, uint32_t(conn.connIdx)});
+  }
+  return -1.f;
+}
+
+PortalGraphReport HpaRunner::measure_portal_graphs(size_t queries, unsigned seed)
+{
+  const DungeonPortals &dp = m_impl->portals;
+  const FrozenPortalGraph &graph = m_impl->frozen;
+  PortalGraphReport report;
+  report.builderBytes = portals_memory_bytes(dp);
+  report.frozenBytes = graph.memory_bytes();
+  report.fieldBytes = cluster_dists_memory_bytes(dp);
+  for (const std::vector<size_t> &indices : dp.tilePortalsIndices)
+    report.fieldCells += indices.size() * dp.tileSplit * dp.tileSplit;
+
+  // border portals are listed by both of their clusters
+  std::vector<uint32_t> live;
+  std::vector<bool> seen(graph.portal_count(), false);
+  for (uint32_t idx : graph.clusterPortals)
+    if (!seen[idx])
+    {
+      seen[idx] = true;
+      live.push_back(idx);
+    }
+  report.portals = live.size();
+  if (live.empty() || queries == 0)
+    return report;
+
+  std::default_random_engine rng(seed);
+  std::vector<std::pair<uint32_t, uint32_t>> pairs(queries);
+  for (auto &pair : pairs)
+    pair = {live[rng() % live.size()], live[rng() % live.size()]};
+
+  // both layouts search with the portal landmarks when the runner has them
+  const PortalLandmarks *landmarks = m_impl->portalLandmarks.count > 0 ? &m_impl->portalLandmarks : nullptr;
+  SearchContext ctx;
+  std::vector<uint32_t> path;
+  std::vector<float> builderCosts(queries, -1.f);
+  // warm up the context so neither layout pays for growing it
+  for (size_t q = 0; q < queries; ++q)
+    find_portal_path(ctx, graph, pairs[q].first, pairs[q].second, path, landmarks);
+  auto start = std::chrono::steady_clock::now();
+  for (size_t q = 0; q < queries; ++q)
+    if (find_portal_path(ctx, dp, pairs[q].first, pairs[q].second, path, landmarks))
+      builderCosts[q] = ctx.g(pairs[q].second);
+  report.builderQueryUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / double(queries);
+
+  start = std::chrono::steady_clock::now();
+  std::vector<float> frozenCosts(queries, -1.f);
+  for (size_t q = 0; q < queries; ++q)
+    if (find_portal_path(ctx, graph, pairs[q].first, pairs[q].second, path, landmarks))
+      frozenCosts[q] = ctx.g(pairs[q].second);
+  report.frozenQueryUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / double(queries);
+
+  std::vector<float> dist;
+  for (size_t q = 0; q < queries; ++q)
+  {
+    const float best = oracle_cost(dp, pairs[q].first, pairs[q].second, dist);
+    report.mismatches += builderCosts[q] != best || frozenCosts[q] != best;
+  }
+  return report;
+}
+
+PortalCacheReport HpaRunner::measure_portal_cache(const char *cachePath, size_t queries, unsigned seed)
+{
+  using Clock = std::chrono::steady_clock;
+  const DungeonData &dd = m_impl->dd;
+  const size_t split = m_impl->portals.tileSplit;
+  PortalCacheReport report;
+
+  auto start = Clock::now();
+  const DungeonPortals built = build_portals(dd, split);
+  report.buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  start = Clock::now();
+  if (!save_portal_cache(cachePath, dd, built))
+    return report;
+  report.saveMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+  MappedPortalCache cache;
+  start = Clock::now();
+  if (!cache.open(cachePath, dd, split))
+    return report;
+  report.mapMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  report.fileBytes = cache.file_size();
+  start = Clock::now();
+  MappedPortalCache loadCache;
+  loadCache.open(cachePath, dd, split);
+  const DungeonPortals loaded = loadCache.to_portals();
+  report.loadMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+  // the mapped frozen graph and the copied out builder against the fresh build
+  SearchContext ctx;
+  std::vector<uint32_t> path;
+  std::default_random_engine rng(seed);
+  const uint32_t count = uint32_t(built.portals.size());
+  for (size_t q = 0; q < queries && count > 0; ++q)
+  {
+    const uint32_t from = uint32_t(rng() % count);
+    const uint32_t to = uint32_t(rng() % count);
+    const float builtCost = find_portal_path(ctx, built, from, to, path) ? ctx.g(to) : -1.f;
+    const float mappedCost = find_portal_path(ctx, cache.graph(), from, to, path) ? ctx.g(to) : -1.f;
+    const float loadedCost = find_portal_path(ctx, loaded, from, to, path) ? ctx.g(to) : -1.f;
+    report.mismatches += mappedCost != builtCost || loadedCost != builtCost;
+  }
+
+  DungeonData edited = dd;
+  edited.tiles[rng() % edited.tiles.size()] ^= dungeon::wall ^ dungeon::floor;
+  MappedPortalCache stale;
+  report.staleRejected = !stale.open(cachePath, edited, split);
+  return report;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+struct GridCell
+{
+  int x = 0;
+  int y = 0;
+};
+
+struct PortalGraphReport
+{
+  size_t portals = 0;         // live border portals
+  size_t builderBytes = 0;    // DungeonPortals
+  size_t frozenBytes = 0;     // FrozenPortalGraph
+  size_t fieldBytes = 0;      // per-portal distance fields of DungeonPortals
+  size_t fieldCells = 0;      // cells stored in them
+  double builderQueryUs = 0.0; // mean portal to portal A* over each representation
+  double frozenQueryUs = 0.0;
+  size_t mismatches = 0;      // pairs where either search's cost differs from a plain Dijkstra
+};
+
+// startup with and without a w7 portal cache file
+struct PortalCacheReport
+{
+  size_t fileBytes = 0;
+  double buildMs = 0.0; // build_portals, a launch without the cache
+  double saveMs = 0.0;
+  double mapMs = 0.0;   // mmap and checks, the frozen graph is usable from here
+  double loadMs = 0.0;  // mmap and a mutable DungeonPortals copied out of it
+  size_t mismatches = 0; // portal pairs the loaded graphs get a different cost for
+  bool staleRejected = false; // the cache refused the map with one tile flipped
+};
+
+// abstract searches run by find_path, summed over the runner's lifetime
+struct HpaSearchTotals
+{
+  size_t searches = 0;
+  size_t expanded = 0;
+  double searchUs = 0.0;
+  double findUs = 0.0; // whole find_path: connecting start and end, search and path fields
+};
+
+// maximum depth of the w7 PortalHierarchy the runner builds
+constexpr size_t hpaMaxLevels = 3;
+
+// Runs w7 HierarchicalPathFinder over a pathfinding/ char grid.
+// Lives in its own translation unit because w7 and pathfinding/ both define Position and math.h.
+// HPA has no notion of water, so 'o' tiles are treated as floor when the portal graph is built.
+class HpaRunner
+{
+  struct Impl;
+  std::unique_ptr<Impl> m_impl;
+
+  template<typename Finder>
+  bool refine_path(const Finder &finder, const std::vector<int> &portalPath, GridCell from, GridCell to, std::vector<GridCell> &path);
+public:
+  // landmarkCount > 0 also builds w7 PortalLandmarks for the ALT bound of the abstract search
+  HpaRunner(const char *tiles, size_t width, size_t height, size_t landmarkCount = 0);
+  ~HpaRunner();
+
+  double build_ms() const;
+  // abstract search + per-leg refinement, false if no path was found
+  bool find_path(GridCell from, GridCell to, std::vector<GridCell> &path, bool useLandmarks = false);
+  // same over the first `levels` levels of the portal hierarchy (MultiLevelPathFinder), bounded by
+  // the portal landmarks when the runner has them
+  bool find_path_levels(GridCell from, GridCell to, std::vector<GridCell> &path, size_t levels);
+  // same abstract search, cells streamed out of a HierarchicalPathCursor `chunk` at a time
+  bool find_path_cursor(GridCell from, GridCell to, std::vector<GridCell> &path, size_t chunk = 64);
+  // mean cursor walk time per cell over every find_path_cursor so far
+  double cursor_ns_per_cell() const;
+  // portals expanded by the last abstract search (all level searches for find_path_levels)
+  size_t last_expanded() const;
+  HpaSearchTotals search_totals(bool useLandmarks) const;
+
+  // flips the cells between wall and floor and repairs the portal graph in place,
+  // returns the number of clusters rebuilt. Landmark tables are rebuilt as well.
+  size_t toggle_cells(const std::vector<GridCell> &cells);
+  double last_repair_ms() const;
+
+  double hierarchy_build_ms() const;
+  size_t hierarchy_bytes(size_t levels) const;
+  size_t hierarchy_portals(size_t level) const;
+
+  // times the same random portal pairs on both layouts and checks their costs against Dijkstra
+  PortalGraphReport measure_portal_graphs(size_t queries, unsigned seed);
+  // writes the current map's cache to cachePath and times a cold build against mapping and loading it
+  PortalCacheReport measure_portal_cache(const char *cachePath, size_t queries, unsigned seed);
+};
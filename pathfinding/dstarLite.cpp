@@ -0,0 +1,211 @@
+#include "dstarLite.h"
+#include "gridSearch.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <limits>
+
+static constexpr float inf = std::numeric_limits<float>::infinity();
+
+float DStarLite::g(uint32_t idx) const
+{
+  return m_touched[idx] == m_generation ? m_g[idx] : inf;
+}
+
+float DStarLite::rhs(uint32_t idx) const
+{
+  return m_touched[idx] == m_generation ? m_rhs[idx] : inf;
+}
+
+void DStarLite::touch(uint32_t idx)
+{
+  if (m_touched[idx] == m_generation)
+    return;
+  m_touched[idx] = m_generation;
+  m_g[idx] = inf;
+  m_rhs[idx] = inf;
+}
+
+// cost of moving onto a tile from any of its neighbours
+float DStarLite::edge_cost(uint32_t to) const
+{
+  return dungeon::is_passable(m_input[to]) ? dungeon::move_cost(m_input[to]) : inf;
+}
+
+DStarLite::Key DStarLite::calc_key(uint32_t idx) const
+{
+  const float minG = std::min(g(idx), rhs(idx));
+  return {minG + heuristic(m_start, to_pos(idx)) + m_km, minG};
+}
+
+void DStarLite::update_vertex(uint32_t idx)
+{
+  touch(idx);
+  m_pendingUpdated += 1;
+  if (idx != to_idx(m_goal))
+  {
+    // rhs = min over successors of c(idx, succ) + g(succ)
+    const Position p = to_pos(idx);
+    float best = inf;
+    auto relax = [&](Position n)
+    {
+      if (!in_bounds(n))
+        return;
+      const uint32_t nIdx = to_idx(n);
+      best = std::min(best, edge_cost(nIdx) + g(nIdx));
+    };
+    relax({p.x + 1, p.y + 0});
+    relax({p.x - 1, p.y + 0});
+    relax({p.x + 0, p.y + 1});
+    relax({p.x + 0, p.y - 1});
+    m_rhs[idx] = best;
+  }
+  if (m_g[idx] != m_rhs[idx])
+    m_open.update(idx, calc_key(idx));
+  else if (m_open.contains(idx))
+    m_open.remove(idx);
+}
+
+void DStarLite::reset(const char *input, size_t width, size_t height, Position from, Position to)
+{
+  m_input = input;
+  m_width = width;
+  m_height = height;
+  m_start = m_last = from;
+  m_goal = to;
+  m_km = 0.f;
+  m_stats = IncrementalStats{};
+  m_pendingUpdated = 0;
+  const size_t size = width * height;
+  if (m_g.size() < size)
+  {
+    m_touched.resize(size, 0);
+    m_g.resize(size);
+    m_rhs.resize(size);
+  }
+  m_open.reset(size);
+  if (++m_generation == 0) // wrapped around, old stamps could alias
+  {
+    std::fill(m_touched.begin(), m_touched.end(), 0);
+    m_generation = 1;
+  }
+  if (!in_bounds(from) || !in_bounds(to))
+    return;
+  const uint32_t goalIdx = to_idx(to);
+  touch(goalIdx);
+  m_rhs[goalIdx] = 0.f;
+  m_open.push(goalIdx, calc_key(goalIdx));
+}
+
+void DStarLite::set_start(Position from)
+{
+  // keys already in the heap stay valid lower bounds if km grows by h(last, start)
+  m_km += heuristic(m_last, from);
+  m_start = m_last = from;
+}
+
+void DStarLite::notify_cell_changed(Position p)
+{
+  if (!in_bounds(p) || !in_bounds(m_goal))
+    return;
+  // only edges entering p changed their cost, so only the neighbours' rhs is affected
+  auto update = [&](Position n)
+  {
+    if (in_bounds(n))
+      update_vertex(to_idx(n));
+  };
+  update({p.x + 1, p.y + 0});
+  update({p.x - 1, p.y + 0});
+  update({p.x + 0, p.y + 1});
+  update({p.x + 0, p.y - 1});
+}
+
+bool DStarLite::compute_path()
+{
+  m_stats.replans += 1;
+  m_stats.expanded = 0;
+  if (!in_bounds(m_start) || !in_bounds(m_goal))
+  {
+    m_stats.updated = m_pendingUpdated;
+    m_pendingUpdated = 0;
+    return false;
+  }
+  const uint32_t startIdx = to_idx(m_start);
+  touch(startIdx);
+  while (!m_open.empty() && (m_open.top_key() < calc_key(startIdx) || m_rhs[startIdx] > m_g[startIdx]))
+  {
+    const uint32_t idx = m_open.top();
+    const Key oldKey = m_open.top_key();
+    const Key newKey = calc_key(idx);
+    if (oldKey < newKey)
+    {
+      m_open.update(idx, newKey);
+      continue;
+    }
+    m_stats.expanded += 1;
+    const Position p = to_pos(idx);
+    if (m_g[idx] > m_rhs[idx])
+    {
+      m_g[idx] = m_rhs[idx];
+      m_open.remove(idx);
+    }
+    else
+    {
+      m_g[idx] = inf;
+      update_vertex(idx);
+    }
+    auto update = [&](Position n)
+    {
+      if (in_bounds(n))
+        update_vertex(to_idx(n));
+    };
+    update({p.x + 1, p.y + 0});
+    update({p.x - 1, p.y + 0});
+    update({p.x + 0, p.y + 1});
+    update({p.x + 0, p.y - 1});
+  }
+  m_stats.totalExpanded += m_stats.expanded;
+  m_stats.updated = m_pendingUpdated;
+  m_pendingUpdated = 0;
+  return m_rhs[startIdx] != inf;
+}
+
+bool DStarLite::get_path(std::vector<Position> &path) const
+{
+  path.clear();
+  if (!in_bounds(m_start) || !in_bounds(m_goal) || rhs(to_idx(m_start)) == inf)
+    return false;
+  Position cur = m_start;
+  path.push_back(cur);
+  // every step strictly decreases g, the bound only guards against a stale state
+  for (size_t steps = 0; cur != m_goal && steps < m_width * m_height; ++steps)
+  {
+    Position next = cur;
+    float best = inf;
+    auto relax = [&](Position n)
+    {
+      if (!in_bounds(n))
+        return;
+      const uint32_t nIdx = to_idx(n);
+      const float cost = edge_cost(nIdx) + g(nIdx);
+      if (cost < best)
+      {
+        best = cost;
+        next = n;
+      }
+    };
+    relax({cur.x + 1, cur.y + 0});
+    relax({cur.x - 1, cur.y + 0});
+    relax({cur.x + 0, cur.y + 1});
+    relax({cur.x + 0, cur.y - 1});
+    if (best == inf)
+      break;
+    cur = next;
+    path.push_back(cur);
+  }
+  if (cur != m_goal)
+  {
+    path.clear();
+    return false;
+  }
+  return true;
+}
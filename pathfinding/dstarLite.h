@@ -0,0 +1,71 @@
+#pragma once
+#include "math.h"
+#include "indexedHeap.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+struct IncrementalStats
+{
+  size_t expanded = 0;      // expansions of the last compute_path
+  size_t updated = 0;       // rhs recomputations of the last compute_path and the notifies before it
+  size_t totalExpanded = 0; // since reset
+  size_t replans = 0;       // compute_path calls since reset
+};
+
+// D* Lite (Koenig & Likhachev) over the char grid: searches backwards from the goal and keeps
+// g/rhs values between queries, so after tiles are edited or the start moves only the
+// inconsistent region is repaired. Costs are the ones of find_path_a_star (entering a tile).
+// The grid is read in place, edit it and call notify_cell_changed for every edited tile.
+class DStarLite
+{
+  struct Key
+  {
+    float k1;
+    float k2;
+    bool operator<(const Key &rhs) const { return k1 < rhs.k1 || (k1 == rhs.k1 && k2 < rhs.k2); }
+  };
+
+  const char *m_input = nullptr;
+  size_t m_width = 0;
+  size_t m_height = 0;
+  Position m_start;
+  Position m_goal;
+  Position m_last; // start the keys in the heap were computed for
+  float m_km = 0.f;
+  std::vector<uint32_t> m_touched; // == m_generation if m_g/m_rhs are valid
+  std::vector<float> m_g;
+  std::vector<float> m_rhs;
+  uint32_t m_generation = 0;
+  IndexedHeap<Key> m_open;
+  IncrementalStats m_stats;
+  size_t m_pendingUpdated = 0; // update_vertex calls since the last compute_path, notifies included
+
+  uint32_t to_idx(Position p) const { return uint32_t(size_t(p.y) * m_width + size_t(p.x)); }
+  Position to_pos(uint32_t idx) const { return {int(idx % m_width), int(idx / m_width)}; }
+  bool in_bounds(Position p) const { return p.x >= 0 && p.y >= 0 && p.x < int(m_width) && p.y < int(m_height); }
+  float g(uint32_t idx) const;
+  float rhs(uint32_t idx) const;
+  void touch(uint32_t idx);
+  float edge_cost(uint32_t to) const;
+  Key calc_key(uint32_t idx) const;
+  void update_vertex(uint32_t idx);
+
+public:
+  // forgets all search state, the next compute_path is a full search
+  void reset(const char *input, size_t width, size_t height, Position from, Position to);
+  // the agent moved, search state is kept
+  void set_start(Position from);
+  // input[p] changed (wall, floor or water), marks the affected cells inconsistent
+  void notify_cell_changed(Position p);
+  // repairs the inconsistent cells, returns false if the goal is unreachable
+  bool compute_path();
+  // walks the g values from start to goal, call after compute_path
+  bool get_path(std::vector<Position> &path) const;
+
+  const IncrementalStats &stats() const { return m_stats; }
+  Position start() const { return m_start; }
+  Position goal() const { return m_goal; }
+  // for visualisation
+  float g_value(Position p) const { return g(to_idx(p)); }
+};
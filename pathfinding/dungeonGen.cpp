@@ -7,21 +7,30 @@
 #include <functional> // std::bind
 #include "math.h"
 #include <limits>
-#include "raylib.h"
 
-Position gen_random_dir()
+static unsigned gen_time_seed()
+{
+  return unsigned(std::chrono::system_clock::now().time_since_epoch().count() % std::numeric_limits<int>::max());
+}
+
+static Position gen_random_dir(std::default_random_engine &rng)
 {
   constexpr Position dirs[4] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
-  return dirs[GetRandomValue(0, 3)];
+  return dirs[std::uniform_int_distribution<int>(0, 3)(rng)];
 }
 
 void gen_drunk_dungeon(char *tiles, const size_t w, const size_t h,
                        const size_t num_iter, const size_t max_excavations, bool need_print)
+{
+  gen_drunk_dungeon(tiles, w, h, num_iter, max_excavations, gen_time_seed(), need_print);
+}
+
+void gen_drunk_dungeon(char *tiles, const size_t w, const size_t h,
+                       const size_t num_iter, const size_t max_excavations, unsigned seed, bool need_print)
 {
   memset(tiles, dungeon::wall, w * h);
 
   // generator
-  unsigned seed = unsigned(std::chrono::system_clock::now().time_since_epoch().count() % std::numeric_limits<int>::max());
   std::default_random_engine seedGenerator(seed);
   std::default_random_engine widthGenerator(seedGenerator());
   std::default_random_engine heightGenerator(seedGenerator());
@@ -98,9 +107,16 @@ void gen_drunk_dungeon(char *tiles, const size_t w, const size_t h,
 void spill_drunk_water(char *tiles, const size_t w, const size_t h,
                        const size_t num_iter, const size_t max_spills)
 {
+  spill_drunk_water(tiles, w, h, num_iter, max_spills, gen_time_seed());
+}
+
+void spill_drunk_water(char *tiles, const size_t w, const size_t h,
+                       const size_t num_iter, const size_t max_spills, unsigned seed)
+{
+  std::default_random_engine rng(seed);
   for (size_t iter = 0; iter < num_iter; ++iter)
   {
-    Position p = dungeon::find_walkable_tile(tiles, w, h);
+    Position p = dungeon::find_walkable_tile(tiles, w, h, rng);
     // select random point on map
     size_t x = size_t(p.x);
     size_t y = size_t(p.y);
@@ -116,7 +132,7 @@ void spill_drunk_water(char *tiles, const size_t w, const size_t h,
       bool validDir = false;
       while (!validDir)
       {
-        const Position dir = gen_random_dir(); // 0 - right, 1 - up, 2 - left, 3 - down
+        const Position dir = gen_random_dir(rng); // 0 - right, 1 - up, 2 - left, 3 - down
         int newX = std::min(std::max(int(x) + dir.x, 1), int(w) - 2);
         int newY = std::min(std::max(int(y) + dir.y, 1), int(h) - 2);
         if (tiles[size_t(newY) * w + size_t(newX)] != dungeon::wall)
@@ -6,3 +6,10 @@ void gen_drunk_dungeon(char *tiles, const size_t w, const size_t h,
 
 void spill_drunk_water(char *tiles, const size_t w, const size_t h,
                        const size_t num_iter, const size_t max_spills);
+
+// seeded versions, the same seed always gives the same dungeon (used by the benchmark)
+void gen_drunk_dungeon(char *tiles, const size_t w, const size_t h,
+                       const size_t num_iter, const size_t max_excavations, unsigned seed, bool need_print);
+
+void spill_drunk_water(char *tiles, const size_t w, const size_t h,
+                       const size_t num_iter, const size_t max_spills, unsigned seed);
@@ -1,8 +1,14 @@
 #include "dungeonUtils.h"
-#include "raylib.h"
 #include <vector>
+#include <chrono>
 
 Position dungeon::find_walkable_tile(const char *dungeon, const size_t width, const size_t height)
+{
+  static std::default_random_engine rng(unsigned(std::chrono::system_clock::now().time_since_epoch().count()));
+  return find_walkable_tile(dungeon, width, height, rng);
+}
+
+Position dungeon::find_walkable_tile(const char *dungeon, const size_t width, const size_t height, std::default_random_engine &rng)
 {
   Position res{0, 0};
   // prebuild all walkable and get one of them
@@ -11,8 +17,7 @@ Position dungeon::find_walkable_tile(const char *dungeon, const size_t width, co
     for (size_t x = 0; x < width; ++x)
       if (dungeon[y * width + x] == dungeon::floor)
         posList.push_back(Position{int(x), int(y)});
-  size_t rndIdx = size_t(GetRandomValue(0, int(posList.size()) - 1));
-  res = posList[rndIdx];
+  std::uniform_int_distribution<size_t> rndIdx(0, posList.size() - 1);
+  res = posList[rndIdx(rng)];
   return res;
 }
-
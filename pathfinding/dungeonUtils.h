@@ -1,6 +1,7 @@
 #pragma once
 #include "math.h"
 #include <cstddef>
+#include <random>
 
 namespace dungeon
 {
@@ -8,5 +9,10 @@ namespace dungeon
   constexpr char floor = ' ';
   constexpr char water = 'o';
 
+  // 4-connected move cost: entering a tile costs 1, water costs 10, walls are impassable
+  inline bool is_passable(char tile) { return tile != wall; }
+  inline float move_cost(char tile) { return tile == water ? 10.f : 1.f; }
+
   Position find_walkable_tile(const char *dungeon, const size_t width, const size_t height);
+  Position find_walkable_tile(const char *dungeon, const size_t width, const size_t height, std::default_random_engine &rng);
 }
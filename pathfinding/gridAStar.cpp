@@ -0,0 +1,183 @@
+#include "gridAStar.h"
+#include "dungeonUtils.h"
+#include <limits>
+
+bool find_path_a_star(SearchContext &ctx, const char *input, size_t width, size_t height, Position from, Position to, float weight,
+                      std::vector<Position> &path, SearchStats *stats, const Landmarks *landmarks)
+{
+  SearchStats localStats;
+  SearchStats &st = stats ? *stats : localStats;
+  st = SearchStats{};
+  path.clear();
+  ctx.begin(width, height);
+  if (from.x < 0 || from.y < 0 || from.x >= int(width) || from.y >= int(height))
+    return false;
+  if (to.x < 0 || to.y < 0 || to.x >= int(width) || to.y >= int(height))
+    return false;
+
+  auto h = [&](Position p) { return landmarks ? landmarks->heuristic(p, to) : heuristic(p, to); };
+  const uint32_t fromIdx = uint32_t(size_t(from.y) * width + size_t(from.x));
+  const uint32_t toIdx = uint32_t(size_t(to.y) * width + size_t(to.x));
+  ctx.set(fromIdx, 0.f, -1);
+  ctx.open.push(fromIdx, {weight * h(from), 0.f});
+
+  while (!ctx.open.empty())
+  {
+    const uint32_t curIdx = ctx.open.pop();
+    if (curIdx == toIdx)
+    {
+      ctx.write_path(toIdx, path);
+      return true;
+    }
+    ctx.close(curIdx);
+    st.expanded += 1;
+    const Position curPos{int(curIdx % width), int(curIdx / width)};
+    const float curG = ctx.g(curIdx);
+    auto checkNeighbour = [&](Position p)
+    {
+      // out of bounds
+      if (p.x < 0 || p.y < 0 || p.x >= int(width) || p.y >= int(height))
+        return;
+      const uint32_t idx = uint32_t(size_t(p.y) * width + size_t(p.x));
+      if (!dungeon::is_passable(input[idx]) || ctx.is_closed(idx))
+        return;
+      const float gScore = curG + dungeon::move_cost(input[idx]);
+      if (gScore < ctx.g(idx))
+      {
+        ctx.set(idx, gScore, int(curIdx));
+        ctx.open.update(idx, {gScore + weight * h(p), gScore});
+      }
+    };
+    checkNeighbour({curPos.x + 1, curPos.y + 0});
+    checkNeighbour({curPos.x - 1, curPos.y + 0});
+    checkNeighbour({curPos.x + 0, curPos.y + 1});
+    checkNeighbour({curPos.x + 0, curPos.y - 1});
+  }
+  // empty path
+  return false;
+}
+
+bool find_path_a_star_bidirectional(SearchContext &fwd, SearchContext &bwd, const char *input, size_t width, size_t height,
+                                    Position from, Position to, std::vector<Position> &path,
+                                    SearchStats *stats, const Landmarks *landmarks)
+{
+  SearchStats localStats;
+  SearchStats &st = stats ? *stats : localStats;
+  st = SearchStats{};
+  path.clear();
+  fwd.begin(width, height);
+  bwd.begin(width, height);
+  if (from.x < 0 || from.y < 0 || from.x >= int(width) || from.y >= int(height))
+    return false;
+  if (to.x < 0 || to.y < 0 || to.x >= int(width) || to.y >= int(height))
+    return false;
+
+  const uint32_t fromIdx = uint32_t(size_t(from.y) * width + size_t(from.x));
+  const uint32_t toIdx = uint32_t(size_t(to.y) * width + size_t(to.x));
+  if (fromIdx == toIdx)
+  {
+    path.push_back(from);
+    return true;
+  }
+  // estimate of the remaining cost for the forward (to `to`) and the backward (from `from`) side
+  auto hFwd = [&](Position p) { return landmarks ? landmarks->heuristic(p, to) : heuristic(p, to); };
+  auto hBwd = [&](Position p) { return landmarks ? landmarks->heuristic(from, p) : heuristic(from, p); };
+  fwd.set(fromIdx, 0.f, -1);
+  fwd.open.push(fromIdx, {hFwd(from), 0.f});
+  bwd.set(toIdx, 0.f, -1);
+  bwd.open.push(toIdx, {hBwd(to), 0.f});
+
+  float best = std::numeric_limits<float>::max(); // cheapest path through a meeting node so far
+  int meetIdx = -1;
+  auto expand = [&](SearchContext &self, SearchContext &other, bool forward)
+  {
+    const uint32_t curIdx = self.open.pop();
+    if (other.is_closed(curIdx))
+      return;
+    self.close(curIdx);
+    const Position curPos{int(curIdx % width), int(curIdx / width)};
+    const float curG = self.g(curIdx);
+    const float hSelf = forward ? hFwd(curPos) : hBwd(curPos);
+    const float hOther = forward ? hBwd(curPos) : hFwd(curPos);
+    const float otherMinF = other.open.empty() ? 0.f : other.open.top_key().f;
+    // can't be on a path cheaper than best
+    if (curG + hSelf >= best || curG + otherMinF - hOther >= best)
+      return;
+    st.expanded += 1;
+    // backward edges lead into curIdx, so it has to be enterable
+    if (!forward && !dungeon::is_passable(input[curIdx]))
+      return;
+    auto checkNeighbour = [&](Position p)
+    {
+      // out of bounds
+      if (p.x < 0 || p.y < 0 || p.x >= int(width) || p.y >= int(height))
+        return;
+      const uint32_t idx = uint32_t(size_t(p.y) * width + size_t(p.x));
+      if (self.is_closed(idx) || other.is_closed(idx))
+        return;
+      // walls can't be entered, a backward path may only start from one if it is `from`
+      if (!dungeon::is_passable(input[idx]) && (forward || idx != fromIdx))
+        return;
+      const float gScore = curG + dungeon::move_cost(input[forward ? idx : curIdx]);
+      if (gScore < self.g(idx))
+      {
+        self.set(idx, gScore, int(curIdx));
+        self.open.update(idx, {gScore + (forward ? hFwd(p) : hBwd(p)), gScore});
+        const float otherG = other.g(idx);
+        if (otherG < std::numeric_limits<float>::max() && gScore + otherG < best)
+        {
+          best = gScore + otherG;
+          meetIdx = int(idx);
+        }
+      }
+    };
+    checkNeighbour({curPos.x + 1, curPos.y + 0});
+    checkNeighbour({curPos.x - 1, curPos.y + 0});
+    checkNeighbour({curPos.x + 0, curPos.y + 1});
+    checkNeighbour({curPos.x + 0, curPos.y - 1});
+  };
+
+  while (!fwd.open.empty() && !bwd.open.empty())
+  {
+    // grow the smaller frontier
+    if (fwd.open.size() <= bwd.open.size())
+      expand(fwd, bwd, true);
+    else
+      expand(bwd, fwd, false);
+  }
+  if (meetIdx < 0)
+    return false;
+
+  // forward half ends at the meeting node, backward back pointers lead on to `to`
+  fwd.write_path(size_t(meetIdx), path);
+  for (int i = bwd.prev(size_t(meetIdx)); i >= 0; i = bwd.prev(size_t(i)))
+    path.push_back({i % int(width), i / int(width)});
+  return true;
+}
+
+bool GridAStar::find_path_bidirectional(const char *input, size_t width, size_t height, Position from, Position to, std::vector<Position> &path)
+{
+  m_lastBidirectional = true;
+  return find_path_a_star_bidirectional(m_ctx, m_backCtx, input, width, height, from, to, path, &m_stats, m_landmarks);
+}
+
+bool GridAStar::find_path(const char *input, size_t width, size_t height, Position from, Position to, float weight, std::vector<Position> &path)
+{
+  m_lastBidirectional = false;
+  return find_path_a_star(m_ctx, input, width, height, from, to, weight, path, &m_stats, m_landmarks);
+}
+
+std::vector<Position> GridAStar::find_path(const char *input, size_t width, size_t height, Position from, Position to, float weight)
+{
+  std::vector<Position> path;
+  find_path(input, width, height, from, to, weight, path);
+  return path;
+}
+
+std::vector<Position> find_path_a_star_heap(const char *input, size_t width, size_t height, Position from, Position to, float weight)
+{
+  thread_local SearchContext ctx;
+  std::vector<Position> path;
+  find_path_a_star(ctx, input, width, height, from, to, weight, path);
+  return path;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "math.h"
+#include "searchContext.h"
+#include "gridSearch.h"
+#include "landmarks.h"
+#include <vector>
+#include <cstddef>
+
+// A* over the char grid with an indexed binary heap as the open list.
+// All scratch state lives in the SearchContext, so repeated queries don't allocate.
+// Same (input, width, height, from, to, weight) contract as the reference find_path_a_star,
+// the path is written into the caller's buffer in forward order.
+// With landmarks the heuristic is the ALT bound (never below euclidean), they must match the grid.
+bool find_path_a_star(SearchContext &ctx, const char *input, size_t width, size_t height, Position from, Position to, float weight,
+                      std::vector<Position> &path, SearchStats *stats = nullptr, const Landmarks *landmarks = nullptr);
+
+// Bidirectional A* (NBA*, Pijls & Post): forward from `from` over the grid, backward from `to`
+// over reversed edges (an edge costs what entering its end tile costs), both with consistent
+// heuristics. A node is closed once by either side and pruned when it can't improve the best
+// meeting cost seen so far, the search stops when one side runs out of nodes. Always optimal,
+// so there is no weight. fwd and bwd must be different contexts.
+bool find_path_a_star_bidirectional(SearchContext &fwd, SearchContext &bwd, const char *input, size_t width, size_t height,
+                                    Position from, Position to, std::vector<Position> &path,
+                                    SearchStats *stats = nullptr, const Landmarks *landmarks = nullptr);
+
+// Owns its contexts, handy for single-threaded callers like the sandbox
+class GridAStar
+{
+  SearchContext m_ctx;
+  SearchContext m_backCtx; // backward side of bidirectional queries
+  SearchStats m_stats;
+  const Landmarks *m_landmarks = nullptr;
+  bool m_lastBidirectional = false;
+public:
+  // nullptr goes back to the euclidean heuristic
+  void set_landmarks(const Landmarks *landmarks) { m_landmarks = landmarks; }
+
+  std::vector<Position> find_path(const char *input, size_t width, size_t height, Position from, Position to, float weight);
+  bool find_path(const char *input, size_t width, size_t height, Position from, Position to, float weight, std::vector<Position> &path);
+  bool find_path_bidirectional(const char *input, size_t width, size_t height, Position from, Position to, std::vector<Position> &path);
+
+  // stats and state of the last query (for logs and visualisation)
+  size_t expanded() const { return m_stats.expanded; }
+  // closed by either side after a bidirectional query, g is of the side that closed it
+  bool is_closed(Position p) const
+  {
+    const size_t idx = size_t(p.y) * m_ctx.width() + size_t(p.x);
+    return m_ctx.is_closed(idx) || (m_lastBidirectional && m_backCtx.is_closed(idx));
+  }
+  float g_value(Position p) const
+  {
+    const size_t idx = size_t(p.y) * m_ctx.width() + size_t(p.x);
+    return m_lastBidirectional && m_backCtx.is_closed(idx) ? m_backCtx.g(idx) : m_ctx.g(idx);
+  }
+};
+
+std::vector<Position> find_path_a_star_heap(const char *input, size_t width, size_t height, Position from, Position to, float weight);
@@ -0,0 +1,23 @@
+#pragma once
+#include "math.h"
+#include <vector>
+#include <limits>
+#include <cstddef>
+
+struct SearchStats
+{
+  size_t expanded = 0;
+  size_t iterations = 0; // IDA* bound iterations
+};
+
+float heuristic(Position lhs, Position rhs);
+float calcPathCost(const char *input, size_t width,  const std::vector<Position>& path);
+
+// reference implementation (linear open list), kept to diff results against GridAStar
+std::vector<Position> find_path_a_star(const char *input, size_t width, size_t height, Position from, Position to, float weight,
+                                       SearchStats *stats = nullptr);
+
+// gives up and returns an empty path once max_expanded nodes were expanded
+std::vector<Position> find_ida_star_path(const char *input, size_t width, size_t height, Position from, Position to,
+                                         SearchStats *stats = nullptr,
+                                         size_t max_expanded = std::numeric_limits<size_t>::max());
@@ -0,0 +1,164 @@
+#include "idaStar.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <cstdint>
+#include <float.h>
+
+namespace
+{
+  constexpr uint32_t npos = ~0u;
+
+  struct TableEntry
+  {
+    uint32_t cell = npos;
+    uint32_t iteration = 0;
+    float g = 0.f;
+  };
+
+  // direct-mapped, newest entry wins
+  class TranspositionTable
+  {
+    std::vector<TableEntry> m_entries;
+    uint32_t m_mask = 0;
+
+    TableEntry &slot(uint32_t cell) { return m_entries[(cell * 2654435761u) & m_mask]; }
+  public:
+    explicit TranspositionTable(size_t entries)
+    {
+      size_t size = 1;
+      while (size < entries)
+        size <<= 1;
+      m_entries.resize(size);
+      m_mask = uint32_t(size - 1);
+    }
+    // true if cell was already reached cheaper, or as cheap in this iteration, otherwise records g
+    bool dominated(uint32_t cell, float g, uint32_t iteration)
+    {
+      TableEntry &e = slot(cell);
+      if (e.cell == cell && (e.g < g || (e.g == g && e.iteration == iteration)))
+        return true;
+      e = {cell, iteration, g};
+      return false;
+    }
+  };
+
+  struct Frame
+  {
+    uint32_t cell;
+    float g;
+    uint8_t count = 0; // children, sorted by f
+    uint8_t next = 0;
+    uint32_t children[4];
+    float childG[4];
+    float childF[4];
+  };
+}
+
+std::vector<Position> find_ida_star_tt_path(const char *input, size_t width, size_t height, Position from, Position to,
+                                            SearchStats *stats, size_t max_expanded, size_t table_entries)
+{
+  SearchStats localStats;
+  SearchStats &st = stats ? *stats : localStats;
+  st = SearchStats{};
+  if (from.x < 0 || from.y < 0 || from.x >= int(width) || from.y >= int(height))
+    return {};
+  if (to.x < 0 || to.y < 0 || to.x >= int(width) || to.y >= int(height))
+    return {};
+  if (from == to)
+    return {from};
+
+  const uint32_t fromIdx = uint32_t(size_t(from.y) * width + size_t(from.x));
+  const uint32_t toIdx = uint32_t(size_t(to.y) * width + size_t(to.x));
+  auto toPos = [width](uint32_t idx) { return Position{int(idx % width), int(idx / width)}; };
+
+  std::vector<uint64_t> onPath((width * height + 63) / 64, 0);
+  auto isOnPath = [&](uint32_t idx) { return (onPath[idx / 64] >> (idx % 64)) & 1u; };
+  auto flipOnPath = [&](uint32_t idx) { onPath[idx / 64] ^= uint64_t(1) << (idx % 64); };
+  TranspositionTable table(table_entries);
+  std::vector<Frame> stack;
+
+  auto pushFrame = [&](uint32_t cell, float g)
+  {
+    Frame &fr = stack.emplace_back();
+    fr.cell = cell;
+    fr.g = g;
+    flipOnPath(cell);
+    const Position p = toPos(cell);
+    auto addChild = [&](Position n)
+    {
+      // out of bounds
+      if (n.x < 0 || n.y < 0 || n.x >= int(width) || n.y >= int(height))
+        return;
+      const uint32_t idx = uint32_t(size_t(n.y) * width + size_t(n.x));
+      if (!dungeon::is_passable(input[idx]) || isOnPath(idx))
+        return;
+      const float childG = g + dungeon::move_cost(input[idx]);
+      const float childF = childG + heuristic(n, to);
+      // insertion sort, stable for equal f
+      uint8_t i = fr.count++;
+      for (; i > 0 && fr.childF[i - 1] > childF; --i)
+      {
+        fr.children[i] = fr.children[i - 1];
+        fr.childG[i] = fr.childG[i - 1];
+        fr.childF[i] = fr.childF[i - 1];
+      }
+      fr.children[i] = idx;
+      fr.childG[i] = childG;
+      fr.childF[i] = childF;
+    };
+    addChild({p.x + 1, p.y + 0});
+    addChild({p.x - 1, p.y + 0});
+    addChild({p.x + 0, p.y + 1});
+    addChild({p.x + 0, p.y - 1});
+  };
+
+  float bound = heuristic(from, to);
+  while (true)
+  {
+    st.iterations += 1;
+    const uint32_t iteration = uint32_t(st.iterations);
+    float nextBound = FLT_MAX;
+    table.dominated(fromIdx, 0.f, iteration);
+    st.expanded += 1;
+    pushFrame(fromIdx, 0.f);
+    while (!stack.empty())
+    {
+      Frame &fr = stack.back();
+      if (fr.next == fr.count)
+      {
+        flipOnPath(fr.cell);
+        stack.pop_back();
+        continue;
+      }
+      const uint8_t childIdx = fr.next++;
+      const uint32_t cell = fr.children[childIdx];
+      const float g = fr.childG[childIdx];
+      const float f = fr.childF[childIdx];
+      if (f > bound)
+      {
+        // the rest of the children have f at least as large
+        nextBound = std::min(nextBound, f);
+        fr.next = fr.count;
+        continue;
+      }
+      if (cell == toIdx)
+      {
+        std::vector<Position> path;
+        path.reserve(stack.size() + 1);
+        for (const Frame &onStack : stack)
+          path.push_back(toPos(onStack.cell));
+        path.push_back(to);
+        return path;
+      }
+      if (table.dominated(cell, g, iteration))
+        continue;
+      if (st.expanded >= max_expanded)
+        return {};
+      st.expanded += 1;
+      pushFrame(cell, g);
+    }
+    if (nextBound == FLT_MAX)
+      return {};
+    bound = nextBound;
+  }
+}
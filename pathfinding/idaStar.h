@@ -0,0 +1,16 @@
+#pragma once
+#include "math.h"
+#include "gridSearch.h"
+#include <vector>
+#include <limits>
+#include <cstddef>
+
+// IDA* for memory-constrained callers, same contract as find_ida_star_path.
+// Memory is one bit per cell for the current path, the explicit DFS stack and a fixed-size
+// transposition table of the best g seen per cell (table_entries is rounded up to a power of two,
+// 12 bytes each). Entries only prune paths that are dominated, so a collision costs expansions,
+// never optimality. Children are visited in order of f, so the bound is usually hit earlier.
+std::vector<Position> find_ida_star_tt_path(const char *input, size_t width, size_t height, Position from, Position to,
+                                            SearchStats *stats = nullptr,
+                                            size_t max_expanded = std::numeric_limits<size_t>::max(),
+                                            size_t table_entries = size_t(1) << 14);
@@ -0,0 +1,195 @@
+#include "jps.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+  struct JumpGrid
+  {
+    const char *input;
+    int width;
+    int height;
+    Position goal;
+
+    bool in_bounds(int x, int y) const { return x >= 0 && y >= 0 && x < width && y < height; }
+    char tile(int x, int y) const { return input[size_t(y) * size_t(width) + size_t(x)]; }
+    bool passable(int x, int y) const { return in_bounds(x, y) && dungeon::is_passable(tile(x, y)); }
+    bool same(int x, int y, char t) const { return in_bounds(x, y) && tile(x, y) == t; }
+
+    // has a passable neighbour of another tile type, so a path may leave the region here
+    bool is_boundary(Position p) const
+    {
+      const char t = tile(p.x, p.y);
+      auto differs = [&](int x, int y) { return passable(x, y) && tile(x, y) != t; };
+      return differs(p.x + 1, p.y) || differs(p.x - 1, p.y) || differs(p.x, p.y + 1) || differs(p.x, p.y - 1);
+    }
+    // moving vertically into p, a horizontal neighbour is forced if it couldn't be reached
+    // by going horizontally first from the previous cell. Other tile types count as
+    // obstacles here, going through them costs differently.
+    bool is_forced(Position p, int dx, int dy) const
+    {
+      const char t = tile(p.x, p.y);
+      return same(p.x + dx, p.y, t) && !same(p.x + dx, p.y - dy, t);
+    }
+    bool has_forced(Position p, int dy) const { return is_forced(p, +1, dy) || is_forced(p, -1, dy); }
+    bool is_jump_point(Position p) const { return p == goal || is_boundary(p); }
+
+    // scans from p (inclusive) in direction dy inside the region of tile t
+    bool jump_vertical(Position p, int dy, char t, Position &out) const
+    {
+      for (; same(p.x, p.y, t); p.y += dy)
+        if (is_jump_point(p) || has_forced(p, dy))
+        {
+          out = p;
+          return true;
+        }
+      return false;
+    }
+    // scans from p (inclusive) in direction dx inside the region of tile t
+    bool jump_horizontal(Position p, int dx, char t, Position &out) const
+    {
+      Position unused;
+      for (; same(p.x, p.y, t); p.x += dx)
+        if (is_jump_point(p) || jump_vertical({p.x, p.y + 1}, +1, t, unused) || jump_vertical({p.x, p.y - 1}, -1, t, unused))
+        {
+          out = p;
+          return true;
+        }
+      return false;
+    }
+    // next jump point from p in direction dir, crossing a cost boundary is a single step
+    bool jump(Position p, Position dir, Position &out) const
+    {
+      const Position n{p.x + dir.x, p.y + dir.y};
+      if (!passable(n.x, n.y))
+        return false;
+      const char t = tile(n.x, n.y);
+      if (t != tile(p.x, p.y))
+      {
+        out = n;
+        return true;
+      }
+      return dir.x != 0 ? jump_horizontal(n, dir.x, t, out) : jump_vertical(n, dir.y, t, out);
+    }
+  };
+
+  int sign(int v) { return (v > 0) - (v < 0); }
+
+  // exact on open floor for 4-connected moves and still a lower bound with water,
+  // much tighter than the euclidean heuristic, which matters more with sparse jump points
+  float manhattan(Position lhs, Position rhs) { return float(std::abs(lhs.x - rhs.x) + std::abs(lhs.y - rhs.y)); }
+}
+
+bool find_path_jps(SearchContext &ctx, const char *input, size_t width, size_t height, Position from, Position to,
+                   std::vector<Position> &path, SearchStats *stats, const Landmarks *landmarks)
+{
+  SearchStats localStats;
+  SearchStats &st = stats ? *stats : localStats;
+  st = SearchStats{};
+  path.clear();
+  ctx.begin(width, height);
+  if (from.x < 0 || from.y < 0 || from.x >= int(width) || from.y >= int(height))
+    return false;
+  if (to.x < 0 || to.y < 0 || to.x >= int(width) || to.y >= int(height))
+    return false;
+
+  const JumpGrid grid{input, int(width), int(height), to};
+  auto toIdx = [width](Position p) { return uint32_t(size_t(p.y) * width + size_t(p.x)); };
+  auto toPos = [width](uint32_t idx) { return Position{int(idx % width), int(idx / width)}; };
+  auto h = [&](Position p) { return landmarks ? std::max(manhattan(p, to), landmarks->heuristic(p, to)) : manhattan(p, to); };
+  const uint32_t goalIdx = toIdx(to);
+  ctx.set(toIdx(from), 0.f, -1);
+  ctx.open.push(toIdx(from), {h(from), 0.f});
+
+  bool found = false;
+  while (!ctx.open.empty())
+  {
+    const uint32_t curIdx = ctx.open.pop();
+    if (curIdx == goalIdx)
+    {
+      found = true;
+      break;
+    }
+    ctx.close(curIdx);
+    st.expanded += 1;
+    const Position cur = toPos(curIdx);
+    const float curG = ctx.g(curIdx);
+    auto tryJump = [&](Position dir)
+    {
+      Position jp;
+      if (!grid.jump(cur, dir, jp))
+        return;
+      const uint32_t idx = toIdx(jp);
+      if (ctx.is_closed(idx))
+        return;
+      // a jump stays inside one tile type, so every step costs the same
+      const int steps = std::abs(jp.x - cur.x) + std::abs(jp.y - cur.y);
+      const float gScore = curG + float(steps) * dungeon::move_cost(input[idx]);
+      if (gScore < ctx.g(idx))
+      {
+        ctx.set(idx, gScore, int(curIdx));
+        ctx.open.update(idx, {gScore + h(jp), gScore});
+      }
+    };
+
+    const int prevIdx = ctx.prev(curIdx);
+    if (prevIdx < 0 || grid.is_boundary(cur))
+    {
+      tryJump({+1, 0});
+      tryJump({-1, 0});
+      tryJump({0, +1});
+      tryJump({0, -1});
+      continue;
+    }
+    const Position prev = toPos(uint32_t(prevIdx));
+    const Position dir{sign(cur.x - prev.x), sign(cur.y - prev.y)};
+    tryJump(dir);
+    if (dir.x != 0)
+    {
+      // horizontal first: turning vertical is always natural
+      tryJump({0, +1});
+      tryJump({0, -1});
+    }
+    else
+    {
+      if (grid.is_forced(cur, +1, dir.y))
+        tryJump({+1, 0});
+      if (grid.is_forced(cur, -1, dir.y))
+        tryJump({-1, 0});
+    }
+  }
+  if (!found)
+    return false;
+
+  // jump points are on straight lines, fill in the cells between them
+  size_t len = 1;
+  for (int i = int(goalIdx), p = ctx.prev(goalIdx); p >= 0; i = p, p = ctx.prev(uint32_t(p)))
+  {
+    const Position a = toPos(uint32_t(i));
+    const Position b = toPos(uint32_t(p));
+    len += size_t(std::abs(a.x - b.x) + std::abs(a.y - b.y));
+  }
+  path.resize(len);
+  Position cur = to;
+  path[--len] = cur;
+  for (int p = ctx.prev(goalIdx); p >= 0; p = ctx.prev(uint32_t(p)))
+  {
+    const Position target = toPos(uint32_t(p));
+    const Position dir{sign(target.x - cur.x), sign(target.y - cur.y)};
+    while (cur != target)
+    {
+      cur = {cur.x + dir.x, cur.y + dir.y};
+      path[--len] = cur;
+    }
+  }
+  return true;
+}
+
+std::vector<Position> find_path_jps(const char *input, size_t width, size_t height, Position from, Position to, SearchStats *stats)
+{
+  thread_local SearchContext ctx;
+  std::vector<Position> path;
+  find_path_jps(ctx, input, width, height, from, to, path, stats);
+  return path;
+}
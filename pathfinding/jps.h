@@ -0,0 +1,20 @@
+#pragma once
+#include "math.h"
+#include "searchContext.h"
+#include "gridSearch.h"
+#include "landmarks.h"
+#include <vector>
+#include <cstddef>
+
+// Jump Point Search for the 4-connected char grid, optimal under the cost model of find_path_a_star.
+// Canonical paths go horizontally first: vertical jumps stop at forced horizontal neighbours,
+// horizontal jumps stop where a vertical jump finds something. Jumps never leave a region of one
+// tile type; cells next to a different tile type (a cost boundary) are jump points that expand
+// all four directions, and the step across the boundary is a successor on its own.
+// Uses the manhattan heuristic, or the larger of it and the ALT bound with landmarks.
+// stats->expanded counts jump points taken from the open list, scanned cells are not counted.
+bool find_path_jps(SearchContext &ctx, const char *input, size_t width, size_t height, Position from, Position to,
+                   std::vector<Position> &path, SearchStats *stats = nullptr, const Landmarks *landmarks = nullptr);
+
+std::vector<Position> find_path_jps(const char *input, size_t width, size_t height, Position from, Position to,
+                                    SearchStats *stats = nullptr);
@@ -0,0 +1,144 @@
+#include "landmarks.h"
+#include "gridSearch.h"
+#include "indexedHeap.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+  constexpr uint32_t infDist = std::numeric_limits<uint32_t>::max();
+
+  // Dijkstra from source over the 4-connected grid. Forward: dist = cost source -> cell.
+  // Backward walks edges in reverse: dist = cost cell -> source, the cost is paid for
+  // entering the cell the edge leads to, so it is the cost of the cell we come from.
+  void dijkstra(const char *input, size_t width, size_t height, size_t source, bool backward,
+                std::vector<uint32_t> &dist, IndexedHeap<uint32_t> &open)
+  {
+    dist.assign(width * height, infDist);
+    open.reset(width * height);
+    dist[source] = 0;
+    open.push(uint32_t(source), 0);
+    while (!open.empty())
+    {
+      const uint32_t cur = open.pop();
+      const uint32_t curDist = dist[cur];
+      if (backward && !dungeon::is_passable(input[cur]))
+        continue; // nothing can move into a wall
+      const int x = int(cur % width);
+      const int y = int(cur / width);
+      auto relax = [&](int nx, int ny)
+      {
+        if (nx < 0 || ny < 0 || nx >= int(width) || ny >= int(height))
+          return;
+        const uint32_t idx = uint32_t(size_t(ny) * width + size_t(nx));
+        if (!backward && !dungeon::is_passable(input[idx]))
+          return;
+        const uint32_t d = curDist + uint32_t(dungeon::move_cost(input[backward ? cur : idx]));
+        if (d < dist[idx])
+        {
+          dist[idx] = d;
+          open.update(idx, d);
+        }
+      };
+      relax(x + 1, y);
+      relax(x - 1, y);
+      relax(x, y + 1);
+      relax(x, y - 1);
+    }
+  }
+
+  // Long distances saturate rather than turn unknown: a clamped table still keeps
+  // |c(a) - c(b)| <= |a - b|, so the heuristic stays consistent across the clamp boundary.
+  uint16_t pack(uint32_t d)
+  {
+    return d == infDist ? Landmarks::unknown : uint16_t(std::min(d, uint32_t(Landmarks::maxDist)));
+  }
+}
+
+void Landmarks::build(const char *input, size_t width, size_t height, size_t count)
+{
+  invalidate();
+  const size_t size = width * height;
+  size_t seed = 0;
+  while (seed < size && !dungeon::is_passable(input[seed]))
+    ++seed;
+  if (seed == size || count == 0)
+    return;
+
+  m_width = width;
+  m_height = height;
+  m_from.assign(size * count, unknown);
+  m_to.assign(size * count, unknown);
+  std::vector<uint32_t> dist;
+  std::vector<uint32_t> closest(size, infDist); // forward distance to the nearest landmark so far
+  IndexedHeap<uint32_t> open;
+
+  // farthest-point selection, the first landmark is the farthest cell from the first passable one
+  dijkstra(input, width, height, seed, false, dist, open);
+  closest = dist;
+  size_t landmark = seed;
+  for (size_t l = 0; l < count; ++l)
+  {
+    size_t farthest = size;
+    for (size_t i = 0; i < size; ++i)
+      if (closest[i] != infDist && (farthest == size || closest[i] > closest[farthest]))
+        farthest = i;
+    if (farthest == size || closest[farthest] == 0)
+      break; // every reachable cell is a landmark already
+    landmark = farthest;
+
+    const size_t slot = m_positions.size();
+    m_positions.push_back({int(landmark % width), int(landmark / width)});
+    dijkstra(input, width, height, landmark, false, dist, open);
+    for (size_t i = 0; i < size; ++i)
+    {
+      m_from[i * count + slot] = pack(dist[i]);
+      closest[i] = l == 0 ? dist[i] : std::min(closest[i], dist[i]);
+    }
+    dijkstra(input, width, height, landmark, true, dist, open);
+    for (size_t i = 0; i < size; ++i)
+      m_to[i * count + slot] = pack(dist[i]);
+  }
+  m_count = m_positions.size();
+  if (m_count < count)
+  {
+    // fewer distinct reachable cells than requested, compact the rows
+    for (size_t i = 0; i < size; ++i)
+      for (size_t l = 0; l < m_count; ++l)
+      {
+        m_from[i * m_count + l] = m_from[i * count + l];
+        m_to[i * m_count + l] = m_to[i * count + l];
+      }
+    m_from.resize(size * m_count);
+    m_to.resize(size * m_count);
+  }
+}
+
+void Landmarks::invalidate()
+{
+  m_width = m_height = m_count = 0;
+  m_from.clear();
+  m_to.clear();
+  m_positions.clear();
+}
+
+float Landmarks::heuristic(Position from, Position to) const
+{
+  const float euclid = ::heuristic(from, to);
+  if (m_count == 0)
+    return euclid;
+  const size_t a = (size_t(from.y) * m_width + size_t(from.x)) * m_count;
+  const size_t b = (size_t(to.y) * m_width + size_t(to.x)) * m_count;
+  int best = 0;
+  for (size_t l = 0; l < m_count; ++l)
+  {
+    // d(L, to) <= d(L, from) + d(from, to)
+    if (m_from[a + l] != unknown && m_from[b + l] != unknown)
+      best = std::max(best, int(m_from[b + l]) - int(m_from[a + l]));
+    // d(from, L) <= d(from, to) + d(to, L)
+    if (m_to[a + l] != unknown && m_to[b + l] != unknown)
+      best = std::max(best, int(m_to[a + l]) - int(m_to[b + l]));
+  }
+  return std::max(euclid, float(best));
+}
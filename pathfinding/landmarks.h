@@ -0,0 +1,36 @@
+#pragma once
+#include "math.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// ALT (A*, landmarks, triangle inequality) heuristic for the char grid.
+// Picks landmarks by farthest-point selection and stores exact distances from and to every
+// landmark as uint16 (costs are asymmetric, entering water costs 10). Distances that don't fit
+// saturate at maxDist. Cells a landmark can't reach are stored as unknown and skipped by
+// heuristic(), reachability is symmetric so a whole component skips the same landmarks.
+// Tables are per cell, so they go stale when tiles change: call invalidate() and build() again.
+class Landmarks
+{
+  size_t m_width = 0;
+  size_t m_height = 0;
+  size_t m_count = 0;
+  std::vector<uint16_t> m_from; // [cell * count + landmark] cost landmark -> cell
+  std::vector<uint16_t> m_to;   // [cell * count + landmark] cost cell -> landmark
+  std::vector<Position> m_positions;
+public:
+  static constexpr uint16_t unknown = 0xffff;
+  static constexpr uint16_t maxDist = unknown - 1;
+
+  void build(const char *input, size_t width, size_t height, size_t count);
+  // tiles changed: drops the tables, heuristic() is plain euclidean until the next build()
+  void invalidate();
+  bool valid() const { return m_count > 0; }
+
+  // lower bound on the cost of moving from -> to, never below the euclidean heuristic
+  float heuristic(Position from, Position to) const;
+
+  size_t count() const { return m_count; }
+  const std::vector<Position> &positions() const { return m_positions; }
+  size_t memory_bytes() const { return (m_from.size() + m_to.size()) * sizeof(uint16_t); }
+};
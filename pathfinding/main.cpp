@@ -11,7 +11,12 @@
 #include "dungeonGen.h"
 #include "dungeonUtils.h"
 #include "ara.h"
+#include "gridAStar.h"
+#include "gridSearch.h"
+#include "dstarLite.h"
+#include "landmarks.h"
 #include <iostream>
+#include <memory>
 #include <iomanip>
 
 template<typename T>
@@ -42,179 +47,103 @@ static void draw_path(std::vector<Position> path)
   }
 }
 
-static std::vector<Position> reconstruct_path(std::vector<Position> prev, Position to, size_t width)
+static void draw_expanded(const GridAStar &astar, size_t width, size_t height)
 {
-  Position curPos = to;
-  std::vector<Position> res = {curPos};
-  while (prev[coord_to_idx(curPos.x, curPos.y, width)] != Position{-1, -1})
-  {
-    curPos = prev[coord_to_idx(curPos.x, curPos.y, width)];
-    res.insert(res.begin(), curPos);
-  }
-  return res;
-}
-
-float calcPathCost(const char *input, size_t width,  const std::vector<Position>& path) {
-  float path_cost = 0;
-  for (int i = 1; i < path.size(); ++i) {
-    float edgeWeight = input[coord_to_idx(path[i].x, path[i].y, width)] == 'o' ? 10.f : 1.f;
-    path_cost += edgeWeight;
-  }
-  return path_cost;
+  for (size_t y = 0; y < height; ++y)
+    for (size_t x = 0; x < width; ++x)
+    {
+      const Position p{int(x), int(y)};
+      if (!astar.is_closed(p))
+        continue;
+      const float g = astar.g_value(p);
+      const Rectangle rect = {float(x), float(y), 1.f, 1.f};
+      DrawRectangleRec(rect, Color{uint8_t(g), uint8_t(g), 0, 100});
+    }
 }
 
-float heuristic(Position lhs, Position rhs)
-{
-  return sqrtf(square(float(lhs.x - rhs.x)) + square(float(lhs.y - rhs.y)));
-};
-
-static float ida_star_search(const char *input, size_t width, size_t height, std::vector<Position> &path, const float g, const float bound, Position to)
+static void draw_expanded(ARA &ara, size_t width, size_t height)
 {
-  const Position &p = path.back();
-  const float f = g + heuristic(p, to);
-  if (f > bound)
-    return f;
-  if (p == to)
-    return -f;
-  float min = FLT_MAX;
-  auto checkNeighbour = [&](Position p) -> float
-  {
-    // out of bounds
-    if (p.x < 0 || p.y < 0 || p.x >= int(width) || p.y >= int(height))
-      return 0.f;
-    size_t idx = coord_to_idx(p.x, p.y, width);
-    // not empty
-    if (input[idx] == '#')
-      return 0.f;
-    if (std::find(path.begin(), path.end(), p) != path.end())
-      return 0.f;
-    path.push_back(p);
-    float weight = input[idx] == 'o' ? 10.f : 1.f;
-    float gScore = g + 1.f * weight; // we're exactly 1 unit away
-    const float t = ida_star_search(input, width, height, path, gScore, bound, to);
-    if (t < 0.f)
-      return t;
-    if (t < min)
-      min = t;
-    path.pop_back();
-    return t;
-  };
-  float lv = checkNeighbour({p.x + 1, p.y + 0});
-  if (lv < 0.f) return lv;
-  float rv = checkNeighbour({p.x - 1, p.y + 0});
-  if (rv < 0.f) return rv;
-  float tv = checkNeighbour({p.x + 0, p.y + 1});
-  if (tv < 0.f) return tv;
-  float bv = checkNeighbour({p.x + 0, p.y - 1});
-  if (bv < 0.f) return bv;
-  return min;
+  for (size_t y = 0; y < height; ++y)
+    for (size_t x = 0; x < width; ++x)
+    {
+      const Position p{int(x), int(y)};
+      if (!ara.is_expanded_last(p)) // closed in last improve
+        continue;
+      const float g = ara.g_value(p);
+      const Rectangle rect = {float(x), float(y), 1.f, 1.f};
+      DrawRectangleRec(rect, Color{uint8_t(g), uint8_t(g), 0, 100});
+    }
 }
 
-static std::vector<Position> find_ida_star_path(const char *input, size_t width, size_t height, Position from, Position to)
+bool update_log = true; // looks bad but for debug
+bool use_reference_a_star = false;
+bool use_landmarks = false;
+bool use_bidirectional = false;
+Landmarks landmarks; // invalidated on every tile edit, rebuilt on demand
+void draw_nav_data(const char *input, size_t width, size_t height, Position from, Position to, float weight)
 {
-  float bound = heuristic(from, to);
-  std::vector<Position> path = {from};
-  while (true)
+  static GridAStar astar;
+  draw_nav_grid(input, width, height);
+  if (use_landmarks && !landmarks.valid())
+    landmarks.build(input, width, height, 8);
+  astar.set_landmarks(use_landmarks ? &landmarks : nullptr);
+  std::vector<Position> path;
+  size_t expanded = 0;
+  if (use_reference_a_star)
   {
-    const float t = ida_star_search(input, width, height, path, 0.f, bound, to);
-    if (t < 0.f)
-      return path;
-    if (t == FLT_MAX)
-      return {};
-    bound = t;
-    printf("new bound %0.1f\n", bound);
+    SearchStats stats;
+    path = find_path_a_star(input, width, height, from, to, weight, &stats);
+    expanded = stats.expanded;
   }
-  return {};
-}
-
-int sum_expanded;
-static std::vector<Position> find_path_a_star(const char *input, size_t width, size_t height, Position from, Position to, float weight)
-{
-  sum_expanded = 0;
-  if (from.x < 0 || from.y < 0 || from.x >= int(width) || from.y >= int(height))
-    return std::vector<Position>();
-  size_t inpSize = width * height;
-
-  std::vector<float> g(inpSize, std::numeric_limits<float>::max());
-  std::vector<float> f(inpSize, std::numeric_limits<float>::max());
-  std::vector<Position> prev(inpSize, {-1,-1});
-
-  auto getG = [&](Position p) -> float { return g[coord_to_idx(p.x, p.y, width)]; };
-  auto getF = [&](Position p) -> float { return f[coord_to_idx(p.x, p.y, width)]; };
-
-  g[coord_to_idx(from.x, from.y, width)] = 0;
-  f[coord_to_idx(from.x, from.y, width)] = weight * heuristic(from, to);
-
-  std::vector<Position> openList = {from};
-  std::vector<Position> closedList;
-
-  while (!openList.empty())
+  else
   {
-    size_t bestIdx = 0;
-    float bestScore = getF(openList[0]);
-    for (size_t i = 1; i < openList.size(); ++i)
-    {
-      float score = getF(openList[i]);
-      if (score < bestScore)
-      {
-        bestIdx = i;
-        bestScore = score;
-      }
-    }
-    if (openList[bestIdx] == to)
-      return reconstruct_path(prev, to, width);
-    Position curPos = openList[bestIdx];
-    openList.erase(openList.begin() + bestIdx);
-    if (std::find(closedList.begin(), closedList.end(), curPos) != closedList.end())
-      continue;
-    size_t idx = coord_to_idx(curPos.x, curPos.y, width);
-    const Rectangle rect = {float(curPos.x), float(curPos.y), 1.f, 1.f};
-    DrawRectangleRec(rect, Color{uint8_t(g[idx]), uint8_t(g[idx]), 0, 100});
-    closedList.emplace_back(curPos);
-    auto checkNeighbour = [&](Position p)
-    {
-      // out of bounds
-      if (p.x < 0 || p.y < 0 || p.x >= int(width) || p.y >= int(height))
-        return;
-      size_t idx = coord_to_idx(p.x, p.y, width);
-      // not empty
-      if (input[idx] == '#')
-        return;
-      float edgeWeight = input[idx] == 'o' ? 10.f : 1.f;
-      float gScore = getG(curPos) + 1.f * edgeWeight; // we're exactly 1 unit away
-      if (gScore < getG(p))
-      {
-        prev[idx] = curPos;
-        g[idx] = gScore;
-        f[idx] = gScore + weight * heuristic(p, to);
-      }
-      bool found = std::find(openList.begin(), openList.end(), p) != openList.end();
-      if (!found)
-        openList.emplace_back(p);
-    };
-    sum_expanded += 1;
-    checkNeighbour({curPos.x + 1, curPos.y + 0});
-    checkNeighbour({curPos.x - 1, curPos.y + 0});
-    checkNeighbour({curPos.x + 0, curPos.y + 1});
-    checkNeighbour({curPos.x + 0, curPos.y - 1});
+    // bidirectional search is exact, the weight only applies to the one-sided search
+    if (use_bidirectional)
+      astar.find_path_bidirectional(input, width, height, from, to, path);
+    else
+      path = astar.find_path(input, width, height, from, to, weight);
+    expanded = astar.expanded();
+    draw_expanded(astar, width, height);
+  }
+  //std::vector<Position> path = find_ida_star_path(input, width, height, from, to);
+  if (update_log) {
+    const char *label = use_reference_a_star ? "WA* (reference)"
+                      : use_bidirectional ? (use_landmarks ? "A* (bidirectional, ALT)" : "A* (bidirectional)")
+                      : use_landmarks ? "WA* (heap, ALT)" : "WA* (heap)";
+    std::cout << label << " [path cost = " << calcPathCost(input, width, path)
+              << " sum_expanded = " << expanded << " weight = " << weight << "]\n";
+    update_log = false;
   }
-  // empty path
-  return std::vector<Position>();
+  draw_path(path);
 }
 
-bool update_log = true; // looks bad but for debug
-void draw_nav_data(const char *input, size_t width, size_t height, Position from, Position to, float weight)
+// replans incrementally, the log compares it with a full A* rerun on the same grid
+void draw_nav_data(DStarLite &dstar, const char *input, size_t width, size_t height)
 {
+  static GridAStar astar;
   draw_nav_grid(input, width, height);
-  std::vector<Position> path = find_path_a_star(input, width, height, from, to, weight);
-  //std::vector<Position> path = find_ida_star_path(input, width, height, from, to);
+  std::vector<Position> path;
+  dstar.get_path(path);
   if (update_log) {
-    std::cout << "WA* [path cost = " << calcPathCost(input, width, path) << " sum_expanded = " << sum_expanded << " weight = " << weight << "]\n";
+    astar.find_path(input, width, height, dstar.start(), dstar.goal(), 1.f);
+    const IncrementalStats &stats = dstar.stats();
+    std::cout << "D* Lite [path cost = " << calcPathCost(input, width, path) << " expanded = " << stats.expanded
+              << " updated = " << stats.updated << " total_expanded = " << stats.totalExpanded
+              << " full A* expanded = " << astar.expanded() << "]\n";
     update_log = false;
   }
   draw_path(path);
 }
 
+static void log_ara(const ARA &ara)
+{
+  const ARAStats &stats = ara.stats();
+  std::cout << "ARA e' = " << stats.suboptimality << "  weight = " << stats.weight << "\n";
+  std::cout << "num opened = " << stats.opened << " num incons = " << stats.incons << "\n";
+  std::cout << "[path cost = " << stats.pathCost << " sum_expanded = " << stats.expandedTotal
+            << " now_expanded = " << stats.expandedLast << "]\n";
+}
+
 void draw_nav_data(ARA* ara_pathfinding, const char *input, size_t width, size_t height, Position from, Position to, float weight)
 {
   draw_nav_grid(input, width, height);
@@ -237,10 +166,10 @@ void weight_selection(int num_tests, int num_weights, float step) {
     Position from = dungeon::find_walkable_tile(navGrid, dungWidth, dungHeight);
     Position to = dungeon::find_walkable_tile(navGrid, dungWidth, dungHeight);
 
-    float correct_answer = calcPathCost(navGrid, dungWidth, find_path_a_star(navGrid, dungWidth, dungHeight, from, to, 1.0f));
+    float correct_answer = calcPathCost(navGrid, dungWidth, find_path_a_star_heap(navGrid, dungWidth, dungHeight, from, to, 1.0f));
     for (int j = 1; j < num_weights; ++j) {
         float weight = 1.0f + j * step;
-        float answer = calcPathCost(navGrid, dungWidth, find_path_a_star(navGrid, dungWidth, dungHeight, from, to, weight));
+        float answer = calcPathCost(navGrid, dungWidth, find_path_a_star_heap(navGrid, dungWidth, dungHeight, from, to, weight));
         if (correct_answer == answer) {
           ++success[j]; 
         }
@@ -280,18 +209,35 @@ int main(int /*argc*/, const char ** /*argv*/)
   //camera.offset = Vector2{ width * 0.5f, height * 0.5f };
   camera.zoom = float(height) / float(dungHeight);
 
-  ARA* ara_pathfinding;
+  std::unique_ptr<ARA> ara_pathfinding;
   float ara_initial_weight = 5;
   float weight_decrease = 0.5;
   bool enable_ara = false;
+  DStarLite dstar;
+  bool enable_dstar = false;
   auto new_path = [&]()
   {
     if (enable_ara) {
-      ara_pathfinding = new ARA(navGrid, dungWidth, dungHeight, from, to, ara_initial_weight, weight_decrease, heuristic);
+      ara_pathfinding = std::make_unique<ARA>(navGrid, dungWidth, dungHeight, from, to, ara_initial_weight, weight_decrease, heuristic);
       ara_pathfinding->try_improve_path();
+      log_ara(*ara_pathfinding);
+    }
+    if (enable_dstar) {
+      dstar.reset(navGrid, dungWidth, dungHeight, from, to);
+      dstar.compute_path();
     }
     update_log = true;
   };
+  // keeps D* Lite state when only the start moved or tiles changed
+  auto repair_path = [&]()
+  {
+    if (enable_dstar) {
+      dstar.compute_path();
+      update_log = true;
+    } else {
+      new_path();
+    }
+  };
 
   SetTargetFPS(60);               // Set our game to run at 60 frames-per-second
   while (!WindowShouldClose())
@@ -303,6 +249,14 @@ int main(int /*argc*/, const char ** /*argv*/)
     {
       std::cout << "===================================================\n";
       enable_ara = !enable_ara;
+      enable_dstar = false;
+      new_path();
+    }
+    if (IsKeyPressed(KEY_D))
+    {
+      std::cout << "===================================================\n";
+      enable_dstar = !enable_dstar;
+      enable_ara = false;
       new_path();
     }
     if (IsMouseButtonPressed(2) || IsKeyPressed(KEY_Q))
@@ -310,14 +264,19 @@ int main(int /*argc*/, const char ** /*argv*/)
       size_t idx = coord_to_idx(p.x, p.y, dungWidth);
       if (idx < dungWidth * dungHeight) {
         navGrid[idx] = navGrid[idx] == ' ' ? '#' : navGrid[idx] == '#' ? 'o' : ' ';
-        new_path();
+        landmarks.invalidate();
+        if (enable_dstar)
+          dstar.notify_cell_changed(p);
+        repair_path();
       }
     }
     else if (IsMouseButtonPressed(0))
     {
       Position &target = from;
       target = p;
-      new_path();
+      if (enable_dstar)
+        dstar.set_start(from);
+      repair_path();
     }
     else if (IsMouseButtonPressed(1))
     {
@@ -329,6 +288,7 @@ int main(int /*argc*/, const char ** /*argv*/)
     {
       gen_drunk_dungeon(navGrid, dungWidth, dungHeight, 24, 100);
       spill_drunk_water(navGrid, dungWidth, dungHeight, 8, 10);
+      landmarks.invalidate();
       from = dungeon::find_walkable_tile(navGrid, dungWidth, dungHeight);
       to = dungeon::find_walkable_tile(navGrid, dungWidth, dungHeight);
       new_path();
@@ -345,10 +305,26 @@ int main(int /*argc*/, const char ** /*argv*/)
       printf("new weight %f\n", weight);
       new_path();
     }
+    if (IsKeyPressed(KEY_R))
+    {
+      use_reference_a_star = !use_reference_a_star;
+      new_path();
+    }
+    if (IsKeyPressed(KEY_L))
+    {
+      use_landmarks = !use_landmarks;
+      new_path();
+    }
+    if (IsKeyPressed(KEY_B))
+    {
+      use_bidirectional = !use_bidirectional;
+      new_path();
+    }
     if (IsKeyPressed(KEY_I))
     {
       if (enable_ara) {
         ara_pathfinding->try_improve_path();
+        log_ara(*ara_pathfinding);
       }
     }
     if (IsKeyDown(KEY_TAB)) {
@@ -357,9 +333,11 @@ int main(int /*argc*/, const char ** /*argv*/)
     BeginDrawing();
       ClearBackground(BLACK);
       BeginMode2D(camera);
-        if (enable_ara) {
+        if (enable_dstar) {
+          draw_nav_data(dstar, navGrid, dungWidth, dungHeight);
+        } else if (enable_ara) {
           draw_nav_grid(navGrid, dungWidth, dungHeight);
-          ara_pathfinding->draw_expanded();
+          draw_expanded(*ara_pathfinding, dungWidth, dungHeight);
           std::vector<Position> path = ara_pathfinding->get_path();
           draw_path(path);
         } else {
@@ -0,0 +1,317 @@
+#include "pathQueryService.h"
+#include "searchContext.h"
+#include "gridAStar.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <tuple>
+
+// with more starts the min over them costs more than the expansions it saves
+static constexpr size_t maxGuidedStarts = 8;
+
+// Dijkstra (A* towards the nearest start for small groups) from the goal over reversed edges:
+// an edge into a tile costs what entering it costs, so the tree gives every start its exact path.
+// Stops once all starts are closed.
+static void reverse_search(SearchContext &ctx, GridView grid, uint32_t goal, const std::vector<uint32_t> &starts)
+{
+  const size_t width = grid.width;
+  auto toPos = [&](uint32_t idx) { return Position{int(idx % width), int(idx / width)}; };
+  auto h = [&](Position p)
+  {
+    if (starts.size() > maxGuidedStarts)
+      return 0.f;
+    float best = std::numeric_limits<float>::max();
+    for (uint32_t s : starts)
+      best = std::min(best, heuristic(toPos(s), p));
+    return best;
+  };
+  auto isStart = [&](uint32_t idx) { return std::binary_search(starts.begin(), starts.end(), idx); };
+
+  ctx.begin(grid.width, grid.height);
+  ctx.set(goal, 0.f, -1);
+  ctx.open.push(goal, {h(toPos(goal)), 0.f});
+  size_t remaining = starts.size();
+  while (!ctx.open.empty() && remaining > 0)
+  {
+    const uint32_t curIdx = ctx.open.pop();
+    ctx.close(curIdx);
+    if (isStart(curIdx))
+      --remaining;
+    // reversed edges lead into curIdx
+    if (!dungeon::is_passable(grid.tiles[curIdx]))
+      continue;
+    const Position curPos = toPos(curIdx);
+    const float curG = ctx.g(curIdx) + dungeon::move_cost(grid.tiles[curIdx]);
+    auto checkNeighbour = [&](Position p)
+    {
+      // out of bounds
+      if (p.x < 0 || p.y < 0 || p.x >= int(grid.width) || p.y >= int(grid.height))
+        return;
+      const uint32_t idx = uint32_t(size_t(p.y) * width + size_t(p.x));
+      if (ctx.is_closed(idx))
+        return;
+      // a path may start on a wall, it just can't go through one
+      if (!dungeon::is_passable(grid.tiles[idx]) && !isStart(idx))
+        return;
+      if (curG < ctx.g(idx))
+      {
+        ctx.set(idx, curG, int(curIdx));
+        ctx.open.update(idx, {curG + h(p), curG});
+      }
+    };
+    checkNeighbour({curPos.x + 1, curPos.y + 0});
+    checkNeighbour({curPos.x - 1, curPos.y + 0});
+    checkNeighbour({curPos.x + 0, curPos.y + 1});
+    checkNeighbour({curPos.x + 0, curPos.y - 1});
+  }
+}
+
+PathQueryService::PathQueryService(size_t threads)
+{
+  threads = std::max<size_t>(threads, 1);
+  m_workers.reserve(threads);
+  for (size_t i = 0; i < threads; ++i)
+    m_workers.emplace_back([this]() { worker_loop(); });
+}
+
+PathQueryService::~PathQueryService()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_jobReady.notify_all();
+  for (std::thread &worker : m_workers)
+    worker.join();
+}
+
+PathHandle PathQueryService::submit_cells(GridView grid, int fromX, int fromY, int toX, int toY, float weight)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_stats.submitted += 1;
+  auto inBounds = [&](int x, int y) { return x >= 0 && y >= 0 && x < int(grid.width) && y < int(grid.height); };
+  const bool valid = grid.tiles && inBounds(fromX, fromY) && inBounds(toX, toY);
+  const uint32_t from = valid ? uint32_t(size_t(fromY) * grid.width + size_t(fromX)) : 0;
+  const uint32_t to = valid ? uint32_t(size_t(toY) * grid.width + size_t(toX)) : 0;
+
+  const RequestKey key{grid.tiles, grid.width, grid.height, from, to, weight};
+  if (valid)
+  {
+    auto it = m_batch.find(key);
+    if (it != m_batch.end())
+    {
+      Slot &slot = m_slots[it->second];
+      slot.refs += 1;
+      m_stats.deduplicated += 1;
+      return PathHandle{it->second, slot.generation};
+    }
+  }
+
+  uint32_t slotIdx;
+  if (!m_freeSlots.empty())
+  {
+    slotIdx = m_freeSlots.back();
+    m_freeSlots.pop_back();
+  }
+  else
+  {
+    slotIdx = uint32_t(m_slots.size());
+    m_slots.emplace_back();
+    m_slots.back().index = slotIdx;
+  }
+  Slot &slot = m_slots[slotIdx];
+  slot.grid = grid;
+  slot.from = from;
+  slot.to = to;
+  slot.weight = weight;
+  slot.refs = 1;
+  slot.path.clear();
+  if (!valid || from == to)
+  {
+    // nothing to search for
+    if (valid)
+      slot.path.push_back(from);
+    slot.dispatched = true;
+    slot.status = valid ? Status::Found : Status::NoPath;
+  }
+  else
+  {
+    slot.dispatched = false;
+    slot.status = Status::Pending;
+    m_pending.push_back(slotIdx);
+    m_batch.emplace(key, slotIdx);
+  }
+  return PathHandle{slotIdx, slot.generation};
+}
+
+void PathQueryService::flush()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (m_pending.empty())
+    return;
+  // released before dispatch, nobody waits for these
+  m_pending.erase(std::remove_if(m_pending.begin(), m_pending.end(), [&](uint32_t idx)
+  {
+    Slot &slot = m_slots[idx];
+    if (slot.refs > 0)
+      return false;
+    slot.generation += 1;
+    m_freeSlots.push_back(idx);
+    return true;
+  }), m_pending.end());
+
+  // requests over the same grid with the same goal end up next to each other
+  auto groupKey = [&](uint32_t idx)
+  {
+    const Slot &slot = m_slots[idx];
+    return std::make_tuple(slot.grid.tiles, slot.grid.width, slot.grid.height, slot.to, slot.from);
+  };
+  std::sort(m_pending.begin(), m_pending.end(), [&](uint32_t lhs, uint32_t rhs) { return groupKey(lhs) < groupKey(rhs); });
+  for (size_t begin = 0; begin < m_pending.size();)
+  {
+    const Slot &first = m_slots[m_pending[begin]];
+    size_t end = begin + 1;
+    while (end < m_pending.size() && m_slots[m_pending[end]].grid.tiles == first.grid.tiles &&
+           m_slots[m_pending[end]].grid.width == first.grid.width && m_slots[m_pending[end]].grid.height == first.grid.height &&
+           m_slots[m_pending[end]].to == first.to)
+      ++end;
+    Job job;
+    job.grid = first.grid;
+    job.to = first.to;
+    for (size_t i = begin; i < end; ++i)
+    {
+      Slot &slot = m_slots[m_pending[i]];
+      slot.dispatched = true;
+      job.slots.push_back(&slot);
+    }
+    m_stats.searches += 1;
+    if (job.slots.size() > 1)
+      m_stats.coalesced += job.slots.size();
+    m_jobs.push_back(std::move(job));
+    begin = end;
+  }
+  m_pending.clear();
+  m_batch.clear();
+  lock.unlock();
+  m_jobReady.notify_all();
+}
+
+const PathQueryService::Slot *PathQueryService::ready_slot(PathHandle handle) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (handle.slot >= m_slots.size())
+    return nullptr;
+  const Slot &slot = m_slots[handle.slot];
+  if (slot.generation != handle.generation || slot.status == Status::Pending)
+    return nullptr;
+  return &slot;
+}
+
+PathQueryService::Status PathQueryService::status(PathHandle handle) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  // stale handles read as NoPath, there is nothing to wait for
+  if (handle.slot >= m_slots.size() || m_slots[handle.slot].generation != handle.generation)
+    return Status::NoPath;
+  return m_slots[handle.slot].status;
+}
+
+void PathQueryService::wait(PathHandle handle)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (handle.slot >= m_slots.size() || m_slots[handle.slot].generation != handle.generation)
+    return;
+  if (!m_slots[handle.slot].dispatched)
+  {
+    lock.unlock();
+    flush();
+    lock.lock();
+  }
+  const Slot &slot = m_slots[handle.slot];
+  m_jobDone.wait(lock, [&]() { return slot.status != Status::Pending; });
+}
+
+void PathQueryService::release(PathHandle &handle)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (handle.slot < m_slots.size())
+  {
+    Slot &slot = m_slots[handle.slot];
+    if (slot.generation == handle.generation && slot.refs > 0 && --slot.refs == 0 &&
+        slot.status != Status::Pending)
+    {
+      // pending slots are recycled by flush() or by the worker that finishes them
+      slot.generation += 1;
+      m_freeSlots.push_back(handle.slot);
+    }
+  }
+  handle = PathHandle{};
+}
+
+PathServiceStats PathQueryService::stats() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_stats;
+}
+
+void PathQueryService::worker_loop()
+{
+  SearchContext ctx;
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true)
+  {
+    m_jobReady.wait(lock, [&]() { return m_stop || !m_jobs.empty(); });
+    if (m_stop)
+      return;
+    Job job = std::move(m_jobs.front());
+    m_jobs.pop_front();
+    lock.unlock();
+    run_job(job, ctx);
+    lock.lock();
+    for (Slot *slot : job.slots)
+    {
+      slot->status = slot->found ? Status::Found : Status::NoPath;
+      if (slot->refs == 0)
+      {
+        // released while in flight
+        slot->generation += 1;
+        m_freeSlots.push_back(slot->index);
+      }
+    }
+    m_jobDone.notify_all();
+  }
+}
+
+// fills path and found of every slot, the caller publishes them
+void PathQueryService::run_job(Job &job, SearchContext &ctx)
+{
+  const GridView grid = job.grid;
+  auto toPos = [&](uint32_t idx) { return Position{int(idx % grid.width), int(idx / grid.width)}; };
+  if (job.slots.size() == 1)
+  {
+    thread_local std::vector<Position> path;
+    Slot &slot = *job.slots.front();
+    const bool found = find_path_a_star(ctx, grid.tiles, grid.width, grid.height, toPos(slot.from), toPos(job.to), slot.weight, path);
+    slot.path.resize(path.size());
+    for (size_t i = 0; i < path.size(); ++i)
+      slot.path[i] = uint32_t(size_t(path[i].y) * grid.width + size_t(path[i].x));
+    slot.found = found;
+    return;
+  }
+
+  // same goal: one search from the goal, every start follows the back pointers to it
+  std::vector<uint32_t> starts;
+  starts.reserve(job.slots.size());
+  for (const Slot *slot : job.slots)
+    starts.push_back(slot->from);
+  std::sort(starts.begin(), starts.end());
+  reverse_search(ctx, grid, job.to, starts);
+  for (Slot *slot : job.slots)
+  {
+    slot->path.clear();
+    const bool found = ctx.is_closed(slot->from);
+    if (found)
+      for (int i = int(slot->from); i >= 0; i = ctx.prev(size_t(i)))
+        slot->path.push_back(uint32_t(i));
+    slot->found = found;
+  }
+}
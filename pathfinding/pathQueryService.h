@@ -0,0 +1,167 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class SearchContext;
+
+// Read-only tile grid the service searches over: '#' can't be entered, 'o' costs 10, anything else 1.
+// The tiles must stay alive and unchanged until every request submitted on them is ready.
+struct GridView
+{
+  const char *tiles = nullptr;
+  size_t width = 0;
+  size_t height = 0;
+};
+
+inline GridView make_grid_view(const char *tiles, size_t width, size_t height) { return GridView{tiles, width, height}; }
+// DungeonData of w4-w7 and anything else that keeps its tiles in a vector<char> next to width/height
+template<typename Grid>
+GridView make_grid_view(const Grid &grid) { return GridView{grid.tiles.data(), grid.width, grid.height}; }
+
+struct PathHandle
+{
+  uint32_t slot = ~0u;
+  uint32_t generation = 0;
+
+  bool valid() const { return slot != ~0u; }
+};
+
+struct PathServiceStats
+{
+  size_t submitted = 0;
+  size_t deduplicated = 0; // requests answered by an identical request of the same batch
+  size_t searches = 0;     // searches dispatched to the workers
+  size_t coalesced = 0;    // requests answered by a shared reverse search
+};
+
+// Batched path queries for many agents per turn.
+// submit() only records a request, flush() groups the batch and hands it to the worker pool:
+// identical (grid, from, to, weight) requests share one result, requests with the same goal
+// are answered by a single reverse search from the goal (exact, so it satisfies any weight),
+// the rest run forward weighted A*. Every worker owns its search context.
+// Handles are polled with ready() and emptied with take(), usually on the next frame.
+class PathQueryService
+{
+public:
+  enum class Status : uint8_t
+  {
+    Pending,
+    Found,
+    NoPath,
+  };
+
+  explicit PathQueryService(size_t threads = std::thread::hardware_concurrency());
+  ~PathQueryService();
+  PathQueryService(const PathQueryService &) = delete;
+  PathQueryService &operator=(const PathQueryService &) = delete;
+
+  template<typename Vec>
+  PathHandle submit(GridView grid, Vec from, Vec to, float weight = 1.f)
+  {
+    return submit_cells(grid, from.x, from.y, to.x, to.y, weight);
+  }
+  // dispatches everything submitted since the last flush
+  void flush();
+
+  Status status(PathHandle handle) const;
+  bool ready(PathHandle handle) const { return status(handle) != Status::Pending; }
+  // blocks until the handle is ready, flushes first if it wasn't dispatched yet
+  void wait(PathHandle handle);
+
+  // writes the path (from first) and releases the handle, false if there is none or it isn't ready yet
+  template<typename Vec>
+  bool take(PathHandle &handle, std::vector<Vec> &path)
+  {
+    path.clear();
+    const Slot *slot = ready_slot(handle);
+    if (!slot)
+      return false;
+    const bool found = slot->status == Status::Found;
+    if (found)
+    {
+      path.resize(slot->path.size());
+      for (size_t i = 0; i < path.size(); ++i)
+        path[i] = Vec{int(slot->path[i] % slot->grid.width), int(slot->path[i] / slot->grid.width)};
+    }
+    release(handle);
+    return found;
+  }
+  // drops the result without reading it, the request still finishes if it was dispatched
+  void release(PathHandle &handle);
+
+  size_t threads() const { return m_workers.size(); }
+  PathServiceStats stats() const;
+
+private:
+  struct Slot
+  {
+    Status status = Status::Pending; // guarded by m_mutex, final once not Pending
+    std::vector<uint32_t> path; // cell indices, written by the worker before status is set
+    bool found = false;         // worker's result, published as status under the mutex
+    GridView grid;
+    uint32_t from = 0;
+    uint32_t to = 0;
+    float weight = 1.f;
+    uint32_t index = 0;
+    uint32_t generation = 0;
+    uint32_t refs = 0;
+    bool dispatched = false;
+  };
+  // one search, either a single forward query or every request of a goal
+  struct Job
+  {
+    GridView grid;
+    uint32_t to = 0;
+    std::vector<Slot *> slots; // pointers, workers must not index m_slots while it grows
+  };
+  // the same tiles pointer can be reused for a grid of another size, cell indices only match with the dimensions
+  struct RequestKey
+  {
+    const char *tiles;
+    size_t width;
+    size_t height;
+    uint32_t from;
+    uint32_t to;
+    float weight;
+
+    bool operator==(const RequestKey &rhs) const
+    {
+      return tiles == rhs.tiles && width == rhs.width && height == rhs.height && from == rhs.from && to == rhs.to && weight == rhs.weight;
+    }
+  };
+  struct RequestKeyHash
+  {
+    size_t operator()(const RequestKey &key) const
+    {
+      size_t h = std::hash<const char *>()(key.tiles);
+      h = h * 31 + key.width;
+      h = h * 31 + key.height;
+      h = h * 31 + key.from;
+      h = h * 31 + key.to;
+      return h * 31 + std::hash<float>()(key.weight);
+    }
+  };
+
+  PathHandle submit_cells(GridView grid, int fromX, int fromY, int toX, int toY, float weight);
+  const Slot *ready_slot(PathHandle handle) const;
+  void worker_loop();
+  void run_job(Job &job, SearchContext &ctx);
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_jobReady;
+  std::condition_variable m_jobDone;
+  std::deque<Slot> m_slots; // deque keeps slots in place while it grows under the workers
+  std::vector<uint32_t> m_freeSlots;
+  std::vector<uint32_t> m_pending;
+  std::unordered_map<RequestKey, uint32_t, RequestKeyHash> m_batch; // dedupe within the pending batch
+  std::deque<Job> m_jobs;
+  std::vector<std::thread> m_workers;
+  PathServiceStats m_stats;
+  bool m_stop = false;
+};
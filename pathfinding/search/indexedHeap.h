@@ -0,0 +1,130 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Binary min-heap over dense ids [0, capacity) with O(1) membership test and
+// O(log n) decrease-key. Keys only need operator<.
+template<typename Key>
+class IndexedHeap
+{
+  static constexpr uint32_t npos = ~0u;
+
+  std::vector<uint32_t> m_heap; // heap slot -> id
+  std::vector<uint32_t> m_slot; // id -> heap slot, npos if not in heap
+  std::vector<Key> m_keys;      // id -> key (valid only while in heap)
+
+  void place(size_t slot, uint32_t id)
+  {
+    m_heap[slot] = id;
+    m_slot[id] = uint32_t(slot);
+  }
+  void sift_up(size_t slot)
+  {
+    const uint32_t id = m_heap[slot];
+    while (slot > 0)
+    {
+      const size_t parent = (slot - 1) / 2;
+      if (!(m_keys[id] < m_keys[m_heap[parent]]))
+        break;
+      place(slot, m_heap[parent]);
+      slot = parent;
+    }
+    place(slot, id);
+  }
+  void sift_down(size_t slot)
+  {
+    const uint32_t id = m_heap[slot];
+    const size_t count = m_heap.size();
+    while (true)
+    {
+      size_t child = slot * 2 + 1;
+      if (child >= count)
+        break;
+      if (child + 1 < count && m_keys[m_heap[child + 1]] < m_keys[m_heap[child]])
+        child += 1;
+      if (!(m_keys[m_heap[child]] < m_keys[id]))
+        break;
+      place(slot, m_heap[child]);
+      slot = child;
+    }
+    place(slot, id);
+  }
+public:
+  // Grows id storage if needed and empties the heap. Cost is O(size) after the first call.
+  void reset(size_t capacity)
+  {
+    clear();
+    if (m_slot.size() < capacity)
+    {
+      m_slot.resize(capacity, npos);
+      m_keys.resize(capacity);
+    }
+  }
+  void clear()
+  {
+    for (uint32_t id : m_heap)
+      m_slot[id] = npos;
+    m_heap.clear();
+  }
+
+  bool empty() const { return m_heap.empty(); }
+  size_t size() const { return m_heap.size(); }
+  bool contains(uint32_t id) const { return m_slot[id] != npos; }
+  const Key &key(uint32_t id) const { return m_keys[id]; }
+
+  // ids currently in the heap, in heap order
+  const std::vector<uint32_t> &ids() const { return m_heap; }
+
+  uint32_t top() const { return m_heap.front(); }
+  const Key &top_key() const { return m_keys[m_heap.front()]; }
+
+  void push(uint32_t id, const Key &key)
+  {
+    m_keys[id] = key;
+    m_heap.push_back(id);
+    sift_up(m_heap.size() - 1);
+  }
+  // inserts id or moves it to the new key (in any direction)
+  void update(uint32_t id, const Key &key)
+  {
+    if (!contains(id))
+    {
+      push(id, key);
+      return;
+    }
+    const bool up = key < m_keys[id];
+    m_keys[id] = key;
+    if (up)
+      sift_up(m_slot[id]);
+    else
+      sift_down(m_slot[id]);
+  }
+  // recomputes every key with key_of(id) and restores the heap property in O(n)
+  template<typename KeyOf>
+  void rekey(KeyOf &&key_of)
+  {
+    for (uint32_t id : m_heap)
+      m_keys[id] = key_of(id);
+    for (size_t slot = m_heap.size() / 2; slot-- > 0;)
+      sift_down(slot);
+  }
+  uint32_t pop()
+  {
+    const uint32_t id = m_heap.front();
+    remove(id);
+    return id;
+  }
+  void remove(uint32_t id)
+  {
+    const size_t slot = m_slot[id];
+    const uint32_t last = m_heap.back();
+    m_heap.pop_back();
+    m_slot[id] = npos;
+    if (last == id)
+      return;
+    place(slot, last);
+    sift_up(slot);
+    sift_down(m_slot[last]);
+  }
+};
@@ -0,0 +1,85 @@
+#pragma once
+#include "indexedHeap.h"
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+// Scratch state of one grid search: g values, back pointers, closed set and open list.
+// Entries are generation-stamped, so starting a new query is O(1) and nothing is
+// allocated once the context has seen the grid size. Keep one per thread and reuse it.
+class SearchContext
+{
+  std::vector<uint32_t> m_touched; // == m_generation if m_g/m_prev were written this query
+  std::vector<uint32_t> m_closed;  // == m_closedGeneration if closed
+  std::vector<float> m_g;
+  std::vector<int> m_prev;
+  uint32_t m_generation = 0;
+  uint32_t m_closedGeneration = 0;
+  size_t m_width = 0;
+
+public:
+  struct OpenKey
+  {
+    float f;
+    float g;
+    // prefer deeper nodes on ties, it cuts expansions on open floor
+    bool operator<(const OpenKey &rhs) const { return f < rhs.f || (f == rhs.f && g > rhs.g); }
+  };
+  IndexedHeap<OpenKey> open;
+
+  // starts a new query over a width x height grid
+  void begin(size_t width, size_t height)
+  {
+    const size_t size = width * height;
+    m_width = width;
+    if (m_g.size() < size)
+    {
+      m_touched.resize(size, 0);
+      m_closed.resize(size, 0);
+      m_g.resize(size);
+      m_prev.resize(size);
+    }
+    open.reset(size);
+    if (++m_generation == 0) // wrapped around, old stamps could alias
+    {
+      std::fill(m_touched.begin(), m_touched.end(), 0);
+      m_generation = 1;
+    }
+    reset_closed();
+  }
+  // empties the closed set only, g values and back pointers stay (ARA* iterations)
+  void reset_closed()
+  {
+    if (++m_closedGeneration == 0)
+    {
+      std::fill(m_closed.begin(), m_closed.end(), 0);
+      m_closedGeneration = 1;
+    }
+  }
+
+  size_t width() const { return m_width; }
+  float g(size_t idx) const { return m_touched[idx] == m_generation ? m_g[idx] : std::numeric_limits<float>::max(); }
+  int prev(size_t idx) const { return m_touched[idx] == m_generation ? m_prev[idx] : -1; }
+  void set(size_t idx, float gValue, int prevIdx)
+  {
+    m_touched[idx] = m_generation;
+    m_g[idx] = gValue;
+    m_prev[idx] = prevIdx;
+  }
+  bool is_closed(size_t idx) const { return m_closed[idx] == m_closedGeneration; }
+  void close(size_t idx) { m_closed[idx] = m_closedGeneration; }
+
+  // writes the path ending at idx in forward order, reusing out's storage
+  template<typename Vec>
+  void write_path(size_t idx, std::vector<Vec> &out) const
+  {
+    size_t len = 0;
+    for (int i = int(idx); i >= 0; i = prev(size_t(i)))
+      ++len;
+    out.resize(len);
+    for (int i = int(idx); i >= 0; i = prev(size_t(i)))
+      out[--len] = Vec{i % int(m_width), i / int(m_width)};
+  }
+};
@@ -1,164 +1,127 @@
 #include "dijkstraMapGen.h"
 #include "dungeonUtils.h"
 
-template<typename Callable>
-static void query_dungeon_data(flecs::world &ecs, Callable c)
-{
-  static auto dungeonDataQuery = ecs.query<const DungeonData>();
+using dmaps::invalid_tile_value;
 
-  dungeonDataQuery.each(c);
+static uint32_t cell_of(const Position &pos, const dmaps::DmapWorld &world)
+{
+  return uint32_t(pos.y) * uint32_t(world.width) + uint32_t(pos.x);
 }
 
-template<typename Callable>
-static void query_characters_positions(flecs::world &ecs, Callable c)
+static bool is_tile_walkable(const dmaps::DmapWorld &world, Position pos)
 {
-  static auto characterPositionQuery = ecs.query<const Position, const Team, const Hitpoints>();
-
-  characterPositionQuery.each(c);
+  if (pos.x < 0 || pos.x >= int(world.width) ||
+      pos.y < 0 || pos.y >= int(world.height))
+    return false;
+  return world.tiles[size_t(pos.y) * world.width + size_t(pos.x)] == dungeon::floor;
 }
 
-constexpr float invalid_tile_value = 1e5f;
-
-static void init_tiles(std::vector<float> &map, const DungeonData &dd)
+// swaps in this turn's seeds and repairs the map around the ones that changed
+static void update_dmap(dmaps::IncrementalDmap &dmap, const dmaps::DmapWorld &world, const std::vector<dmaps::DmapSeed> &seeds)
 {
-  map.resize(dd.width * dd.height);
-  for (float &v : map)
-    v = invalid_tile_value;
+  if (world.tiles.empty())
+    return;
+  if (dmap.width() != world.width || dmap.height() != world.height)
+    dmap.reset(world.width, world.height);
+  dmap.set_seeds(seeds);
+  dmap.update(world.tiles.data());
 }
 
-// scan version, could be implemented as Dijkstra version as well
-static void process_dmap(std::vector<float> &map, const DungeonData &dd)
+void dmaps::gather_dmap_world(flecs::world &ecs, DmapWorld &world)
 {
-  bool done = false;
-  auto getMapAt = [&](size_t x, size_t y, float def)
+  static auto dungeonDataQuery = ecs.query<const DungeonData>();
+  static auto characterPositionQuery = ecs.query<const Position, const Team, const Hitpoints>();
+  static auto hiveQuery = ecs.query<const Position, const Hive>();
+  static auto visibilityQuery = ecs.query<const DungeonVisibility>();
+
+  world.tiles.clear();
+  world.width = world.height = 0;
+  dungeonDataQuery.each([&](const DungeonData &dd)
   {
-    if (x < dd.width && y < dd.width && dd.tiles[y * dd.width + x] == dungeon::floor)
-      return map[y * dd.width + x];
-    return def;
-  };
-  auto getMinNei = [&](size_t x, size_t y)
+    world.tiles = dd.tiles;
+    world.width = dd.width;
+    world.height = dd.height;
+  });
+  world.characters.clear();
+  characterPositionQuery.each([&](const Position &pos, const Team &t, const Hitpoints&)
   {
-    float val = map[y * dd.width + x];
-    val = std::min(val, getMapAt(x - 1, y + 0, val));
-    val = std::min(val, getMapAt(x + 1, y + 0, val));
-    val = std::min(val, getMapAt(x + 0, y - 1, val));
-    val = std::min(val, getMapAt(x + 0, y + 1, val));
-    return val;
-  };
-  while (!done)
+    world.characters.push_back({pos, t.team});
+  });
+  world.hives.clear();
+  hiveQuery.each([&](const Position &pos, const Hive &)
   {
-    done = true;
-    for (size_t y = 0; y < dd.height; ++y)
-      for (size_t x = 0; x < dd.width; ++x)
-      {
-        const size_t i = y * dd.width + x;
-        if (dd.tiles[i] != dungeon::floor)
-          continue;
-        const float myVal = getMapAt(x, y, invalid_tile_value);
-        const float minVal = getMinNei(x, y);
-        if (minVal < myVal - 1.f)
-        {
-          map[i] = minVal + 1.f;
-          done = false;
-        }
-      }
-  }
+    world.hives.push_back(pos);
+  });
+  world.visibility.clear();
+  visibilityQuery.each([&](const DungeonVisibility &dv)
+  {
+    world.visibility = dv.tiles;
+  });
 }
 
-void dmaps::gen_player_approach_map(flecs::world &ecs, std::vector<float> &map)
+void dmaps::gen_player_approach_map(const DmapWorld &world, IncrementalDmap &dmap)
 {
-  query_dungeon_data(ecs, [&](const DungeonData &dd)
-  {
-    init_tiles(map, dd);
-    query_characters_positions(ecs, [&](const Position &pos, const Team &t, const Hitpoints&)
-    {
-      if (t.team == 0) // player team hardcode
-        map[pos.y * dd.width + pos.x] = 0.f;
-    });
-    process_dmap(map, dd);
-  });
+  std::vector<DmapSeed> seeds;
+  for (const DmapCharacter &c : world.characters)
+    if (c.team == 0) // player team hardcode
+      seeds.push_back({cell_of(c.pos, world), 0.f});
+  update_dmap(dmap, world, seeds);
 }
 
-void dmaps::gen_melee_attack_map(flecs::world &ecs, const Team& team, std::vector<float> &map)
+void dmaps::gen_melee_attack_map(const DmapWorld &world, const Team& team, IncrementalDmap &dmap)
 {
-  query_dungeon_data(ecs, [&](const DungeonData &dd)
-  {
-    init_tiles(map, dd);
-    query_characters_positions(ecs, [&](const Position &pos, const Team &t, const Hitpoints&)
-    {
-      if (t.team != team.team)
-        map[pos.y * dd.width + pos.x] = 0.f;
-    });
-    process_dmap(map, dd);
-  });
+  std::vector<DmapSeed> seeds;
+  for (const DmapCharacter &c : world.characters)
+    if (c.team != team.team)
+      seeds.push_back({cell_of(c.pos, world), 0.f});
+  update_dmap(dmap, world, seeds);
 }
 
-void dmaps::gen_wizard_attack_map(flecs::world &ecs, const Team& team, std::vector<float> &map)
+void dmaps::gen_wizard_attack_map(const DmapWorld &world, const Team& team, IncrementalDmap &dmap)
 {
-  query_dungeon_data(ecs, [&](const DungeonData &dd)
+  std::vector<DmapSeed> seeds;
+  for (const DmapCharacter &c : world.characters)
   {
-    init_tiles(map, dd);
-    query_characters_positions(ecs, [&](const Position &pos, const Team &t, const Hitpoints&)
-    {
-      if (t.team != team.team) {
-        int radius = 4;
-        for (int i = -radius; i <= radius; ++i) {
-          int j = radius - std::abs(i); 
-          if (dungeon::is_tile_walkable(ecs, {pos.x + j, pos.y - i})) {
-            map[(pos.y - i) * dd.width + (pos.x + j)] = 0.f;
-          }
-          if (dungeon::is_tile_walkable(ecs, {pos.x - j, pos.y - i})) {
-            map[(pos.y - i) * dd.width + (pos.x - j)] = 0.f;
-          }
+    const Position &pos = c.pos;
+    if (c.team != team.team) {
+      int radius = 4;
+      for (int i = -radius; i <= radius; ++i) {
+        int j = radius - std::abs(i); 
+        if (is_tile_walkable(world, {pos.x + j, pos.y - i})) {
+          seeds.push_back({cell_of({pos.x + j, pos.y - i}, world), 0.f});
+        }
+        if (is_tile_walkable(world, {pos.x - j, pos.y - i})) {
+          seeds.push_back({cell_of({pos.x - j, pos.y - i}, world), 0.f});
         }
       }
-    });
-    process_dmap(map, dd);
-  });
+    }
+  }
+  update_dmap(dmap, world, seeds);
 }
 
-void dmaps::gen_explore_map(flecs::world &ecs, std::vector<float> &map)
+void dmaps::gen_explore_map(const DmapWorld &world, IncrementalDmap &dmap)
 {
-  query_dungeon_data(ecs, [&](const DungeonData &dd)
-  {
-    init_tiles(map, dd);
-    static auto visibilityQuery = ecs.query<const DungeonVisibility>();
-    visibilityQuery.each([&](const DungeonVisibility& dv) {
-      for (int i = 0; i < dv.height; ++i) {
-        for (int j = 0; j < dv.width; ++j) {
-          if (!dv.tiles[i * dv.width + j]) {
-            map[i * dv.width + j] = 0.f;
-          }
-        }
-      }
-    });
-    process_dmap(map, dd);
-  });
+  std::vector<DmapSeed> seeds;
+  for (size_t i = 0; i < world.visibility.size(); ++i)
+    if (!world.visibility[i])
+      seeds.push_back({uint32_t(i), 0.f});
+  update_dmap(dmap, world, seeds);
 }
 
-void dmaps::gen_player_flee_map(flecs::world &ecs, std::vector<float> &map)
+void dmaps::gen_player_flee_map(const DmapWorld &world, const std::vector<float> &approachMap, std::vector<float> &map)
 {
-  gen_player_approach_map(ecs, map);
+  map = approachMap;
   for (float &v : map)
     if (v < invalid_tile_value)
       v *= -1.2f;
-  query_dungeon_data(ecs, [&](const DungeonData &dd)
-  {
-    process_dmap(map, dd);
-  });
+  if (!world.tiles.empty())
+    process_dmap(map, world.tiles.data(), world.width, world.height);
 }
 
-void dmaps::gen_hive_pack_map(flecs::world &ecs, std::vector<float> &map)
+void dmaps::gen_hive_pack_map(const DmapWorld &world, IncrementalDmap &dmap)
 {
-  static auto hiveQuery = ecs.query<const Position, const Hive>();
-  query_dungeon_data(ecs, [&](const DungeonData &dd)
-  {
-    init_tiles(map, dd);
-    hiveQuery.each([&](const Position &pos, const Hive &)
-    {
-      map[pos.y * dd.width + pos.x] = 0.f;
-    });
-    process_dmap(map, dd);
-  });
+  std::vector<DmapSeed> seeds;
+  for (const Position &pos : world.hives)
+    seeds.push_back({cell_of(pos, world), 0.f});
+  update_dmap(dmap, world, seeds);
 }
-
@@ -2,14 +2,35 @@
 #include <vector>
 #include <flecs.h>
 #include "ecsTypes.h"
+#include "dmapEngine.h"
 
 namespace dmaps
 {
-  void gen_player_approach_map(flecs::world &ecs, std::vector<float> &map);
-  void gen_player_flee_map(flecs::world &ecs, std::vector<float> &map);
-  void gen_hive_pack_map(flecs::world &ecs, std::vector<float> &map);
-  void gen_melee_attack_map(flecs::world &ecs, const Team& team, std::vector<float> &map);
-  void gen_wizard_attack_map(flecs::world &ecs, const Team& team, std::vector<float> &map);
-  void gen_explore_map(flecs::world &ecs, std::vector<float> &map);
+  struct DmapCharacter
+  {
+    Position pos;
+    int team = 0;
+  };
+
+  // everything the maps are built from, read from the ECS once per turn so the generators can run on any thread
+  struct DmapWorld
+  {
+    std::vector<char> tiles; // empty before there's a dungeon
+    size_t width = 0;
+    size_t height = 0;
+    std::vector<DmapCharacter> characters;
+    std::vector<Position> hives;
+    std::vector<bool> visibility;
+  };
+  void gather_dmap_world(flecs::world &ecs, DmapWorld &world);
+
+  // these keep last turn's seeds in dmap and only repair what the moved seeds change
+  void gen_player_approach_map(const DmapWorld &world, IncrementalDmap &dmap);
+  void gen_hive_pack_map(const DmapWorld &world, IncrementalDmap &dmap);
+  void gen_melee_attack_map(const DmapWorld &world, const Team& team, IncrementalDmap &dmap);
+  void gen_wizard_attack_map(const DmapWorld &world, const Team& team, IncrementalDmap &dmap);
+  void gen_explore_map(const DmapWorld &world, IncrementalDmap &dmap);
+  // every approach value is a seed here, so it's always rebuilt in full
+  void gen_player_flee_map(const DmapWorld &world, const std::vector<float> &approachMap, std::vector<float> &map);
 };
 
@@ -0,0 +1,305 @@
+#include "dmapEngine.h"
+#include <algorithm>
+
+void dmaps::process_dmap(std::vector<float> &map, const char *tiles, size_t width, size_t height, DmapBackend backend)
+{
+  if (backend == DmapBackend::Scan)
+  {
+    process_dmap_scan(map, tiles, width, height);
+    return;
+  }
+  if (backend == DmapBackend::Sweep)
+  {
+    static thread_local DmapSweep sweep;
+    process_dmap_sweep(map, tiles, width, height, sweep);
+    return;
+  }
+  static thread_local DmapQueue queue;
+  process_dmap_queue(map, tiles, width, height, queue);
+}
+
+void dmaps::process_dmap_scan(std::vector<float> &map, const char *tiles, size_t width, size_t height)
+{
+  bool done = false;
+  auto getMapAt = [&](size_t x, size_t y, float def)
+  {
+    if (x < width && y < height && tiles[y * width + x] == floor_tile)
+      return map[y * width + x];
+    return def;
+  };
+  auto getMinNei = [&](size_t x, size_t y)
+  {
+    float val = map[y * width + x];
+    val = std::min(val, getMapAt(x - 1, y + 0, val));
+    val = std::min(val, getMapAt(x + 1, y + 0, val));
+    val = std::min(val, getMapAt(x + 0, y - 1, val));
+    val = std::min(val, getMapAt(x + 0, y + 1, val));
+    return val;
+  };
+  while (!done)
+  {
+    done = true;
+    for (size_t y = 0; y < height; ++y)
+      for (size_t x = 0; x < width; ++x)
+      {
+        const size_t i = y * width + x;
+        if (tiles[i] != floor_tile)
+          continue;
+        const float myVal = getMapAt(x, y, invalid_tile_value);
+        const float minVal = getMinNei(x, y);
+        if (minVal < myVal - 1.f)
+        {
+          map[i] = minVal + 1.f;
+          done = false;
+        }
+      }
+  }
+}
+
+// Every step costs 1, so cells reached from a closed cell come out in the same order the cells
+// were closed in. That makes the FIFO of relaxed cells a priority queue on its own, merging it
+// with the seeds sorted by value gives Dijkstra without a heap. Equal seeds skip the sort, that's BFS.
+// Leaves queue.closed all zero again, returns the number of cells closed.
+static size_t propagate(std::vector<float> &map, const char *tiles, size_t width, size_t height, dmaps::DmapQueue &queue)
+{
+  bool sameSeeds = true;
+  for (const auto &seed : queue.seeds)
+    sameSeeds = sameSeeds && seed.first == queue.seeds.front().first;
+  if (!sameSeeds)
+    std::sort(queue.seeds.begin(), queue.seeds.end());
+
+  queue.cells.clear();
+  size_t closedCount = 0;
+  size_t seedIdx = 0;
+  size_t head = 0;
+  while (seedIdx < queue.seeds.size() || head < queue.cells.size())
+  {
+    uint32_t cur;
+    if (head < queue.cells.size() && (seedIdx == queue.seeds.size() || map[queue.cells[head]] <= queue.seeds[seedIdx].first))
+      cur = queue.cells[head++];
+    else
+      cur = queue.seeds[seedIdx++].second;
+    if (queue.closed[cur])
+      continue; // a seed lowered by a neighbour, or reached twice
+    queue.closed[cur] = 1;
+    closedCount++;
+
+    const float val = map[cur];
+    auto relax = [&](size_t nei)
+    {
+      // same test as the scan, so float rounding goes the same way
+      if (tiles[nei] == dmaps::floor_tile && !queue.closed[nei] && val < map[nei] - 1.f)
+      {
+        map[nei] = val + 1.f;
+        queue.cells.push_back(uint32_t(nei));
+      }
+    };
+    const size_t x = cur % width;
+    const size_t y = cur / width;
+    if (x > 0)
+      relax(cur - 1);
+    if (x + 1 < width)
+      relax(cur + 1);
+    if (y > 0)
+      relax(cur - width);
+    if (y + 1 < height)
+      relax(cur + width);
+  }
+  // every closed cell is either a seed or was relaxed
+  for (const auto &seed : queue.seeds)
+    queue.closed[seed.second] = 0;
+  for (uint32_t cell : queue.cells)
+    queue.closed[cell] = 0;
+  return closedCount;
+}
+
+size_t dmaps::process_dmap_queue(std::vector<float> &map, const char *tiles, size_t width, size_t height, DmapQueue &queue)
+{
+  const size_t count = width * height;
+  queue.seeds.clear();
+  queue.closed.resize(count, 0);
+  for (size_t i = 0; i < count; ++i)
+    if (tiles[i] == floor_tile && map[i] < invalid_tile_value)
+      queue.seeds.emplace_back(map[i], uint32_t(i));
+  return propagate(map, tiles, width, height, queue);
+}
+
+void dmaps::IncrementalDmap::reset(size_t width, size_t height)
+{
+  const size_t count = width * height;
+  m_width = width;
+  m_height = height;
+  m_map.assign(count, invalid_tile_value);
+  m_seedValues.assign(count, invalid_tile_value);
+  m_seedSlots.assign(count, noSeed);
+  m_nextValues.assign(count, invalid_tile_value);
+  m_isRaised.assign(count, 0);
+  m_seedCells.clear();
+  m_removed.clear();
+  m_added.clear();
+  m_built = false;
+}
+
+void dmaps::IncrementalDmap::add_seed(size_t cell, float value)
+{
+  if (m_seedValues[cell] == value)
+    return;
+  remove_seed(cell);
+  m_seedValues[cell] = value;
+  m_seedSlots[cell] = uint32_t(m_seedCells.size());
+  m_seedCells.push_back(uint32_t(cell));
+  m_added.push_back(uint32_t(cell));
+}
+
+void dmaps::IncrementalDmap::remove_seed(size_t cell)
+{
+  const uint32_t slot = m_seedSlots[cell];
+  if (slot == noSeed)
+    return;
+  m_removed.push_back({uint32_t(cell), m_seedValues[cell]});
+  m_seedValues[cell] = invalid_tile_value;
+  const uint32_t last = m_seedCells.back();
+  m_seedCells[slot] = last;
+  m_seedSlots[last] = slot;
+  m_seedCells.pop_back();
+  m_seedSlots[cell] = noSeed;
+}
+
+void dmaps::IncrementalDmap::set_seeds(const std::vector<DmapSeed> &seeds)
+{
+  for (const DmapSeed &seed : seeds)
+    m_nextValues[seed.cell] = seed.value;
+  for (size_t i = 0; i < m_seedCells.size();)
+  {
+    const uint32_t cell = m_seedCells[i];
+    if (m_nextValues[cell] == invalid_tile_value)
+      remove_seed(cell); // the last seed moved into slot i
+    else
+      ++i;
+  }
+  for (const DmapSeed &seed : seeds)
+    add_seed(seed.cell, m_nextValues[seed.cell]);
+  for (const DmapSeed &seed : seeds)
+    m_nextValues[seed.cell] = invalid_tile_value;
+}
+
+void dmaps::IncrementalDmap::rebuild(const char *tiles)
+{
+  m_map.assign(m_width * m_height, invalid_tile_value);
+  for (uint32_t cell : m_seedCells)
+    m_map[cell] = m_seedValues[cell];
+  m_reachable = process_dmap_queue(m_map, tiles, m_width, m_height, m_queue);
+  m_touched = m_map.size();
+  m_built = true;
+}
+
+void dmaps::IncrementalDmap::update(const char *tiles)
+{
+  const size_t count = m_width * m_height;
+  if (!m_built)
+  {
+    rebuild(tiles);
+    m_removed.clear();
+    m_added.clear();
+    return;
+  }
+  m_touched = 0;
+  auto for_each_nei = [&](size_t cell, auto &&fn)
+  {
+    const size_t x = cell % m_width;
+    const size_t y = cell / m_width;
+    if (x > 0)
+      fn(cell - 1);
+    if (x + 1 < m_width)
+      fn(cell + 1);
+    if (y > 0)
+      fn(cell - m_width);
+    if (y + 1 < m_height)
+      fn(cell + m_width);
+  };
+
+  // lower first: new seeds below the current value spread from themselves, so the raise
+  // below only has to reset the cells that really lost their value
+  m_queue.seeds.clear();
+  m_queue.closed.resize(count, 0);
+  for (uint32_t cell : m_added)
+  {
+    const float value = m_seedValues[cell];
+    if (value == invalid_tile_value)
+      continue; // removed again
+    if (tiles[cell] != floor_tile)
+    {
+      m_map[cell] = value; // walls only hold their own seed
+      m_touched++;
+    }
+    else if (value < m_map[cell])
+    {
+      m_map[cell] = value;
+      m_queue.seeds.emplace_back(value, cell);
+    }
+  }
+  if (!m_queue.seeds.empty())
+    m_touched += propagate(m_map, tiles, m_width, m_height, m_queue);
+
+  // raise: a removed seed that still held its own value, and everything one step up the slope
+  // from a raised cell, may have got the value through it
+  m_raised.clear();
+  auto raise = [&](size_t cell)
+  {
+    m_isRaised[cell] = 1;
+    m_raised.push_back(uint32_t(cell));
+  };
+  for (const DmapSeed &removed : m_removed)
+  {
+    if (tiles[removed.cell] != floor_tile)
+    {
+      m_map[removed.cell] = m_seedValues[removed.cell];
+      m_touched++;
+    }
+    else if (m_map[removed.cell] == removed.value && !m_isRaised[removed.cell])
+      raise(removed.cell);
+  }
+  m_removed.clear();
+  m_added.clear();
+  for (size_t i = 0; i < m_raised.size(); ++i)
+  {
+    // resetting and refilling most of the map costs more than building it again
+    if (m_raised.size() > m_reachable / 2)
+    {
+      for (uint32_t cell : m_raised)
+        m_isRaised[cell] = 0;
+      rebuild(tiles);
+      return;
+    }
+    const float uphill = m_map[m_raised[i]] + 1.f;
+    for_each_nei(m_raised[i], [&](size_t nei)
+    {
+      if (tiles[nei] == floor_tile && !m_isRaised[nei] && m_map[nei] == uphill)
+        raise(nei);
+    });
+  }
+  if (m_raised.empty())
+    return;
+  for (uint32_t cell : m_raised)
+    m_map[cell] = m_seedValues[cell];
+
+  // the raised cells are refilled from the seeds among them and from their border
+  m_queue.seeds.clear();
+  auto source = [&](size_t cell)
+  {
+    if (m_map[cell] < invalid_tile_value)
+      m_queue.seeds.emplace_back(m_map[cell], uint32_t(cell));
+  };
+  for (uint32_t cell : m_raised)
+  {
+    source(cell);
+    for_each_nei(cell, [&](size_t nei)
+    {
+      if (tiles[nei] == floor_tile && !m_isRaised[nei])
+        source(nei);
+    });
+  }
+  m_touched += m_raised.size() + propagate(m_map, tiles, m_width, m_height, m_queue);
+  for (uint32_t cell : m_raised)
+    m_isRaised[cell] = 0;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// Dijkstra map propagation over the dungeon tiles, no flecs here so w5 and the headless benchmark can link it
+namespace dmaps
+{
+  constexpr float invalid_tile_value = 1e5f;
+  constexpr char floor_tile = ' '; // dungeon::floor, dmaps only spread over floor
+
+  enum class DmapBackend
+  {
+    Scan,  // relaxes the whole grid until nothing changes, O(W*H*diameter)
+    Queue, // BFS from the seeds, Dijkstra over sorted seeds when their values differ
+    Sweep, // SIMD down/up and right/left passes until nothing changes, for maps with many seeds
+  };
+
+  // buffers of the queue backend, kept between maps
+  struct DmapQueue
+  {
+    std::vector<std::pair<float, uint32_t>> seeds; // value, cell
+    std::vector<uint32_t> cells;                   // relaxed cells in the order they were reached
+    std::vector<uint8_t> closed;
+  };
+
+  // buffers of the sweep backend, kept between maps
+  struct DmapSweep
+  {
+    std::vector<float> transposed;
+    std::vector<uint8_t> rowEdges;    // 0xff where a cell and the one above it are both floor
+    std::vector<uint8_t> columnEdges; // the same for the cell to the left, transposed
+  };
+
+  // Lowers every floor cell to its lowest floor neighbour + 1 until no cell changes.
+  // Cells below invalid_tile_value are the seeds, any values are fine (the flee map seeds are negative).
+  // Walls keep their values and are never read. All backends give the same map bit for bit.
+  void process_dmap(std::vector<float> &map, const char *tiles, size_t width, size_t height,
+                    DmapBackend backend = DmapBackend::Queue);
+  void process_dmap_scan(std::vector<float> &map, const char *tiles, size_t width, size_t height);
+  // returns the number of cells the seeds reached, themselves included
+  size_t process_dmap_queue(std::vector<float> &map, const char *tiles, size_t width, size_t height, DmapQueue &queue);
+  // returns the number of rounds of all four passes, the last one changed nothing
+  size_t process_dmap_sweep(std::vector<float> &map, const char *tiles, size_t width, size_t height, DmapSweep &sweep);
+  // "avx2", "sse4.1" or "scalar", the row kernel process_dmap_sweep picked on this cpu
+  const char *dmap_sweep_isa();
+
+  struct DmapSeed
+  {
+    uint32_t cell;
+    float value;
+  };
+
+  // A dmap that keeps its seeds between turns. After a few seeds are added or removed, update repairs
+  // only the cells a new seed lowers and the cells that depended on a removed seed (raise: reset and
+  // refilled from their border). When a raise would cover more than half of the map it's rebuilt instead.
+  // The map is the same as a full process_dmap over the current seeds.
+  class IncrementalDmap
+  {
+    std::vector<float> m_map;
+    std::vector<float> m_seedValues;   // per cell, invalid_tile_value where there's no seed
+    std::vector<uint32_t> m_seedSlots; // per cell, index in m_seedCells or noSeed
+    std::vector<uint32_t> m_seedCells;
+    std::vector<DmapSeed> m_removed;   // since the last update, with the value they had
+    std::vector<uint32_t> m_added;
+    std::vector<uint32_t> m_raised;
+    std::vector<uint8_t> m_isRaised;
+    std::vector<float> m_nextValues;   // set_seeds scratch, invalid_tile_value outside of it
+    DmapQueue m_queue;
+    size_t m_width = 0;
+    size_t m_height = 0;
+    bool m_built = false;
+    size_t m_reachable = 0; // cells the last rebuild reached
+    size_t m_touched = 0;
+
+    static constexpr uint32_t noSeed = ~0u;
+
+    void rebuild(const char *tiles);
+  public:
+    // drops the seeds and the map, the next update rebuilds it from scratch
+    void reset(size_t width, size_t height);
+    size_t width() const { return m_width; }
+    size_t height() const { return m_height; }
+
+    // replaces the seed with the same cell, if any
+    void add_seed(size_t cell, float value);
+    void remove_seed(size_t cell);
+    // add_seed/remove_seed for the difference from the current seeds, a cell listed twice keeps the last value
+    void set_seeds(const std::vector<DmapSeed> &seeds);
+    const std::vector<uint32_t> &seed_cells() const { return m_seedCells; }
+
+    // repairs the map after the seed changes, tiles must stay the same between resets
+    void update(const char *tiles);
+    const std::vector<float> &map() const { return m_map; }
+    // cells the last update reset plus the cells its propagation closed, every cell for a full rebuild
+    size_t cells_touched() const { return m_touched; }
+  };
+}
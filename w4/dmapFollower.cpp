@@ -1,5 +1,6 @@
 #include "ecsTypes.h"
 #include "dmapFollower.h"
+#include "dmapRegistry.h"
 #include <cmath>
 
 void process_dmap_followers(flecs::world &ecs)
@@ -7,9 +8,9 @@ void process_dmap_followers(flecs::world &ecs)
   static auto processDmapFollowers = ecs.query<const Position, Action, const DmapWeights>();
   static auto dungeonDataQuery = ecs.query<const DungeonData>();
 
-  auto get_dmap_at = [&](const DijkstraMapData &dmap, const DungeonData &dd, size_t x, size_t y, float mult, float pow)
+  auto get_dmap_at = [&](const std::vector<float> &dmap, const DungeonData &dd, size_t x, size_t y, float mult, float pow)
   {
-    const float v = dmap.map[y * dd.width + x];
+    const float v = dmap[y * dd.width + x];
     if (v < 1e5f)
       return powf(v * mult, pow);
     return v;
@@ -23,14 +24,15 @@ void process_dmap_followers(flecs::world &ecs)
         moveWeights[i] = 0.f;
       for (const auto &pair : wt.weights)
       {
-        ecs.entity(pair.first.c_str()).get([&](const DijkstraMapData &dmap)
+        if (const std::vector<float> *map = dmap_registry().get(pair.first.c_str()))
         {
+          const std::vector<float> &dmap = *map;
           moveWeights[EA_NOP]         += get_dmap_at(dmap, dd, pos.x+0, pos.y+0, pair.second.mult, pair.second.pow);
           moveWeights[EA_MOVE_LEFT]   += get_dmap_at(dmap, dd, pos.x-1, pos.y+0, pair.second.mult, pair.second.pow);
           moveWeights[EA_MOVE_RIGHT]  += get_dmap_at(dmap, dd, pos.x+1, pos.y+0, pair.second.mult, pair.second.pow);
           moveWeights[EA_MOVE_UP]     += get_dmap_at(dmap, dd, pos.x+0, pos.y-1, pair.second.mult, pair.second.pow);
           moveWeights[EA_MOVE_DOWN]   += get_dmap_at(dmap, dd, pos.x+0, pos.y+1, pair.second.mult, pair.second.pow);
-        });
+        }
       }
       float minWt = moveWeights[EA_NOP];
       for (size_t i = 0; i < EA_MOVE_END; ++i)
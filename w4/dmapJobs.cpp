@@ -0,0 +1,95 @@
+#include "dmapJobs.h"
+#include <algorithm>
+#include <chrono>
+
+static double elapsed_us(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+dmaps::DmapJobGraph::DmapJobGraph(size_t threads)
+{
+  threads = std::max<size_t>(threads, 1);
+  m_workers.reserve(threads - 1);
+  for (size_t i = 1; i < threads; ++i)
+    m_workers.emplace_back([this]() { worker_loop(); });
+}
+
+dmaps::DmapJobGraph::~DmapJobGraph()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_jobReady.notify_all();
+  for (std::thread &worker : m_workers)
+    worker.join();
+}
+
+size_t dmaps::DmapJobGraph::add(std::function<void()> job, const std::vector<size_t> &deps)
+{
+  const size_t id = m_jobs.size();
+  m_jobs.push_back(Job{std::move(job), {}, deps.size()});
+  for (size_t dep : deps)
+    m_jobs[dep].dependents.push_back(id);
+  return id;
+}
+
+void dmaps::DmapJobGraph::run_ready(std::unique_lock<std::mutex> &lock)
+{
+  const size_t id = m_ready.back();
+  m_ready.pop_back();
+  lock.unlock();
+  const auto start = std::chrono::steady_clock::now();
+  m_jobs[id].fn();
+  const double jobUs = elapsed_us(start);
+  lock.lock();
+
+  m_jobsUs += jobUs;
+  for (size_t dependent : m_jobs[id].dependents)
+    if (--m_jobs[dependent].waiting == 0)
+    {
+      m_ready.push_back(dependent);
+      m_jobReady.notify_one();
+    }
+  if (--m_unfinished == 0)
+    m_jobReady.notify_all();
+}
+
+void dmaps::DmapJobGraph::worker_loop()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true)
+  {
+    m_jobReady.wait(lock, [&]() { return m_stop || !m_ready.empty(); });
+    if (m_stop)
+      return;
+    run_ready(lock);
+  }
+}
+
+void dmaps::DmapJobGraph::run()
+{
+  if (m_jobs.empty())
+    return;
+  const auto start = std::chrono::steady_clock::now();
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_unfinished = m_jobs.size();
+    m_jobsUs = 0.0;
+    for (size_t id = 0; id < m_jobs.size(); ++id)
+      if (m_jobs[id].waiting == 0)
+        m_ready.push_back(id);
+    m_jobReady.notify_all();
+    while (m_unfinished > 0)
+    {
+      if (!m_ready.empty())
+        run_ready(lock);
+      else
+        m_jobReady.wait(lock, [&]() { return m_unfinished == 0 || !m_ready.empty(); });
+    }
+    m_lastJobsUs = m_jobsUs;
+  }
+  m_jobs.clear();
+  m_lastRunUs = elapsed_us(start);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dmaps
+{
+  // A batch of jobs run on a persistent worker pool, a job starts once the jobs it depends on finished.
+  // Jobs must not touch the ECS, the calling thread gathers what they need before run().
+  class DmapJobGraph
+  {
+  public:
+    // threads includes the calling thread, 1 runs every job on it
+    explicit DmapJobGraph(size_t threads = std::thread::hardware_concurrency());
+    ~DmapJobGraph();
+    DmapJobGraph(const DmapJobGraph &) = delete;
+    DmapJobGraph &operator=(const DmapJobGraph &) = delete;
+
+    // deps are ids returned by add for the same batch, so they are always added first
+    size_t add(std::function<void()> job, const std::vector<size_t> &deps = {});
+    // runs the batch, the calling thread takes jobs as well, returns once every job finished
+    void run();
+
+    size_t threads() const { return m_workers.size() + 1; }
+    // wall time of the last run and the time its jobs took summed over threads, their ratio is the speedup
+    double last_run_us() const { return m_lastRunUs; }
+    double last_jobs_us() const { return m_lastJobsUs; }
+
+  private:
+    struct Job
+    {
+      std::function<void()> fn;
+      std::vector<size_t> dependents;
+      size_t waiting = 0; // unfinished deps
+    };
+
+    void worker_loop();
+    // takes a ready job, runs it unlocked and releases its dependents
+    void run_ready(std::unique_lock<std::mutex> &lock);
+
+    std::vector<Job> m_jobs; // only changed between runs
+    std::vector<size_t> m_ready;
+    size_t m_unfinished = 0;
+    double m_jobsUs = 0.0;
+    double m_lastRunUs = 0.0;
+    double m_lastJobsUs = 0.0;
+    std::mutex m_mutex;
+    std::condition_variable m_jobReady; // a job became ready or the batch finished
+    std::vector<std::thread> m_workers;
+    bool m_stop = false;
+  };
+}
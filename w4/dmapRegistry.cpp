@@ -0,0 +1,229 @@
+#include "dmapRegistry.h"
+#include <cstring>
+
+// order doesn't matter: the maps only depend on where the characters are, not on which entity stands where
+static uint64_t mix(uint64_t v)
+{
+  v += 0x9e3779b97f4a7c15ull;
+  v = (v ^ (v >> 30)) * 0xbf58476d1ce4e5b9ull;
+  v = (v ^ (v >> 27)) * 0x94d049bb133111ebull;
+  return v ^ (v >> 31);
+}
+
+static uint64_t position_key(const Position &pos)
+{
+  return (uint64_t(uint32_t(pos.x)) << 32) | uint32_t(pos.y);
+}
+
+static void fingerprint_inputs(const dmaps::DmapWorld &world, uint64_t fingerprints[32])
+{
+  memset(fingerprints, 0, sizeof(uint64_t) * 32);
+  uint64_t h = mix(world.width) ^ mix(world.height << 16);
+  for (char tile : world.tiles)
+    h = mix(h ^ uint8_t(tile));
+  fingerprints[0] = h;
+  for (const Position &pos : world.hives)
+    fingerprints[1] += mix(position_key(pos));
+  for (size_t i = 0; i < world.visibility.size(); ++i)
+    if (world.visibility[i])
+      fingerprints[2] += mix(i);
+  for (const dmaps::DmapCharacter &c : world.characters)
+  {
+    // + 1 so an empty team differs from one character at (0, 0)
+    fingerprints[3 + size_t(c.team) % dmapMaxTeams] += mix(position_key(c.pos)) + 1;
+  }
+}
+
+DmapRegistry::DmapRegistry(size_t threads) : m_jobs(threads)
+{
+}
+
+void DmapRegistry::add(const char *name, uint32_t inputs, Generator gen, const std::vector<std::string> &deps)
+{
+  Entry entry;
+  entry.name = name;
+  entry.inputs = inputs;
+  entry.gen = std::move(gen);
+  for (const std::string &dep : deps)
+    if (Entry *depEntry = find(dep.c_str()))
+      entry.deps.push_back(size_t(depEntry - m_entries.data()));
+  entry.depRevisions.resize(entry.deps.size());
+  m_entries.push_back(std::move(entry));
+}
+
+DmapRegistry::Entry *DmapRegistry::find(const char *name)
+{
+  for (Entry &entry : m_entries)
+    if (entry.name == name)
+      return &entry;
+  return nullptr;
+}
+
+void DmapRegistry::begin_turn(flecs::world &ecs)
+{
+  dmaps::gather_dmap_world(ecs, m_world);
+  uint64_t fingerprints[32];
+  fingerprint_inputs(m_world, fingerprints);
+  m_stamp++;
+  for (size_t i = 0; i < 32; ++i)
+    if (m_stamp == 1 || fingerprints[i] != m_inputFingerprints[i])
+    {
+      m_inputFingerprints[i] = fingerprints[i];
+      m_inputStamps[i] = m_stamp;
+    }
+  m_stats = DmapStats{};
+  build_requested();
+}
+
+bool DmapRegistry::stale(const Entry &entry) const
+{
+  if (entry.map == nullptr)
+    return true;
+  for (size_t i = 0; i < 32; ++i)
+    if ((entry.inputs & (1u << i)) && m_inputStamps[i] > entry.builtStamp)
+      return true;
+  for (size_t i = 0; i < entry.deps.size(); ++i)
+    if (m_entries[entry.deps[i]].revision != entry.depRevisions[i])
+      return true;
+  return false;
+}
+
+void DmapRegistry::build(Entry &entry)
+{
+  std::vector<const std::vector<float> *> deps;
+  for (size_t dep : entry.deps)
+    deps.push_back(m_entries[dep].map);
+  entry.lastBuild = entry.gen(m_world, deps);
+  entry.map = entry.lastBuild.map;
+}
+
+// done before the build runs, so the maps reading this one see it changed
+void DmapRegistry::mark_built(Entry &entry)
+{
+  entry.builtStamp = m_stamp;
+  entry.revision++;
+  for (size_t i = 0; i < entry.deps.size(); ++i)
+    entry.depRevisions[i] = m_entries[entry.deps[i]].revision;
+}
+
+void DmapRegistry::count_build(const Entry &entry)
+{
+  m_stats.mapsBuilt++;
+  m_stats.cellsTouched += entry.lastBuild.cellsTouched;
+  m_stats.rebuildCells += entry.map ? entry.map->size() : 0;
+}
+
+DmapRegistry::Entry &DmapRegistry::fresh(Entry &entry)
+{
+  for (size_t dep : entry.deps)
+    fresh(m_entries[dep]);
+  if (!stale(entry))
+    return entry;
+  mark_built(entry);
+  build(entry);
+  count_build(entry);
+  return entry;
+}
+
+void DmapRegistry::build_requested()
+{
+  // deps are added first, so walking back reaches the deps of the deps as well
+  for (size_t i = m_entries.size(); i-- > 0;)
+    if (m_entries[i].requested)
+      for (size_t dep : m_entries[i].deps)
+        m_entries[dep].requested = true;
+
+  if (m_jobs.threads() <= 1)
+  {
+    // nothing to run next to, the same builds in dependency order without the pool's locking
+    for (Entry &entry : m_entries)
+    {
+      if (entry.requested)
+        fresh(entry);
+      entry.requested = false;
+    }
+    m_stats.threads = 1;
+    return;
+  }
+
+  m_jobIds.assign(m_entries.size(), noJob);
+  std::vector<size_t> depJobs;
+  for (size_t i = 0; i < m_entries.size(); ++i)
+  {
+    Entry &entry = m_entries[i];
+    if (!entry.requested || !stale(entry))
+      continue;
+    depJobs.clear();
+    for (size_t dep : entry.deps)
+      if (m_jobIds[dep] != noJob)
+        depJobs.push_back(m_jobIds[dep]);
+    m_jobIds[i] = m_jobs.add([this, &entry]() { build(entry); }, depJobs);
+    mark_built(entry);
+  }
+  m_jobs.run();
+
+  for (size_t i = 0; i < m_entries.size(); ++i)
+  {
+    if (m_jobIds[i] != noJob)
+      count_build(m_entries[i]);
+    m_entries[i].requested = false;
+  }
+  m_stats.threads = m_jobs.threads();
+  m_stats.wallUs = m_jobs.last_run_us();
+  m_stats.jobsUs = m_jobs.last_jobs_us();
+}
+
+const std::vector<float> *DmapRegistry::get(const char *name)
+{
+  Entry *entry = find(name);
+  if (!entry)
+    return nullptr;
+  entry->requested = true;
+  // nothing was read from the ECS yet
+  if (m_stamp == 0)
+    return nullptr;
+  return fresh(*entry).map;
+}
+
+DmapRegistry &dmap_registry()
+{
+  static DmapRegistry registry;
+  return registry;
+}
+
+// maps that keep their seeds in an IncrementalDmap between builds
+static DmapRegistry::Generator incremental(std::function<void(const dmaps::DmapWorld &, dmaps::IncrementalDmap &)> gen)
+{
+  return [gen = std::move(gen), dmap = dmaps::IncrementalDmap()](const dmaps::DmapWorld &world,
+                                                                  const std::vector<const std::vector<float> *> &) mutable
+  {
+    gen(world, dmap);
+    return DmapRegistry::Build{&dmap.map(), dmap.cells_touched()};
+  };
+}
+
+void register_dmaps(DmapRegistry &registry)
+{
+  registry.add("approach_map", DMI_TILES | dmap_team_input(0),
+    incremental([](const dmaps::DmapWorld &world, dmaps::IncrementalDmap &dmap) { dmaps::gen_player_approach_map(world, dmap); }));
+  registry.add("flee_map", DMI_TILES,
+    [map = std::vector<float>()](const dmaps::DmapWorld &world, const std::vector<const std::vector<float> *> &deps) mutable
+    {
+      dmaps::gen_player_flee_map(world, *deps[0], map);
+      return DmapRegistry::Build{&map, map.size()};
+    }, {"approach_map"});
+  registry.add("hive_map", DMI_TILES | DMI_HIVES,
+    incremental([](const dmaps::DmapWorld &world, dmaps::IncrementalDmap &dmap) { dmaps::gen_hive_pack_map(world, dmap); }));
+  // attack maps are seeded by everyone who isn't on the team
+  for (int team : {1, 2})
+  {
+    const std::string color = team == 1 ? "blue" : "red";
+    const uint32_t enemies = DMI_TILES | (dmapAllTeams & ~dmap_team_input(team));
+    registry.add((color + "_melee_attack_map").c_str(), enemies,
+      incremental([team](const dmaps::DmapWorld &world, dmaps::IncrementalDmap &dmap) { dmaps::gen_melee_attack_map(world, {team}, dmap); }));
+    registry.add((color + "_wizard_attack_map").c_str(), enemies,
+      incremental([team](const dmaps::DmapWorld &world, dmaps::IncrementalDmap &dmap) { dmaps::gen_wizard_attack_map(world, {team}, dmap); }));
+  }
+  registry.add("explore_map", DMI_TILES | DMI_VISIBILITY,
+    incremental([](const dmaps::DmapWorld &world, dmaps::IncrementalDmap &dmap) { dmaps::gen_explore_map(world, dmap); }));
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <functional>
+#include <cstdint>
+#include <flecs.h>
+#include "dijkstraMapGen.h"
+#include "dmapJobs.h"
+
+// what a dmap is built from, a map is rebuilt only after one of its inputs changed
+enum DmapInput : uint32_t
+{
+  DMI_TILES = 1 << 0,
+  DMI_HIVES = 1 << 1,      // positions of Hive entities
+  DMI_VISIBILITY = 1 << 2, // DungeonVisibility
+  DMI_TEAM0 = 1 << 3,      // positions of team 0 characters, dmap_team_input(team) for the others
+};
+constexpr size_t dmapMaxTeams = 29;
+constexpr uint32_t dmapAllTeams = ~0u << 3;
+
+inline uint32_t dmap_team_input(int team)
+{
+  return DMI_TEAM0 << (size_t(team) % dmapMaxTeams);
+}
+
+// dmap work since the last begin_turn
+struct DmapStats
+{
+  size_t mapsBuilt = 0;
+  size_t cellsTouched = 0;
+  size_t rebuildCells = 0; // what building the same maps from scratch would touch
+  size_t threads = 0;      // of the job graph begin_turn built them on, 1 - built serially without it
+  double wallUs = 0.0;     // of the job graph run, 0 when built serially
+  double jobsUs = 0.0;     // the same builds one after another
+};
+
+// Named Dijkstra maps built on demand. Every map declares its inputs and the maps it reads,
+// begin_turn reads the inputs from the ECS once and rebuilds the maps that were asked for
+// since the previous turn and have something changed, independent ones at the same time on
+// a worker pool when there's more than one hardware thread. get() builds anything else on the
+// calling thread the first time it's asked for.
+// Generators keep their buffers, so nothing is reallocated between turns.
+class DmapRegistry
+{
+public:
+  struct Build
+  {
+    const std::vector<float> *map = nullptr;
+    size_t cellsTouched = 0;
+  };
+  // runs on a worker, deps are the maps listed in add, in the same order
+  using Generator = std::function<Build(const dmaps::DmapWorld &world, const std::vector<const std::vector<float> *> &deps)>;
+
+  explicit DmapRegistry(size_t threads = std::thread::hardware_concurrency());
+
+private:
+  struct Entry
+  {
+    std::string name;
+    uint32_t inputs = 0;
+    std::vector<size_t> deps;
+    std::vector<uint64_t> depRevisions; // revisions of deps this map was built from
+    Generator gen;
+    const std::vector<float> *map = nullptr;
+    uint64_t builtStamp = 0;
+    uint64_t revision = 0; // bumped on every build
+    bool requested = false; // read since the last begin_turn
+    Build lastBuild;
+  };
+  std::vector<Entry> m_entries;
+  dmaps::DmapWorld m_world;
+  dmaps::DmapJobGraph m_jobs;
+  std::vector<size_t> m_jobIds; // per entry, job of this turn's build or noJob
+  uint64_t m_inputFingerprints[32] = {};
+  uint64_t m_inputStamps[32] = {}; // m_stamp when the input last changed
+  uint64_t m_stamp = 0;
+  DmapStats m_stats;
+
+  static constexpr size_t noJob = ~size_t(0);
+
+  Entry *find(const char *name);
+  bool stale(const Entry &entry) const;
+  // the generator part of a build, runs on a worker once the deps are built
+  void build(Entry &entry);
+  void mark_built(Entry &entry);
+  void count_build(const Entry &entry);
+  Entry &fresh(Entry &entry);
+  void build_requested();
+public:
+  // deps must be added before the maps that read them
+  void add(const char *name, uint32_t inputs, Generator gen, const std::vector<std::string> &deps = {});
+  // call where the inputs may have changed, after the turn's actions, nothing reads the ECS after it returns
+  void begin_turn(flecs::world &ecs);
+  // nullptr for an unknown name and before the first begin_turn
+  const std::vector<float> *get(const char *name);
+  const DmapStats &turn_stats() const { return m_stats; }
+};
+
+// the game's registry, filled by register_dmaps
+DmapRegistry &dmap_registry();
+void register_dmaps(DmapRegistry &registry);
@@ -0,0 +1,164 @@
+#include "dmapEngine.h"
+#include <algorithm>
+#include <cstring>
+
+// The row kernels are compiled for every instruction set and picked at runtime,
+// so the rest of the project keeps building for the baseline cpu.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define DMAP_SWEEP_X86 1
+#include <immintrin.h>
+#endif
+
+// Relaxes dst from src, the row next to it: where the edge between them is open and
+// src < dst - 1, dst = src + 1. Same test as process_dmap_scan, so the maps match bit for bit.
+// Returns true if any cell changed. Rounding can pass the test without changing the cell
+// (src = 3.6f), so that doesn't count, or the sweep would never settle.
+using RelaxRow = bool (*)(float *dst, const float *src, const uint8_t *edges, size_t count);
+
+static bool relax_row_scalar(float *dst, const float *src, const uint8_t *edges, size_t count)
+{
+  bool changed = false;
+  for (size_t i = 0; i < count; ++i)
+    if (edges[i] && src[i] < dst[i] - 1.f)
+    {
+      const float val = src[i] + 1.f;
+      changed |= val != dst[i];
+      dst[i] = val;
+    }
+  return changed;
+}
+
+#ifdef DMAP_SWEEP_X86
+__attribute__((target("avx2")))
+static bool relax_row_avx2(float *dst, const float *src, const uint8_t *edges, size_t count)
+{
+  const __m256 one = _mm256_set1_ps(1.f);
+  int changed = 0;
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    const __m256 d = _mm256_loadu_ps(dst + i);
+    const __m256 s = _mm256_loadu_ps(src + i);
+    // 0xff bytes widen to all-ones lanes
+    const __m256 open = _mm256_castsi256_ps(_mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(edges + i))));
+    const __m256 lower = _mm256_and_ps(_mm256_cmp_ps(s, _mm256_sub_ps(d, one), _CMP_LT_OQ), open);
+    const __m256 res = _mm256_blendv_ps(d, _mm256_add_ps(s, one), lower);
+    _mm256_storeu_ps(dst + i, res);
+    changed |= _mm256_movemask_ps(_mm256_cmp_ps(res, d, _CMP_NEQ_UQ));
+  }
+  return relax_row_scalar(dst + i, src + i, edges + i, count - i) || changed;
+}
+
+__attribute__((target("sse4.1")))
+static bool relax_row_sse41(float *dst, const float *src, const uint8_t *edges, size_t count)
+{
+  const __m128 one = _mm_set1_ps(1.f);
+  int changed = 0;
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    const __m128 d = _mm_loadu_ps(dst + i);
+    const __m128 s = _mm_loadu_ps(src + i);
+    int edges4;
+    memcpy(&edges4, edges + i, sizeof(edges4));
+    const __m128 open = _mm_castsi128_ps(_mm_cvtepi8_epi32(_mm_cvtsi32_si128(edges4)));
+    const __m128 lower = _mm_and_ps(_mm_cmplt_ps(s, _mm_sub_ps(d, one)), open);
+    const __m128 res = _mm_blendv_ps(d, _mm_add_ps(s, one), lower);
+    _mm_storeu_ps(dst + i, res);
+    changed |= _mm_movemask_ps(_mm_cmpneq_ps(res, d));
+  }
+  return relax_row_scalar(dst + i, src + i, edges + i, count - i) || changed;
+}
+#endif
+
+struct SweepKernel
+{
+  RelaxRow relax;
+  const char *isa;
+};
+
+static SweepKernel pick_kernel()
+{
+#ifdef DMAP_SWEEP_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return {relax_row_avx2, "avx2"};
+  if (__builtin_cpu_supports("sse4.1"))
+    return {relax_row_sse41, "sse4.1"};
+#endif
+  return {relax_row_scalar, "scalar"};
+}
+
+static const SweepKernel &sweep_kernel()
+{
+  static const SweepKernel kernel = pick_kernel();
+  return kernel;
+}
+
+const char *dmaps::dmap_sweep_isa()
+{
+  return sweep_kernel().isa;
+}
+
+// blocks keep both sides of the transpose in cache
+static void transpose(const float *from, float *to, size_t width, size_t height)
+{
+  constexpr size_t block = 32;
+  for (size_t by = 0; by < height; by += block)
+    for (size_t bx = 0; bx < width; bx += block)
+    {
+      const size_t ey = std::min(by + block, height);
+      const size_t ex = std::min(bx + block, width);
+      for (size_t y = by; y < ey; ++y)
+        for (size_t x = bx; x < ex; ++x)
+          to[x * height + y] = from[y * width + x];
+    }
+}
+
+// a down pass then an up pass over rows of `count` cells, edges[r] is the edge between rows r - 1 and r
+static bool sweep_rows(RelaxRow relax, float *map, const uint8_t *edges, size_t count, size_t rows)
+{
+  bool changed = false;
+  for (size_t r = 1; r < rows; ++r)
+    changed |= relax(map + r * count, map + (r - 1) * count, edges + r * count, count);
+  for (size_t r = rows; r-- > 1;)
+    changed |= relax(map + (r - 1) * count, map + r * count, edges + r * count, count);
+  return changed;
+}
+
+// Vertical passes relax whole rows at once, so they run on the map and on its transposed copy
+// for the horizontal ones. Every round lowers each cell along any path that turns at most
+// twice per round, mazes need more rounds than open caves full of seeds.
+size_t dmaps::process_dmap_sweep(std::vector<float> &map, const char *tiles, size_t width, size_t height, DmapSweep &sweep)
+{
+  const size_t count = width * height;
+  if (count == 0)
+    return 0;
+  sweep.rowEdges.assign(count, 0);
+  sweep.columnEdges.assign(count, 0);
+  sweep.transposed.resize(count);
+  for (size_t y = 0; y < height; ++y)
+    for (size_t x = 0; x < width; ++x)
+    {
+      const size_t i = y * width + x;
+      if (tiles[i] != floor_tile)
+        continue;
+      if (y > 0 && tiles[i - width] == floor_tile)
+        sweep.rowEdges[i] = 0xff;
+      if (x > 0 && tiles[i - 1] == floor_tile)
+        sweep.columnEdges[x * height + y] = 0xff;
+    }
+
+  const RelaxRow relax = sweep_kernel().relax;
+  size_t rounds = 0;
+  bool changed = true;
+  while (changed)
+  {
+    changed = sweep_rows(relax, map.data(), sweep.rowEdges.data(), width, height);
+    transpose(map.data(), sweep.transposed.data(), width, height);
+    changed |= sweep_rows(relax, sweep.transposed.data(), sweep.columnEdges.data(), height, width);
+    transpose(sweep.transposed.data(), map.data(), height, width);
+    ++rounds;
+  }
+  return rounds;
+}
@@ -176,11 +176,6 @@ struct DungeonVisibility
   size_t height;
 };
 
-struct DijkstraMapData
-{
-  std::vector<float> map;
-};
-
 struct VisualiseMap {};
 
 struct DmapWeights
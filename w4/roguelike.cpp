@@ -8,6 +8,7 @@
 #include "dungeonUtils.h"
 #include "dijkstraMapGen.h"
 #include "dmapFollower.h"
+#include "dmapRegistry.h"
 
 static flecs::entity create_player_approacher(flecs::entity e)
 {
@@ -375,14 +376,14 @@ static void register_roguelike_systems(flecs::world &ecs)
             float sum = 0.f;
             for (const auto &pair : wt.weights)
             {
-              ecs.entity(pair.first.c_str()).get([&](const DijkstraMapData &dmap)
+              if (const std::vector<float> *dmap = dmap_registry().get(pair.first.c_str()))
               {
-                float v = dmap.map[y * dd.width + x];
+                float v = (*dmap)[y * dd.width + x];
                 if (v < 1e5f)
                   sum += powf(v * pair.second.mult, pair.second.pow);
                 else
                   sum += v;
-              });
+              }
             }
             if (sum < 1e5f)
               DrawText(TextFormat("%.1f", sum),
@@ -390,16 +391,20 @@ static void register_roguelike_systems(flecs::world &ecs)
           }
       });
     });
-  ecs.system<const DijkstraMapData>()
+  ecs.system()
     .with<VisualiseMap>()
-    .each([](const DijkstraMapData &dmap)
+    .without<DmapWeights>()
+    .each([&](flecs::entity e)
     {
+      const std::vector<float> *dmap = dmap_registry().get(e.name().c_str());
+      if (!dmap)
+        return;
       dungeonDataQuery.each([&](const DungeonData &dd)
       {
         for (size_t y = 0; y < dd.height; ++y)
           for (size_t x = 0; x < dd.width; ++x)
           {
-            const float val = dmap.map[y * dd.width + x];
+            const float val = (*dmap)[y * dd.width + x];
             if (val < 1e5f)
               DrawText(TextFormat("%.1f", val),
                   (float(x) + 0.2f) * tile_size, (float(y) + 0.5f) * tile_size, 150, WHITE);
@@ -478,6 +483,8 @@ void init_roguelike(flecs::world &ecs)
   ecs.entity("world")
     .set(TurnCounter{})
     .set(ActionLog{});
+
+  register_dmaps(dmap_registry());
 }
 
 void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
@@ -576,16 +583,17 @@ static Action playerExplore(flecs::world &ecs) {
     for (size_t i = 0; i < EA_MOVE_END; ++i)
       moveWeights[i] = 0.f;
 
-    auto get_dmap_at = [&](const DijkstraMapData &dmap, const DungeonData &dd, size_t x, size_t y, float mult, float pow)
+    auto get_dmap_at = [&](const std::vector<float> &dmap, const DungeonData &dd, size_t x, size_t y, float mult, float pow)
     {
-      const float v = dmap.map[y * dd.width + x];
+      const float v = dmap[y * dd.width + x];
       if (v < 1e5f)
         return powf(v * mult, pow);
       return v;
     };
 
     ecs.each([&](const DungeonData& dd) {
-      ecs.entity("explore_map").get([&](const DijkstraMapData &dmap) {
+      if (const std::vector<float> *exploreMap = dmap_registry().get("explore_map")) {
+        const std::vector<float> &dmap = *exploreMap;
         playerExploreQuery.each([&](const IsPlayer&, const Position& pos) {
           moveWeights[EA_NOP]         = get_dmap_at(dmap, dd, pos.x+0, pos.y+0, 1, 1);
           moveWeights[EA_MOVE_LEFT]   = get_dmap_at(dmap, dd, pos.x-1, pos.y+0, 1, 1);
@@ -593,7 +601,7 @@ static Action playerExplore(flecs::world &ecs) {
           moveWeights[EA_MOVE_UP]     = get_dmap_at(dmap, dd, pos.x+0, pos.y-1, 1, 1);
           moveWeights[EA_MOVE_DOWN]   = get_dmap_at(dmap, dd, pos.x+0, pos.y+1, 1, 1);
         });
-    });
+      }
     });
 
     Action act;
@@ -821,45 +829,8 @@ void process_turn(flecs::world &ecs)
     }
     process_actions(ecs);
 
-    std::vector<float> approachMap;
-    dmaps::gen_player_approach_map(ecs, approachMap);
-    ecs.entity("approach_map")
-      .set(DijkstraMapData{approachMap});
-
-    std::vector<float> fleeMap;
-    dmaps::gen_player_flee_map(ecs, fleeMap);
-    ecs.entity("flee_map")
-      .set(DijkstraMapData{fleeMap});
-
-    std::vector<float> hiveMap;
-    dmaps::gen_hive_pack_map(ecs, hiveMap);
-    ecs.entity("hive_map")
-      .set(DijkstraMapData{hiveMap});
-
-    std::vector<float> blueMeleeAttackMap;
-    dmaps::gen_melee_attack_map(ecs, {1}, blueMeleeAttackMap);
-    ecs.entity("blue_melee_attack_map")
-      .set(DijkstraMapData{blueMeleeAttackMap});
-
-    std::vector<float> redMeleeAttackMap;
-    dmaps::gen_melee_attack_map(ecs, {2}, redMeleeAttackMap);
-    ecs.entity("red_melee_attack_map")
-      .set(DijkstraMapData{redMeleeAttackMap});
-
-    std::vector<float> blueWizardAttackMap;
-    dmaps::gen_wizard_attack_map(ecs, {1}, blueWizardAttackMap);
-    ecs.entity("blue_wizard_attack_map")
-      .set(DijkstraMapData{blueWizardAttackMap});
-
-    std::vector<float> redWizardAttackMap;
-    dmaps::gen_wizard_attack_map(ecs, {2}, redWizardAttackMap);
-    ecs.entity("red_wizard_attack_map")
-      .set(DijkstraMapData{redWizardAttackMap});
-
-    std::vector<float> exploreMap;
-    dmaps::gen_explore_map(ecs, exploreMap);
-    ecs.entity("explore_map")
-      .set(DijkstraMapData{exploreMap});
+    // rebuilds the maps followers and the overlay read on a worker pool, ready before the next turn's followers
+    dmap_registry().begin_turn(ecs);
 
     //ecs.entity("flee_map").add<VisualiseMap>();
     ecs.entity("hive_follower_sum")
@@ -878,6 +849,14 @@ void print_stats(flecs::world &ecs)
     DrawText(TextFormat("power: %d", int(dmg.damage)), 20, 40, 20, WHITE);
   });
 
+  const DmapStats &dmapStats = dmap_registry().turn_stats();
+  DrawText(TextFormat("dmaps built: %d, cells: %d of %d", int(dmapStats.mapsBuilt), int(dmapStats.cellsTouched),
+                      int(dmapStats.rebuildCells)), 20, 60, 20, WHITE);
+  if (dmapStats.threads > 1)
+    DrawText(TextFormat("dmap jobs: %.2f ms on %d threads, %.2f ms serial (x%.1f)", dmapStats.wallUs * 1e-3,
+                        int(dmapStats.threads), dmapStats.jobsUs * 1e-3, dmapStats.jobsUs / std::max(dmapStats.wallUs, 1e-3)),
+             20, 80, 20, WHITE);
+
   static auto actionLogQuery = ecs.query<const ActionLog>();
   actionLogQuery.each([&](const ActionLog &l)
   {
@@ -3,13 +3,18 @@
 // #include "pathfinder.h"
 // #include "dungeonUtils.h"
 #include <queue>
+#include <algorithm>
 #include <iostream>
+#include <chrono>
 
-size_t coord_to_idx(int x, int y, size_t w)
+static size_t coord_to_idx(int x, int y, size_t w)
 {
   return size_t(y) * w + size_t(x);
 }
 
+// file local, pathfinding/ara.h has its own Compare and both end up in the benchmark binary
+namespace
+{
 struct CandidateForExpand
 {
     IVec2 pos;
@@ -24,8 +29,9 @@ public:
         return a.cost > b.cost;
     }
 };
+}
 
-std::vector<int> HierarchicalPathFinder::calc_distances_inside_tile(std::vector<InitialToExpand> froms, DungeonData& dungeon_data, IVec2 tile_pos, int tile_size) {
+std::vector<int> HierarchicalPathFinder::calc_distances_inside_tile(const std::vector<InitialToExpand>& froms, const DungeonData& dungeon_data, IVec2 tile_pos, int tile_size) {
     int tile_pos_x = tile_pos.x;
     int tile_pos_y = tile_pos.y;
 
@@ -75,7 +81,8 @@ std::vector<int> HierarchicalPathFinder::calc_distances_inside_tile(std::vector<
     }
     return dists;
 }
-void HierarchicalPathFinder::connect_portal(size_t new_portal_idx, IVec2 portal_pos, DungeonPortals& portals, DungeonData& dungeon_data) 
+// fills portal.conns with the portals of its cluster it can reach, returns the distances inside the cluster
+std::vector<int> HierarchicalPathFinder::connect_portal(PathPortal& portal, IVec2 portal_pos, const DungeonPortals& portals, const DungeonData& dungeon_data) 
 {
     const int tile_size = portals.tileSplit;
     const int tile_pos_x = portal_pos.x / tile_size;
@@ -88,9 +95,12 @@ void HierarchicalPathFinder::connect_portal(size_t new_portal_idx, IVec2 portal_
     const size_t tile_index = tile_pos_x + tile_pos_y * width;
     const IVec2 tile_offset = IVec2{tile_pos_x * tile_size, tile_pos_y * tile_size};
     
+    portal.startX = portal.endX = static_cast<size_t>(portal_pos.x);
+    portal.startY = portal.endY = static_cast<size_t>(portal_pos.y);
+    portal.conns.clear();
     const std::vector<size_t> &same_tile_other_portals_indices = portals.tilePortalsIndices[tile_index];
     for (const size_t other_idx : same_tile_other_portals_indices) {
-        PathPortal& other_portal = portals.portals[other_idx];
+        const PathPortal& other_portal = portals.portals[other_idx];
 
         int min_dist_to_new_portal = std::numeric_limits<int>::max();
         bool hasPath = true;
@@ -115,170 +125,193 @@ void HierarchicalPathFinder::connect_portal(size_t new_portal_idx, IVec2 portal_
             }
         }
         if (hasPath) {
-            other_portal.conns.push_back({new_portal_idx, (float)min_dist_to_new_portal});
-            portals.portals[new_portal_idx].conns.push_back({other_idx, (float)min_dist_to_new_portal});
+            portal.conns.push_back({other_idx, static_cast<float>(min_dist_to_new_portal)});
         }
     }
-
-    portals.tilePortalsIndices[tile_index].push_back(new_portal_idx);
+    return dists_to_new_portal;
 }
 
-void HierarchicalPathFinder::disconnect_portal(size_t portal_idx, DungeonPortals& portals, IVec2 portal_pos, size_t dd_width) {
-    int tile_size = portals.tileSplit;
-    const size_t width = dd_width / tile_size;
-    const int tile_pos_x = portal_pos.x / tile_size;
-    const int tile_pos_y = portal_pos.y / tile_size;
-    const size_t tile_index = tile_pos_x + tile_pos_y * width;
-
-    std::vector<PortalConnection>& removable_conns = portals.portals[portal_idx].conns;
-    for (PortalConnection& removable_connection : removable_conns) {
-        std::vector<PortalConnection>& other_conns = portals.portals[removable_connection.connIdx].conns;
-
-        for (int i = 0; i < other_conns.size(); ++i) {
-            if (other_conns[i].connIdx == portal_idx) {
-                other_conns.erase(other_conns.begin() + i);
-                break;
-            }
-        }
-    }
-    removable_conns.clear();
-    for (int i = 0; i < portals.tilePortalsIndices[tile_index].size(); ++i) {
-        if (portals.tilePortalsIndices[tile_index][i] == portal_idx) {
-            portals.tilePortalsIndices[tile_index].erase(portals.tilePortalsIndices[tile_index].begin() + i);
+// start-end edge from the distances of whichever of them was just connected, distances are symmetric
+void HierarchicalPathFinder::connect_start_end(const std::vector<int>& dists, IVec2 other, size_t tile_size) {
+    std::vector<PortalConnection>& conns = m_start_portal.conns;
+    for (size_t i = 0; i < conns.size(); ++i) {
+        if (conns[i].connIdx == m_end_portal_idx) {
+            conns.erase(conns.begin() + std::ptrdiff_t(i));
+            break;
         }
     }
+    if (m_start == IVec2{-1, -1} || m_end == IVec2{-1, -1})
+        return;
+    const int tile = static_cast<int>(tile_size);
+    const IVec2 tile_pos{m_start.x / tile, m_start.y / tile};
+    if (tile_pos != IVec2{m_end.x / tile, m_end.y / tile})
+        return;
+    const IVec2 pos_inside_tile = other - IVec2{tile_pos.x * tile, tile_pos.y * tile};
+    const int dist = dists[coord_to_idx(pos_inside_tile.x, pos_inside_tile.y, tile_size)];
+    if (dist != std::numeric_limits<int>::max())
+        conns.push_back({m_end_portal_idx, float(dist)});
 }
 
-float HierarchicalPathFinder::heuristic(size_t first_portal_idx, size_t second_portal_idx, DungeonPortals& portals) {
-    PathPortal& first = portals.portals[first_portal_idx];
-    PathPortal& second = portals.portals[second_portal_idx];
-
-    int x_dist = std::min(std::abs((int)first.startX - (int)second.endX), std::abs((int)second.startX - (int)first.endX));
-    int y_dist = std::min(std::abs((int)first.startY - (int)second.endY), std::abs((int)second.startY - (int)first.endY));
+const PathPortal& HierarchicalPathFinder::get_portal(const DungeonPortals& dp, size_t portal_idx) const {
+    if (portal_idx == m_start_portal_idx)
+        return m_start_portal;
+    if (portal_idx == m_end_portal_idx)
+        return m_end_portal;
+    return dp.portals[portal_idx];
+}
 
-    return x_dist + y_dist;
+// edges of the virtual portals are only stored on their side, start-end on the start
+float HierarchicalPathFinder::edge_score(size_t first_portal_idx, size_t second_portal_idx, const DungeonPortals& portals) const {
+    if (second_portal_idx == m_start_portal_idx || (second_portal_idx == m_end_portal_idx && first_portal_idx != m_start_portal_idx))
+        std::swap(first_portal_idx, second_portal_idx);
+    const PathPortal& first = get_portal(portals, first_portal_idx);
+    for (const PortalConnection& connection : first.conns) {
+        if (connection.connIdx == second_portal_idx)
+            return connection.score;
+    }
+    return -1.f;
 }
-std::vector<int> HierarchicalPathFinder::reconstruct_path(const std::vector<int>& prev, size_t to_portal_idx) {
-  int curIdx = to_portal_idx;
-  std::vector<int> res = {curIdx};
-  while (prev[curIdx] != -1)
-  {
-    curIdx = prev[curIdx];
-    res.insert(res.begin(), curIdx);
-  }
-  return res;
+
+// ALT bound to the end. The start is expanded first and never reached again, so it needs none
+float HierarchicalPathFinder::heuristic(size_t portal_idx) const {
+    if (!m_landmarks || portal_idx == m_start_portal_idx || portal_idx == m_end_portal_idx)
+        return 0.f;
+    return m_landmarks->heuristic(m_landmarks->dists_of(portal_idx), m_end_landmark_dists.data());
 }
-std::vector<int> HierarchicalPathFinder::find_path_a_star(DungeonPortals& portals, size_t from_portal_idx, size_t to_portal_idx)
-{
-  std::vector<float> g(portals.portals.size(), std::numeric_limits<float>::max());
-  std::vector<float> f(portals.portals.size(), std::numeric_limits<float>::max());
-  std::vector<int> prev(portals.portals.size(), -1);
 
-  std::vector<size_t> openList = {from_portal_idx};
-  std::vector<size_t> closedList;
+// walks the back pointers twice: once for the length, once writing from the back
+void HierarchicalPathFinder::reconstruct_path(size_t to_portal_idx, std::vector<int>& path) const {
+  size_t len = 0;
+  for (int i = int(to_portal_idx); i >= 0; i = m_ctx.prev(size_t(i)))
+    ++len;
+  path.resize(len);
+  for (int i = int(to_portal_idx); i >= 0; i = m_ctx.prev(size_t(i)))
+    path[--len] = i;
+}
 
-  g[from_portal_idx] = 0;
-  f[from_portal_idx] = heuristic(from_portal_idx, to_portal_idx, portals);
+bool HierarchicalPathFinder::find_path_a_star(const FrozenPortalGraph& graph, size_t from_portal_idx, size_t to_portal_idx, std::vector<int>& path)
+{
+  const auto start_time = std::chrono::steady_clock::now();
+  // graph portals plus the virtual start and end
+  m_ctx.begin(graph.portal_count() + 2, 1);
+  const size_t tile_size = graph.tileSplit;
+  const size_t end_tile_x = size_t(m_end.x) / tile_size;
+  const size_t end_tile_y = size_t(m_end.y) / tile_size;
+
+  // landmark row of the end, it reaches the graph only through its edges
+  if (m_landmarks) {
+    m_end_landmark_dists.assign(m_landmarks->count, PortalLandmarks::unknown);
+    for (const PortalConnection& connection : m_end_portal.conns)
+      m_landmarks->add_edge(m_end_landmark_dists.data(), connection.connIdx, connection.score);
+  }
 
-  while (!openList.empty())
+  m_last_expanded = 0;
+  path.clear();
+  m_ctx.set(from_portal_idx, 0.f, -1);
+  m_ctx.open.push(uint32_t(from_portal_idx), {heuristic(from_portal_idx), 0.f});
+  bool found = false;
+  while (!m_ctx.open.empty())
   {
-    size_t bestIdx = 0;
-    float bestScore = f[openList[0]];
-    for (size_t i = 1; i < openList.size(); ++i)
-    {
-      float score = f[openList[i]];
-      if (score < bestScore)
-      {
-        bestIdx = i;
-        bestScore = score;
-      }
-    }
-    size_t expanded_idx = openList[bestIdx];
+    const size_t expanded_idx = m_ctx.open.pop();
     if (expanded_idx == to_portal_idx) {
-        return reconstruct_path(prev, to_portal_idx);
+        found = true;
+        break;
     }
-    PathPortal& curPortal = portals.portals[expanded_idx];
-    openList.erase(openList.begin() + bestIdx);
+    m_ctx.close(expanded_idx);
+    m_last_expanded += 1;
+    const float cur_g = m_ctx.g(expanded_idx);
 
-    auto checkNeighbour = [&](size_t neighbour_idx, int cost)
+    // the landmark bound is consistent, a closed portal already has its shortest path
+    auto checkNeighbour = [&](size_t neighbour_idx, float cost)
     {
-      float gScore = g[expanded_idx] + cost;
-      if (gScore < g[neighbour_idx])
+      const float gScore = cur_g + cost;
+      if (!m_ctx.is_closed(neighbour_idx) && gScore < m_ctx.g(neighbour_idx))
       {
-        prev[neighbour_idx] = expanded_idx;
-        g[neighbour_idx] = gScore;
-        f[neighbour_idx] = gScore + heuristic(neighbour_idx, to_portal_idx, portals);
-        openList.emplace_back(neighbour_idx);
+        m_ctx.set(neighbour_idx, gScore, int(expanded_idx));
+        m_ctx.open.update(uint32_t(neighbour_idx), {gScore + heuristic(neighbour_idx), gScore});
       }
     };
-    for (const PortalConnection& connection : curPortal.conns) {
-        checkNeighbour(connection.connIdx, connection.score);
+    // the end is never expanded, the search stops on it
+    if (expanded_idx == m_start_portal_idx) {
+        for (const PortalConnection& connection : m_start_portal.conns)
+            checkNeighbour(connection.connIdx, connection.score);
+        continue;
     }
-  }
-  // empty path
-  return std::vector<int>();
-}
-
- std::vector<IVec2> HierarchicalPathFinder::get_portal_ceils(DungeonPortals& dp, int portal_idx, int dd_width) {
-    PathPortal& portal = dp.portals[portal_idx];
-
-    const int tile_size = dp.tileSplit;
-    const size_t width = dd_width / tile_size;
-
-    std::vector<IVec2> portal_ceils;
-
-    for (int fromY = portal.startY; fromY <= portal.endY; ++fromY)
-    {
-        for (int fromX = portal.startX; fromX <= portal.endX; ++fromX)
-        {
-            portal_ceils.push_back(IVec2{fromX, fromY});
+    for (uint32_t e = graph.edgeOffsets[expanded_idx]; e < graph.edgeOffsets[expanded_idx + 1]; ++e)
+        checkNeighbour(graph.edgeTargets[e], float(graph.edgeCosts[e]));
+    // the end only keeps its edges on its side, portals of its cluster look them up there
+    const FrozenPortalGraph::Portal& cur_rect = graph.portals[expanded_idx];
+    const bool touches_end_tile = (cur_rect.startX / tile_size == end_tile_x && cur_rect.startY / tile_size == end_tile_y) ||
+                                  (cur_rect.endX / tile_size == end_tile_x && cur_rect.endY / tile_size == end_tile_y);
+    if (touches_end_tile) {
+        for (const PortalConnection& connection : m_end_portal.conns) {
+            if (connection.connIdx == expanded_idx) {
+                checkNeighbour(m_end_portal_idx, connection.score);
+                break;
+            }
         }
     }
-    return portal_ceils;
- }
-void HierarchicalPathFinder::find_path(DungeonPortals &dp, DungeonData &dd, IVec2 from, IVec2 to) 
-{
-    if (!m_initialized) {
-        // reserve indices for start and end points
-        m_start_portal_idx = dp.portals.size();
-        dp.portals.push_back({});
-
-        m_end_portal_idx = dp.portals.size();
-        dp.portals.push_back({});
+  }
+  if (found)
+    reconstruct_path(to_portal_idx, path);
+  m_last_search_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start_time).count();
+  return found;
+}
 
-        m_start = {-1, -1};
-        m_end   = {-1, -1};
-        m_initialized = true;
+// distance of a cell of seed's cluster, counted in path cells like calc_distances_inside_tile
+int HierarchicalPathFinder::seed_dist(const TileSeed& seed, const DungeonPortals& dp, size_t idx_inside_tile) const {
+    if (seed.field == startField || seed.field == endField) {
+        const int dist = (seed.field == startField ? m_start_dists : m_end_dists)[idx_inside_tile];
+        return dist == std::numeric_limits<int>::max() ? dist : seed.cost + dist;
     }
-    bool need_update = false;
-
-    if (from != m_start) {
-        disconnect_portal(m_start_portal_idx, dp, m_start, dd.width);
+    const uint32_t dist = cluster_dist(dp, size_t(seed.tile_idx), size_t(seed.field), idx_inside_tile);
+    return dist == noClusterDist ? std::numeric_limits<int>::max() : seed.cost + 1 + int(dist);
+}
 
+void HierarchicalPathFinder::find_path(const DungeonPortals &dp, const FrozenPortalGraph &graph, const DungeonData &dd, IVec2 from, IVec2 to,
+                                       const PortalLandmarks *landmarks)
+{
+    // tables of another graph would bound with the wrong portals, search without them
+    if (landmarks && (landmarks->revision != graph.revision || landmarks->portalCount != graph.portal_count()))
+        landmarks = nullptr;
+    // a different heuristic or a refrozen graph needs a new search even if the endpoints stay
+    bool need_update = landmarks != m_landmarks || graph.revision != m_graph_revision;
+    m_landmarks = landmarks;
+    m_graph_revision = graph.revision;
+    // repair_portals may have added portals and rebuilt conns, the virtual edges may be stale
+    const bool graph_changed = dp.revision != m_revision || dp.portals.size() != m_start_portal_idx;
+    m_revision = dp.revision;
+    m_start_portal_idx = dp.portals.size();
+    m_end_portal_idx = m_start_portal_idx + 1;
+    if (from != m_start || (graph_changed && from != IVec2{-1, -1})) {
         m_start = from;
-        dp.portals[m_start_portal_idx].startX = from.x;
-        dp.portals[m_start_portal_idx].startY = from.y;
-        dp.portals[m_start_portal_idx].endX = from.x;
-        dp.portals[m_start_portal_idx].endY = from.y;
-        connect_portal(m_start_portal_idx, from, dp, dd);
+        m_start_portal.conns.clear();
+        if (m_start != IVec2{-1, -1}) {
+            m_start_dists = connect_portal(m_start_portal, m_start, dp, dd);
+            connect_start_end(m_start_dists, m_end, dp.tileSplit);
+        }
         need_update = true;
     }
-    if (to != m_end) {
-        disconnect_portal(m_end_portal_idx, dp, m_end, dd.width);
-
+    if (to != m_end || (graph_changed && to != IVec2{-1, -1})) {
         m_end = to;
-        dp.portals[m_end_portal_idx].startX = to.x;
-        dp.portals[m_end_portal_idx].startY = to.y;
-        dp.portals[m_end_portal_idx].endX = to.x;
-        dp.portals[m_end_portal_idx].endY = to.y;
-        connect_portal(m_end_portal_idx, to, dp, dd);
+        m_end_portal.conns.clear();
+        m_end_dists.clear();
+        if (m_end != IVec2{-1, -1})
+            m_end_dists = connect_portal(m_end_portal, m_end, dp, dd);
+        // drops the old start-end edge even if the end was unset
+        connect_start_end(m_end_dists, m_start, dp.tileSplit);
         need_update = true;
     }
     if (need_update && m_start != IVec2{-1, -1} && m_end != IVec2{-1, -1}) {
-        m_cached_path = find_path_a_star(dp, m_start_portal_idx, m_end_portal_idx);
-
-        m_cached_tiles_dists.clear();
-        std::unordered_map<int, std::vector<InitialToExpand>> expansion_map;
+        // indices of a graph frozen before the last repair don't match dp
+        if (graph.revision == dp.revision && graph.portal_count() == dp.portals.size())
+            find_path_a_star(graph, m_start_portal_idx, m_end_portal_idx, m_cached_path);
+        else
+            m_cached_path.clear();
+
+        // clusters of the path get no fields of their own: the distance fields of its portals
+        // were built with the graph, a query only notes which of them to combine and at what cost
+        m_tile_seeds.clear();
         /** 
           rough_path_cost нужен для того чтобы при выборе поклеточного пути учитывалось насколько близко портал к точке назначения
           как будто это эвристика, но прикинутая через грубый путь по графам
@@ -291,41 +324,31 @@ void HierarchicalPathFinder::find_path(DungeonPortals &dp, DungeonData &dd, IVec
           p.s. я мог вообще невнятный комментарий щас написать, уже 6 часов утра, я не соображаю
         */
         int rough_path_cost = 0;
-        // int distination_tile_idx = -1; //coord_to_idx(int(m_end.x / dp.tileSplit), int(m_end.y / dp.tileSplit), (dd.width / dp.tileSplit));
-        // int next_destination_tile_idx;
-        for (int i = m_cached_path.size() - 1; i >= 0; --i) {
-            int portal_idx = m_cached_path[i];
-            std::vector<IVec2> portal_ceils = get_portal_ceils(dp, portal_idx, dd.width);
-            
-            for (IVec2 ceil : portal_ceils) {
-                IVec2 tile_pos = IVec2{(int)(ceil.x / dp.tileSplit), (int)(ceil.y / dp.tileSplit)};
-                int tile_idx = tile_pos.x + tile_pos.y * (dd.width / dp.tileSplit);
-                if (expansion_map.find(tile_idx) == expansion_map.end()) {
-                    expansion_map[tile_idx] = {};
+        const int width = int(dd.width / dp.tileSplit);
+        for (int i = int(m_cached_path.size()) - 1; i >= 0; --i) {
+            const int portal_idx = m_cached_path[size_t(i)];
+            const PathPortal& portal = get_portal(dp, size_t(portal_idx));
+            const int tiles[2] = {int(portal.startX / dp.tileSplit) + int(portal.startY / dp.tileSplit) * width,
+                                  int(portal.endX / dp.tileSplit) + int(portal.endY / dp.tileSplit) * width};
+            for (int k = 0; k < 2; ++k) {
+                const int tile_idx = tiles[k];
+                if (k == 1 && tile_idx == tiles[0])
+                    break;
+                int field = portal_idx == int(m_start_portal_idx) ? startField : endField;
+                if (portal_idx != int(m_start_portal_idx) && portal_idx != int(m_end_portal_idx)) {
+                    const std::vector<size_t>& tile_portals = dp.tilePortalsIndices[size_t(tile_idx)];
+                    field = int(std::find(tile_portals.begin(), tile_portals.end(), size_t(portal_idx)) - tile_portals.begin());
+                    if (field == int(tile_portals.size()))
+                        continue;
                 }
-                // if (distination_tile_idx != tile_idx || portal_idx == m_start_portal_idx) {
-                expansion_map[tile_idx].push_back({ceil, rough_path_cost});
-                    // next_destination_tile_idx = tile_idx;
-                // } 
+                m_tile_seeds.push_back({tile_idx, field, rough_path_cost, i});
             }
-            // distination_tile_idx = next_destination_tile_idx;
             if (i > 0) {
-                float transit_next_cost;
-                for (const auto& connection : dp.portals[portal_idx].conns) {
-                    if (connection.connIdx == m_cached_path[i - 1]) {
-                        transit_next_cost = connection.score;
-                        break;
-                    }
-                }
-                rough_path_cost += transit_next_cost;
+                rough_path_cost += int(edge_score(size_t(portal_idx), size_t(m_cached_path[size_t(i - 1)]), dp));
             }
         }
-        for (auto& pair : expansion_map) {
-            int tile_idx = pair.first;
-            int width = (dd.width / dp.tileSplit);
-            IVec2 tile_pos = IVec2{tile_idx % width, tile_idx / width};
-            m_cached_tiles_dists[tile_idx] = calc_distances_inside_tile(pair.second, dd, tile_pos, dp.tileSplit);
-        }
+        std::stable_sort(m_tile_seeds.begin(), m_tile_seeds.end(),
+                         [](const TileSeed& a, const TileSeed& b) { return a.tile_idx < b.tile_idx; });
     }
 }
 
@@ -333,23 +356,30 @@ const std::vector<int>& HierarchicalPathFinder::get_path() const {
     return m_cached_path;
 }
 
-std::vector<IVec2> HierarchicalPathFinder::get_detailed_path(IVec2 from, DungeonPortals& dp, DungeonData& dd) {
+std::vector<IVec2> HierarchicalPathFinder::get_detailed_path(IVec2 from, const DungeonPortals& dp, const DungeonData& dd) const {
     IVec2 tile_pos = IVec2{(int)(from.x / dp.tileSplit), (int)(from.y / dp.tileSplit)};
     int tile_idx = tile_pos.x + tile_pos.y * (dd.width / dp.tileSplit);
     int tile_size = dp.tileSplit;
 
-    if (m_cached_tiles_dists.find(tile_idx) == m_cached_tiles_dists.end()) {
+    const auto seeds = std::equal_range(m_tile_seeds.begin(), m_tile_seeds.end(), TileSeed{tile_idx, 0, 0, 0},
+                                        [](const TileSeed& a, const TileSeed& b) { return a.tile_idx < b.tile_idx; });
+    if (seeds.first == seeds.second) {
         return {};
     }
-
-    const std::vector<int>& dists_inside_tile = m_cached_tiles_dists[tile_idx];
+    // the closest portal of the path, weighted by how far it still is from the end
+    auto dist_inside_tile = [&](size_t idx) {
+        int dist = std::numeric_limits<int>::max();
+        for (auto seed = seeds.first; seed != seeds.second; ++seed)
+            dist = std::min(dist, seed_dist(*seed, dp, idx));
+        return dist;
+    };
 
     IVec2 tile_offset = IVec2{tile_pos.x * tile_size, tile_pos.y * tile_size};
     IVec2 negate_tile_offset = IVec2{-tile_pos.x * tile_size, -tile_pos.y * tile_size};
 
     IVec2 current_pos_inside_tile = from - tile_offset;
-    int current_dist = dists_inside_tile[coord_to_idx(current_pos_inside_tile.x, current_pos_inside_tile.y, tile_size)];
-    static std::vector<IVec2> dirs = {IVec2{1,0}, {-1, 0}, {0, 1}, {0, -1}};
+    int current_dist = dist_inside_tile(coord_to_idx(current_pos_inside_tile.x, current_pos_inside_tile.y, static_cast<size_t>(tile_size)));
+    static const std::vector<IVec2> dirs = {IVec2{1,0}, {-1, 0}, {0, 1}, {0, -1}};
 
     if (current_dist == std::numeric_limits<int>::max()) {
         return {};
@@ -364,7 +394,7 @@ std::vector<IVec2> HierarchicalPathFinder::get_detailed_path(IVec2 from, Dungeon
             if (p.x < 0 || p.y < 0 || p.x >= tile_size || p.y >= tile_size)
                 continue;
             size_t idx = coord_to_idx(p.x, p.y, tile_size);
-            if (dists_inside_tile[idx] != current_dist - 1)
+            if (dist_inside_tile(idx) != current_dist - 1)
                 continue;
             
             current_pos_inside_tile = p; 
@@ -375,4 +405,142 @@ std::vector<IVec2> HierarchicalPathFinder::get_detailed_path(IVec2 from, Dungeon
         }
     }
     return detailed_path;
-}
\ No newline at end of file
+}
+
+HierarchicalPathCursor::HierarchicalPathCursor(const HierarchicalPathFinder& finder, const DungeonPortals& dp, const DungeonData& dd, IVec2 from)
+    : m_finder(&finder), m_dp(&dp), m_clusters_width(int(dd.width / dp.tileSplit)), m_pos(from) {
+    // cells past the last full cluster belong to none
+    if (finder.m_cached_path.empty() || from.x < 0 || from.y < 0 ||
+        from.x >= m_clusters_width * int(dp.tileSplit) || from.y >= int(dd.height / dp.tileSplit * dp.tileSplit))
+        return;
+    m_tile_idx = tile_of(from);
+    const IVec2 tile_offset{from.x / int(dp.tileSplit) * int(dp.tileSplit), from.y / int(dp.tileSplit) * int(dp.tileSplit)};
+    const IVec2 pos_inside_tile = from - tile_offset;
+    const size_t idx_inside_tile = coord_to_idx(pos_inside_tile.x, pos_inside_tile.y, dp.tileSplit);
+    // the portal get_detailed_path descends to: the lowest cost plus distance
+    int best = std::numeric_limits<int>::max();
+    for (const HierarchicalPathFinder::TileSeed& seed : finder.m_tile_seeds) {
+        if (seed.tile_idx != m_tile_idx)
+            continue;
+        const int seed_dist = finder.seed_dist(seed, dp, idx_inside_tile);
+        if (seed_dist < best) {
+            best = seed_dist;
+            m_path_idx = size_t(seed.path_idx);
+            m_field = seed.field;
+        }
+    }
+    if (best == std::numeric_limits<int>::max())
+        return;
+    m_emit_pos = true;
+    m_done = false;
+}
+
+int HierarchicalPathCursor::tile_of(IVec2 pos) const {
+    return pos.x / int(m_dp->tileSplit) + pos.y / int(m_dp->tileSplit) * m_clusters_width;
+}
+
+bool HierarchicalPathCursor::is_on(size_t portal_idx, IVec2 pos) const {
+    const PathPortal& portal = m_finder->get_portal(*m_dp, portal_idx);
+    return pos.x >= int(portal.startX) && pos.x <= int(portal.endX) && pos.y >= int(portal.startY) && pos.y <= int(portal.endY);
+}
+
+// cells to the target inside m_tile_idx, 0 on the target, pos has to be in that cluster
+int HierarchicalPathCursor::dist(IVec2 pos) const {
+    const int tile_size = int(m_dp->tileSplit);
+    const IVec2 pos_inside_tile = IVec2{pos.x - (m_tile_idx % m_clusters_width) * tile_size, pos.y - (m_tile_idx / m_clusters_width) * tile_size};
+    const size_t idx_inside_tile = coord_to_idx(pos_inside_tile.x, pos_inside_tile.y, size_t(tile_size));
+    if (m_field == HierarchicalPathFinder::startField || m_field == HierarchicalPathFinder::endField) {
+        const std::vector<int>& dists = m_field == HierarchicalPathFinder::startField ? m_finder->m_start_dists : m_finder->m_end_dists;
+        const int dist = dists[idx_inside_tile];
+        return dist == std::numeric_limits<int>::max() ? dist : dist - 1;
+    }
+    const uint32_t dist = cluster_dist(*m_dp, size_t(m_tile_idx), size_t(m_field), idx_inside_tile);
+    return dist == noClusterDist ? std::numeric_limits<int>::max() : int(dist);
+}
+
+// Targets the path_idx-th portal of the path from the cluster of the cursor, or from the other
+// side of the portal the cursor stands on when the target can't be reached from here.
+bool HierarchicalPathCursor::aim(size_t path_idx) {
+    const std::vector<int>& path = m_finder->m_cached_path;
+    const size_t portal_idx = size_t(path[path_idx]);
+    m_path_idx = path_idx;
+    auto field_in = [&](int tile_idx, int& field) {
+        if (portal_idx == m_finder->m_start_portal_idx) {
+            field = HierarchicalPathFinder::startField;
+            return tile_idx == tile_of(m_finder->m_start);
+        }
+        if (portal_idx == m_finder->m_end_portal_idx) {
+            field = HierarchicalPathFinder::endField;
+            return tile_idx == tile_of(m_finder->m_end);
+        }
+        const std::vector<size_t>& tile_portals = m_dp->tilePortalsIndices[size_t(tile_idx)];
+        field = int(std::find(tile_portals.begin(), tile_portals.end(), portal_idx) - tile_portals.begin());
+        return field != int(tile_portals.size());
+    };
+    const int cur_tile_idx = tile_of(m_pos);
+    m_tile_idx = cur_tile_idx;
+    if (field_in(cur_tile_idx, m_field) && dist(m_pos) != std::numeric_limits<int>::max())
+        return true;
+    if (path_idx == 0)
+        return false;
+    static const IVec2 dirs[] = {IVec2{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    for (const IVec2& dir : dirs) {
+        const IVec2 across = m_pos + dir;
+        if (!is_on(size_t(path[path_idx - 1]), across) || tile_of(across) == cur_tile_idx)
+            continue;
+        m_tile_idx = tile_of(across);
+        if (!field_in(m_tile_idx, m_field) || dist(across) == std::numeric_limits<int>::max())
+            continue;
+        m_pos = across;
+        m_emit_pos = true;
+        return true;
+    }
+    return false;
+}
+
+// moves one cell on, false once the end is reached
+bool HierarchicalPathCursor::step() {
+    const int tile_size = int(m_dp->tileSplit);
+    while (!m_done) {
+        const int cur_dist = dist(m_pos);
+        if (cur_dist == 0) {
+            // on the target, the next one may start on the other side of it
+            if (m_path_idx + 1 >= m_finder->m_cached_path.size() || !aim(m_path_idx + 1)) {
+                m_done = true;
+                break;
+            }
+            if (m_emit_pos)
+                return true;
+            continue;
+        }
+        const IVec2 tile_min{(m_tile_idx % m_clusters_width) * tile_size, (m_tile_idx / m_clusters_width) * tile_size};
+        static const IVec2 dirs[] = {IVec2{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+        for (const IVec2& dir : dirs) {
+            const IVec2 p = m_pos + dir;
+            if (p.x < tile_min.x || p.y < tile_min.y || p.x >= tile_min.x + tile_size || p.y >= tile_min.y + tile_size)
+                continue;
+            if (dist(p) != cur_dist - 1)
+                continue;
+            m_pos = p;
+            m_emit_pos = true;
+            return true;
+        }
+        // fields are BFS distances, a finite one always has a lower neighbour
+        m_done = true;
+    }
+    return false;
+}
+
+size_t HierarchicalPathCursor::next(IVec2* cells, size_t count) {
+    size_t written = 0;
+    while (written < count) {
+        if (m_emit_pos) {
+            cells[written++] = m_pos;
+            m_emit_pos = false;
+            continue;
+        }
+        if (!step())
+            break;
+    }
+    return written;
+}
@@ -2,35 +2,109 @@
 #include <flecs.h>
 #include "math.h"
 #include <vector>
-#include <unordered_map>
 #include "dungeonUtils.h"
 #include "pathfinder.h"
+#include "portalGraph.h"
+#include "searchContext.h"
 
+// One path query over a shared portal graph. Start and end are virtual portals that only exist
+// in the query: they take the indices right past dp.portals and keep their edges here (start
+// also holds the start-end edge when both are in one cluster), so the
+// graph is never written and any number of queries can run on it at once, from any thread.
+// The abstract search walks the frozen CSR copy of the graph, DungeonPortals is only read
+// to connect start and end and for the distance fields of the detailed path.
 class HierarchicalPathFinder {
     // portals for path start and end point
-    bool m_initialized = false;
-    size_t m_start_portal_idx;
-    size_t m_end_portal_idx;
+    PathPortal m_start_portal;
+    PathPortal m_end_portal;
+    size_t m_start_portal_idx = 0;
+    size_t m_end_portal_idx = 0;
     IVec2 m_start = {-1, -1};
     IVec2 m_end = {-1, -1};
     std::vector<int> m_cached_path;
-    std::unordered_map<int, std::vector<int>> m_cached_tiles_dists;
+    // a portal of m_cached_path seen from one cluster it touches, sorted by cluster. Cells of the
+    // cluster are cost + distance from the portal away from the end, the distance is read from
+    // DungeonPortals::clusterDists or from the virtual portal's own field below
+    struct TileSeed {
+        int tile_idx;
+        int field; // position in dp.tilePortalsIndices[tile_idx], startField or endField
+        int cost;
+        int path_idx; // position of the portal in m_cached_path
+    };
+    static constexpr int startField = -1;
+    static constexpr int endField = -2;
+    std::vector<TileSeed> m_tile_seeds;
+    std::vector<int> m_start_dists; // inside the cluster of the start, 1 on the start itself
+    std::vector<int> m_end_dists;
+    const PortalLandmarks *m_landmarks = nullptr;
+    std::vector<uint32_t> m_end_landmark_dists; // landmark row of the virtual end
+    size_t m_last_expanded = 0;
+    double m_last_search_us = 0.0;
+    SearchContext m_ctx; // abstract search scratch, indexed by portal
+    uint32_t m_revision = 0; // of the portal graph start and end were connected to
+    uint32_t m_graph_revision = 0; // of the frozen graph of the last search
 
     struct InitialToExpand {
         IVec2 pos;
         int costAddition;
     };
-    std::vector<int> calc_distances_inside_tile(std::vector<InitialToExpand> froms, DungeonData& dungeon_data, IVec2 tile_pos, int tile_size);
-    void connect_portal(size_t portal_idx, IVec2 portal_pos, DungeonPortals& portals, DungeonData& dungeon_data);
-    void disconnect_portal(size_t portal_idx, DungeonPortals& portals, IVec2 portal_pos, size_t dd_width);
-    std::vector<int> find_path_a_star(DungeonPortals& portals, size_t from_portal_idx, size_t to_portal_idx);
-    std::vector<int> reconstruct_path(const std::vector<int>& prev, size_t to_portal_idx); 
-    float heuristic(size_t first_portal_idx, size_t second_portal_idx, DungeonPortals& portals);
-    std::vector<IVec2> get_portal_ceils(DungeonPortals& dp, int portal_idx, int dd_width);
+    static std::vector<int> calc_distances_inside_tile(const std::vector<InitialToExpand>& froms, const DungeonData& dungeon_data, IVec2 tile_pos, int tile_size);
+    std::vector<int> connect_portal(PathPortal& portal, IVec2 portal_pos, const DungeonPortals& portals, const DungeonData& dungeon_data);
+    void connect_start_end(const std::vector<int>& dists, IVec2 other, size_t tile_size);
+    bool find_path_a_star(const FrozenPortalGraph& graph, size_t from_portal_idx, size_t to_portal_idx, std::vector<int>& path);
+    void reconstruct_path(size_t to_portal_idx, std::vector<int>& path) const;
+    float heuristic(size_t portal_idx) const;
+    float edge_score(size_t first_portal_idx, size_t second_portal_idx, const DungeonPortals& portals) const;
+    int seed_dist(const TileSeed& seed, const DungeonPortals& dp, size_t idx_inside_tile) const;
+
+    friend class HierarchicalPathCursor;
 public:
-    void find_path(DungeonPortals &portals, DungeonData &dd, IVec2 from, IVec2 to);
-    std::vector<IVec2> get_detailed_path(IVec2 from, DungeonPortals& dp, DungeonData& dd);
+    // graph must be frozen from portals after their last repair, a stale one finds no path.
+    // landmarks bound the abstract search, without them (or built for another graph) it is Dijkstra
+    void find_path(const DungeonPortals &portals, const FrozenPortalGraph &graph, const DungeonData &dd, IVec2 from, IVec2 to,
+                   const PortalLandmarks *landmarks = nullptr);
+    // cells from `from` to the portal of the path it is heading for, inside the cluster of `from` only.
+    // HierarchicalPathCursor follows the whole path without allocating
+    std::vector<IVec2> get_detailed_path(IVec2 from, const DungeonPortals& dp, const DungeonData& dd) const;
+    // portal indices from start to end, the first and the last one are virtual, see get_portal
     const std::vector<int>& get_path() const;
+    // portal of the graph or the virtual start/end of this query
+    const PathPortal& get_portal(const DungeonPortals& dp, size_t portal_idx) const;
+    // portals expanded by the last abstract search
+    size_t last_expanded() const { return m_last_expanded; }
+    // wall time of the last abstract search, without connecting start and end
+    double last_search_us() const { return m_last_search_us; }
     IVec2 getStart() { return m_start;}
     IVec2 getEnd() { return m_end;}
-};
\ No newline at end of file
+};
+
+// Cell by cell walk along the last path of a HierarchicalPathFinder, across clusters. From a cell
+// of any cluster the path touches it heads for the same portal get_detailed_path does, then
+// follows the portal path to the end, reading only the precomputed distance fields.
+// The state is a few indices, next() writes into the caller's buffer and never allocates.
+// Invalid once the finder runs another query or dp is repaired.
+class HierarchicalPathCursor {
+    const HierarchicalPathFinder* m_finder = nullptr;
+    const DungeonPortals* m_dp = nullptr;
+    int m_clusters_width = 0;
+    IVec2 m_pos = {-1, -1};
+    size_t m_path_idx = 0; // target portal in the finder's path
+    int m_tile_idx = -1;   // cluster the cursor descends in
+    int m_field = 0;       // of the target in that cluster, see HierarchicalPathFinder::TileSeed
+    bool m_emit_pos = false; // m_pos isn't handed out yet
+    bool m_done = true;
+
+    int dist(IVec2 pos) const;
+    int tile_of(IVec2 pos) const;
+    bool is_on(size_t portal_idx, IVec2 pos) const;
+    bool aim(size_t path_idx);
+    bool step();
+public:
+    HierarchicalPathCursor() = default;
+    HierarchicalPathCursor(const HierarchicalPathFinder& finder, const DungeonPortals& dp, const DungeonData& dd, IVec2 from);
+
+    // writes up to count next cells, `from` first, returns how many. 0 once the end was handed out
+    size_t next(IVec2* cells, size_t count);
+    bool done() const { return m_done && !m_emit_pos; }
+    IVec2 position() const { return m_pos; }
+};
@@ -0,0 +1,119 @@
+#include "landmarks.h"
+#include "ecsTypes.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <limits>
+
+static constexpr uint32_t infDist = std::numeric_limits<uint32_t>::max();
+
+static void bfs(const DungeonData &dd, size_t source, std::vector<uint32_t> &dist, std::vector<uint32_t> &queue)
+{
+  dist.assign(dd.width * dd.height, infDist);
+  queue.clear();
+  dist[source] = 0;
+  queue.push_back(uint32_t(source));
+  for (size_t head = 0; head < queue.size(); ++head)
+  {
+    const uint32_t cur = queue[head];
+    const int x = int(cur % dd.width);
+    const int y = int(cur / dd.width);
+    auto visit = [&](int nx, int ny)
+    {
+      if (nx < 0 || ny < 0 || nx >= int(dd.width) || ny >= int(dd.height))
+        return;
+      const size_t idx = size_t(ny) * dd.width + size_t(nx);
+      if (dd.tiles[idx] == dungeon::wall || dist[idx] != infDist)
+        return;
+      dist[idx] = dist[cur] + 1;
+      queue.push_back(uint32_t(idx));
+    };
+    visit(x + 1, y);
+    visit(x - 1, y);
+    visit(x, y + 1);
+    visit(x, y - 1);
+  }
+}
+
+uint64_t hash_tiles(const DungeonData &dd)
+{
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ull ^ dd.width;
+  for (char tile : dd.tiles)
+    hash = (hash ^ uint8_t(tile)) * 1099511628211ull;
+  return hash;
+}
+
+DungeonLandmarks build_landmarks(const DungeonData &dd, size_t count)
+{
+  DungeonLandmarks res;
+  res.tilesHash = hash_tiles(dd);
+  const size_t size = dd.width * dd.height;
+  size_t seed = 0;
+  while (seed < size && dd.tiles[seed] == dungeon::wall)
+    ++seed;
+  if (seed == size || count == 0)
+    return res;
+
+  std::vector<uint32_t> dist;
+  std::vector<uint32_t> queue;
+  bfs(dd, seed, dist, queue);
+  std::vector<uint32_t> closest = dist; // distance to the nearest landmark so far
+
+  std::vector<std::vector<uint32_t>> tables;
+  for (size_t l = 0; l < count; ++l)
+  {
+    // farthest-point selection
+    size_t farthest = size;
+    for (size_t i = 0; i < size; ++i)
+      if (closest[i] != infDist && (farthest == size || closest[i] > closest[farthest]))
+        farthest = i;
+    if (farthest == size || closest[farthest] == 0)
+      break;
+    res.positions.push_back(IVec2{int(farthest % dd.width), int(farthest / dd.width)});
+    bfs(dd, farthest, dist, queue);
+    for (size_t i = 0; i < size; ++i)
+      closest[i] = l == 0 ? dist[i] : std::min(closest[i], dist[i]);
+    tables.push_back(dist);
+  }
+
+  res.width = dd.width;
+  res.count = tables.size();
+  res.dists.resize(size * res.count);
+  for (size_t i = 0; i < size; ++i)
+    for (size_t l = 0; l < res.count; ++l)
+    {
+      // saturating keeps the heuristic consistent, unlike dropping the long distances as unknown
+      const uint32_t d = tables[l][i];
+      res.dists[i * res.count + l] = d == infDist ? DungeonLandmarks::unknown : uint16_t(std::min(d, uint32_t(DungeonLandmarks::maxDist)));
+    }
+  return res;
+}
+
+bool DungeonLandmarks::is_stale(const DungeonData &dd) const
+{
+  return dd.width != width || tilesHash != hash_tiles(dd);
+}
+
+float DungeonLandmarks::heuristic(IVec2 from, IVec2 to) const
+{
+  const float euclid = dist(from, to);
+  if (count == 0)
+    return euclid;
+  const uint16_t *a = &dists[(size_t(from.y) * width + size_t(from.x)) * count];
+  const uint16_t *b = &dists[(size_t(to.y) * width + size_t(to.x)) * count];
+  int best = 0;
+  for (size_t l = 0; l < count; ++l)
+    if (a[l] != unknown && b[l] != unknown)
+      best = std::max(best, std::abs(int(a[l]) - int(b[l])));
+  return std::max(euclid, float(best));
+}
+
+void on_dungeon_tiles_changed(flecs::world &ecs)
+{
+  auto dungeonQuery = ecs.query<const DungeonData, DungeonLandmarks>();
+  dungeonQuery.each([&](const DungeonData &dd, DungeonLandmarks &landmarks)
+  {
+    if (landmarks.is_stale(dd))
+      landmarks = build_landmarks(dd, landmarks.count ? landmarks.count : defaultLandmarkCount);
+  });
+}
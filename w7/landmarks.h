@@ -0,0 +1,35 @@
+#pragma once
+#include <flecs.h>
+#include "math.h"
+#include "pathfinder.h"
+#include <vector>
+#include <cstdint>
+
+// ALT heuristic tables for a dungeon, only built where a search uses them. On an entity
+// they sit next to DungeonPortals, on_dungeon_tiles_changed keeps them in sync with the tiles.
+// Moves cost 1 and walls can't be entered, so distances are symmetric and one uint16 table
+// of BFS distances per landmark is enough. Unreachable cells are stored as unknown,
+// longer distances saturate at maxDist.
+struct DungeonLandmarks
+{
+  static constexpr uint16_t unknown = 0xffff;
+  static constexpr uint16_t maxDist = unknown - 1;
+
+  size_t width = 0;
+  size_t count = 0;
+  std::vector<uint16_t> dists; // [cell * count + landmark]
+  std::vector<IVec2> positions;
+  uint64_t tilesHash = 0;      // of the tiles the tables were built for
+
+  // lower bound on the path length between two cells, never below euclidean
+  float heuristic(IVec2 from, IVec2 to) const;
+  bool is_stale(const DungeonData &dd) const;
+};
+
+constexpr size_t defaultLandmarkCount = 8;
+
+uint64_t hash_tiles(const DungeonData &dd);
+DungeonLandmarks build_landmarks(const DungeonData &dd, size_t count);
+// Invalidation hook, call after editing DungeonData.tiles: rebuilds the landmark tables
+// of every dungeon whose tiles no longer match them.
+void on_dungeon_tiles_changed(flecs::world &ecs);
@@ -1,6 +1,7 @@
 #include "raylib.h"
 #include <flecs.h>
 #include <algorithm>
+#include <cstring>
 
 #include "ecsTypes.h"
 #include "shootEmUp.h"
@@ -23,8 +24,14 @@ static void update_camera(flecs::world &ecs)
 }
 
 
-int main(int /*argc*/, const char ** /*argv*/)
+int main(int argc, const char **argv)
 {
+  // --portal-cache FILE keeps the prebuilt portal graph between launches
+  const char *portalCache = nullptr;
+  for (int i = 1; i + 1 < argc; ++i)
+    if (strcmp(argv[i], "--portal-cache") == 0)
+      portalCache = argv[++i];
+
   int width = 1920;
   int height = 1080;
   InitWindow(width, height, "w6 AI MIPT");
@@ -44,7 +51,7 @@ int main(int /*argc*/, const char ** /*argv*/)
     constexpr size_t dungHeight = 100;
     char *tiles = new char[dungWidth * dungHeight];
     gen_drunk_dungeon(tiles, dungWidth, dungHeight);
-    init_dungeon(ecs, tiles, dungWidth, dungHeight);
+    init_dungeon(ecs, tiles, dungWidth, dungHeight, portalCache);
   }
   init_shoot_em_up(ecs);
 
@@ -10,6 +10,11 @@ struct IVec2
 inline bool operator==(const IVec2 &lhs, const IVec2 &rhs) { return lhs.x == rhs.x && lhs.y == rhs.y; }
 inline bool operator!=(const IVec2 &lhs, const IVec2 &rhs) { return !(lhs == rhs); }
 
+inline IVec2 operator+(const IVec2 &lhs, const IVec2 &rhs)
+{
+  return IVec2{lhs.x + rhs.x, lhs.y + rhs.y};
+}
+
 inline IVec2 operator-(const IVec2 &lhs, const IVec2 &rhs)
 {
   return IVec2{lhs.x - rhs.x, lhs.y - rhs.y};
@@ -1,7 +1,11 @@
 #include "pathfinder.h"
 #include "dungeonUtils.h"
 #include "math.h"
+#include "portalCache.h"
 #include <algorithm>
+#include <atomic>
+#include <map>
+#include <thread>
 
 float heuristic(IVec2 lhs, IVec2 rhs)
 {
@@ -14,91 +18,426 @@ static size_t coord_to_idx(T x, T y, size_t w)
   return size_t(y) * w + size_t(x);
 }
 
-static std::vector<IVec2> reconstruct_path(std::vector<IVec2> prev, IVec2 to, size_t width)
+// BFS from every cell of a portal at once, limited to one cluster.
+// dist is cluster-local (y * splitTiles + x), unreached cells stay at infDist.
+static constexpr uint32_t infDist = 0xffffffff;
+
+static void cluster_bfs(const DungeonData &dd, const PathPortal &portal, IVec2 lim_min, size_t split,
+                        std::vector<uint32_t> &dist, std::vector<uint32_t> &queue)
 {
-  IVec2 curPos = to;
-  std::vector<IVec2> res = {curPos};
-  while (prev[coord_to_idx(curPos.x, curPos.y, width)] != IVec2{-1, -1})
+  dist.assign(split * split, infDist);
+  queue.clear();
+  // portals straddle the border, only the cells inside the cluster are sources
+  for (size_t y = std::max(portal.startY, size_t(lim_min.y)); y <= std::min(portal.endY, size_t(lim_min.y) + split - 1); ++y)
+    for (size_t x = std::max(portal.startX, size_t(lim_min.x)); x <= std::min(portal.endX, size_t(lim_min.x) + split - 1); ++x)
+    {
+      const uint32_t local = uint32_t((y - size_t(lim_min.y)) * split + (x - size_t(lim_min.x)));
+      dist[local] = 0;
+      queue.push_back(local);
+    }
+  for (size_t head = 0; head < queue.size(); ++head)
   {
-    curPos = prev[coord_to_idx(curPos.x, curPos.y, width)];
-    res.insert(res.begin(), curPos);
+    const uint32_t cur = queue[head];
+    const int x = int(cur % split);
+    const int y = int(cur / split);
+    auto visit = [&](int nx, int ny)
+    {
+      // out of cluster
+      if (nx < 0 || ny < 0 || nx >= int(split) || ny >= int(split))
+        return;
+      const size_t local = size_t(ny) * split + size_t(nx);
+      if (dist[local] != infDist || dd.tiles[coord_to_idx(lim_min.x + nx, lim_min.y + ny, dd.width)] == dungeon::wall)
+        return;
+      dist[local] = dist[cur] + 1;
+      queue.push_back(uint32_t(local));
+    };
+    visit(x + 1, y);
+    visit(x - 1, y);
+    visit(x, y + 1);
+    visit(x, y - 1);
   }
-  return res;
 }
 
-static std::vector<IVec2> find_path_a_star(const DungeonData &dd, IVec2 from, IVec2 to,
-                                           IVec2 lim_min, IVec2 lim_max)
+// below this many clusters per thread the pool costs more than it saves
+static constexpr size_t minClustersPerThread = 256;
+
+// bytes per cell of DungeonPortals::clusterDists, the largest value is kept for unreachable cells
+static uint8_t dist_bytes(size_t splitTiles)
 {
-  if (from.x < 0 || from.y < 0 || from.x >= int(dd.width) || from.y >= int(dd.height))
-    return std::vector<IVec2>();
-  size_t inpSize = dd.width * dd.height;
+  return splitTiles * splitTiles < 0xff ? 1 : 2;
+}
 
-  std::vector<float> g(inpSize, std::numeric_limits<float>::max());
-  std::vector<float> f(inpSize, std::numeric_limits<float>::max());
-  std::vector<IVec2> prev(inpSize, {-1,-1});
+// intra-cluster edges between every pair of portals of cluster tidx, in (i, j) order,
+// and the distance field of every portal
+static void connect_cluster(const DungeonData &dd, const std::vector<PathPortal> &portals, const std::vector<size_t> &indices,
+                            size_t tidx, size_t width, size_t splitTiles, std::vector<ClusterEdge> &edges,
+                            std::vector<uint8_t> &fields, std::vector<uint32_t> &dist, std::vector<uint32_t> &queue)
+{
+  edges.clear();
+  const size_t cells = splitTiles * splitTiles;
+  const uint8_t bytes = dist_bytes(splitTiles);
+  fields.resize(indices.size() * cells * bytes);
+  fields.shrink_to_fit();
+  size_t x = tidx % width;
+  size_t y = tidx / width;
+  IVec2 limMin{int((x + 0) * splitTiles), int((y + 0) * splitTiles)};
+  IVec2 limMax{int((x + 1) * splitTiles), int((y + 1) * splitTiles)};
+  for (size_t i = 0; i < indices.size(); ++i)
+  {
+    const PathPortal &firstPortal = portals[indices[i]];
+    // one pass gives the distance from the closest cell of this portal to every cell of the cluster
+    cluster_bfs(dd, firstPortal, limMin, splitTiles, dist, queue);
+    uint8_t *field = fields.data() + i * cells * bytes;
+    for (size_t local = 0; local < cells; ++local)
+    {
+      // noClusterDist truncates to 0xff in the one byte layout
+      const uint32_t d = dist[local] == infDist ? noClusterDist : dist[local];
+      field[local * bytes] = uint8_t(d);
+      if (bytes == 2)
+        field[local * bytes + 1] = uint8_t(d >> 8);
+    }
+    for (size_t j = i + 1; j < indices.size(); ++j)
+    {
+      const PathPortal &secondPortal = portals[indices[j]];
+      // cells of a portal are a connected line inside the cluster, so either every cell of
+      // the second portal is reachable or none is. Edge length is in path cells (dist + 1).
+      bool noPath = false;
+      size_t minDist = 0xffffffff;
+      for (size_t toY = std::max(secondPortal.startY, size_t(limMin.y));
+                  toY <= std::min(secondPortal.endY, size_t(limMax.y - 1)) && !noPath; ++toY)
+        for (size_t toX = std::max(secondPortal.startX, size_t(limMin.x));
+                    toX <= std::min(secondPortal.endX, size_t(limMax.x - 1)); ++toX)
+        {
+          const uint32_t d = dist[(toY - size_t(limMin.y)) * splitTiles + (toX - size_t(limMin.x))];
+          if (d == infDist)
+          {
+            noPath = true;
+            break;
+          }
+          minDist = std::min(minDist, size_t(d) + 1);
+        }
+      // write pathable data and length
+      if (noPath)
+        continue;
+      edges.push_back({indices[i], indices[j], float(minDist)});
+    }
+  }
+}
 
-  auto getG = [&](IVec2 p) -> float { return g[coord_to_idx(p.x, p.y, dd.width)]; };
-  auto getF = [&](IVec2 p) -> float { return f[coord_to_idx(p.x, p.y, dd.width)]; };
+// coordinate next to c, offs is -1 or 0
+static size_t offset_coord(size_t c, int offs)
+{
+  return offs < 0 ? c - size_t(-offs) : c + size_t(offs);
+}
 
-  g[coord_to_idx(from.x, from.y, dd.width)] = 0;
-  f[coord_to_idx(from.x, from.y, dd.width)] = heuristic(from, to);
+// Open spans along the top (dir 1, 0 / offs 0, -1) or left (dir 0, 1 / offs -1, 0) border of
+// cluster (xx, yy). Portals start in the neighbour cluster and end in this one.
+static void check_border(const DungeonData &dd, size_t splitTiles,
+                         size_t xx, size_t yy,
+                         size_t dir_x, size_t dir_y,
+                         int offs_x, int offs_y,
+                         std::vector<PathPortal> &portals)
+{
+  bool inSpan = false;
+  size_t spanFrom = 0;
+  size_t spanTo = 0;
+  auto writeSpan = [&]()
+  {
+    portals.push_back({offset_coord(xx * splitTiles + spanFrom * dir_x, offs_x),
+                       offset_coord(yy * splitTiles + spanFrom * dir_y, offs_y),
+                       xx * splitTiles + spanTo * dir_x,
+                       yy * splitTiles + spanTo * dir_y,
+                       {}});
+  };
+  for (size_t i = 0; i < splitTiles; ++i)
+  {
+    size_t x = xx * splitTiles + i * dir_x;
+    size_t y = yy * splitTiles + i * dir_y;
+    size_t nx = offset_coord(x, offs_x);
+    size_t ny = offset_coord(y, offs_y);
+    if (dd.tiles[y * dd.width + x] != dungeon::wall &&
+        dd.tiles[ny * dd.width + nx] != dungeon::wall)
+    {
+      if (!inSpan)
+        spanFrom = i;
+      inSpan = true;
+      spanTo = i;
+    }
+    else if (inSpan)
+    {
+      writeSpan();
+      inSpan = false;
+    }
+  }
+  if (inSpan)
+    writeSpan();
+}
+
+static void merge_conns(const std::vector<ClusterEdge> &edges, std::vector<PathPortal> &portals)
+{
+  for (const ClusterEdge &edge : edges)
+  {
+    portals[edge.first].conns.push_back({edge.second, edge.score});
+    portals[edge.second].conns.push_back({edge.first, edge.score});
+  }
+}
+
+DungeonPortals build_portals(const DungeonData &dd, size_t splitTiles, size_t threads)
+{
+  // go through each super tile
+  const size_t width = dd.width / splitTiles;
+  const size_t height = dd.height / splitTiles;
 
-  std::vector<IVec2> openList = {from};
-  std::vector<IVec2> closedList;
+  std::vector<PathPortal> portals;
+  std::vector<std::vector<size_t>> tilePortalsIndices;
 
-  while (!openList.empty())
+  auto push_portals = [&](size_t x, size_t y,
+                          int offs_x, int offs_y,
+                          const std::vector<PathPortal> &new_portals)
   {
-    size_t bestIdx = 0;
-    float bestScore = getF(openList[0]);
-    for (size_t i = 1; i < openList.size(); ++i)
+    for (const PathPortal &portal : new_portals)
     {
-      float score = getF(openList[i]);
-      if (score < bestScore)
+      size_t idx = portals.size();
+      portals.push_back(portal);
+      tilePortalsIndices[y * width + x].push_back(idx);
+      tilePortalsIndices[offset_coord(y, offs_y) * width + offset_coord(x, offs_x)].push_back(idx);
+    }
+  };
+  // portal detection pass
+  for (size_t y = 0; y < height; ++y)
+    for (size_t x = 0; x < width; ++x)
+    {
+      tilePortalsIndices.push_back(std::vector<size_t>{});
+      // check top
+      if (y > 0)
       {
-        bestIdx = i;
-        bestScore = score;
+        std::vector<PathPortal> topPortals;
+        check_border(dd, splitTiles, x, y, 1, 0, 0, -1, topPortals);
+        push_portals(x, y, 0, -1, topPortals);
+      }
+      // left
+      if (x > 0)
+      {
+        std::vector<PathPortal> leftPortals;
+        check_border(dd, splitTiles, x, y, 0, 1, -1, 0, leftPortals);
+        push_portals(x, y, -1, 0, leftPortals);
       }
     }
-    if (openList[bestIdx] == to)
-      return reconstruct_path(prev, to, dd.width);
-    IVec2 curPos = openList[bestIdx];
-    openList.erase(openList.begin() + bestIdx);
-    if (std::find(closedList.begin(), closedList.end(), curPos) != closedList.end())
-      continue;
-    size_t idx = coord_to_idx(curPos.x, curPos.y, dd.width);
-    closedList.emplace_back(curPos);
-    auto checkNeighbour = [&](IVec2 p)
+  // connection pass: clusters only read the portals, so they run on a pool and write
+  // their edges into their own buffer
+  std::vector<std::vector<ClusterEdge>> clusterEdges(tilePortalsIndices.size());
+  std::vector<std::vector<uint8_t>> clusterDists(tilePortalsIndices.size());
+  auto connectClusters = [&](std::atomic<size_t> &next)
+  {
+    std::vector<uint32_t> dist;
+    std::vector<uint32_t> queue;
+    for (size_t tidx = next++; tidx < tilePortalsIndices.size(); tidx = next++)
+      connect_cluster(dd, portals, tilePortalsIndices[tidx], tidx, width, splitTiles, clusterEdges[tidx], clusterDists[tidx],
+                      dist, queue);
+  };
+  std::atomic<size_t> nextCluster = 0;
+  if (threads == 0)
+    threads = std::thread::hardware_concurrency();
+  // spawning isn't free, small maps are faster on the calling thread
+  threads = std::clamp<size_t>(tilePortalsIndices.size() / minClustersPerThread, 1, std::max<size_t>(threads, 1));
+  // jthread joins on destruction, so a throw while spawning or connecting doesn't leave joinable threads behind
+  std::vector<std::jthread> workers;
+  for (size_t i = 1; i < threads; ++i)
+    workers.emplace_back(connectClusters, std::ref(nextCluster));
+  connectClusters(nextCluster);
+  for (std::jthread &worker : workers)
+    worker.join();
+
+  // merging in cluster order gives every portal its connections in the order of the serial build
+  for (const std::vector<ClusterEdge> &edges : clusterEdges)
+    merge_conns(edges, portals);
+  return DungeonPortals{splitTiles, std::move(portals), std::move(tilePortalsIndices), std::move(clusterEdges),
+                        std::move(clusterDists), dist_bytes(splitTiles), {}, 0};
+}
+
+size_t repair_portals(DungeonPortals &dp, const DungeonData &dd, const std::vector<IVec2> &changedCells)
+{
+  const size_t split = dp.tileSplit;
+  const size_t width = dd.width / split;
+  const size_t height = dd.height / split;
+  auto cluster_of = [&](size_t x, size_t y) { return (y / split) * width + x / split; };
+  // border portals span two clusters
+  auto on_border = [&](const PathPortal &portal) { return cluster_of(portal.startX, portal.startY) != cluster_of(portal.endX, portal.endY); };
+
+  // cells outside of the cluster grid (width not divisible by split) aren't in the graph
+  std::vector<size_t> core;
+  for (IVec2 cell : changedCells)
+    if (cell.x >= 0 && cell.y >= 0 && size_t(cell.x) < width * split && size_t(cell.y) < height * split)
+      core.push_back(cluster_of(size_t(cell.x), size_t(cell.y)));
+  std::sort(core.begin(), core.end());
+  core.erase(std::unique(core.begin(), core.end()), core.end());
+  if (core.empty())
+    return 0;
+
+  std::vector<size_t> dirty;
+  for (size_t tidx : core)
+  {
+    const size_t x = tidx % width;
+    const size_t y = tidx / width;
+    dirty.push_back(tidx);
+    if (x > 0)
+      dirty.push_back(tidx - 1);
+    if (x + 1 < width)
+      dirty.push_back(tidx + 1);
+    if (y > 0)
+      dirty.push_back(tidx - width);
+    if (y + 1 < height)
+      dirty.push_back(tidx + width);
+  }
+  std::sort(dirty.begin(), dirty.end());
+  dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+  // Borders are named by the cluster below / to the right of them, like in build_portals.
+  // borderPortals[{tidx, left}] is the new ordered list of portals of every border touching a core cluster.
+  std::map<std::pair<size_t, bool>, std::vector<size_t>> borderPortals;
+  for (size_t tidx : core)
+  {
+    const size_t x = tidx % width;
+    const size_t y = tidx / width;
+    if (y > 0)
+      borderPortals[{tidx, false}];
+    if (x > 0)
+      borderPortals[{tidx, true}];
+    if (x + 1 < width)
+      borderPortals[{tidx + 1, true}];
+    if (y + 1 < height)
+      borderPortals[{tidx + width, false}];
+  }
+  auto is_on = [&](const PathPortal &portal, size_t tidx, bool left)
+  {
+    // left border portals cross a cluster column, top ones a cluster row
+    return on_border(portal) && cluster_of(portal.endX, portal.endY) == tidx &&
+           (left ? portal.startX / split != portal.endX / split : portal.startY / split != portal.endY / split);
+  };
+
+  std::vector<size_t> released;
+  std::vector<PathPortal> spans;
+  for (auto &[border, indices] : borderPortals)
+  {
+    const auto [tidx, left] = border;
+    std::vector<size_t> old;
+    for (size_t idx : dp.tilePortalsIndices[tidx])
+      if (is_on(dp.portals[idx], tidx, left))
+        old.push_back(idx);
+    spans.clear();
+    check_border(dd, split, tidx % width, tidx / width, left ? 0 : 1, left ? 1 : 0, left ? -1 : 0, left ? 0 : -1, spans);
+    // unchanged spans keep their slot
+    std::vector<bool> reused(old.size(), false);
+    indices.assign(spans.size(), ~size_t(0));
+    for (size_t i = 0; i < spans.size(); ++i)
+      for (size_t k = 0; k < old.size(); ++k)
+      {
+        const PathPortal &prev = dp.portals[old[k]];
+        if (!reused[k] && prev.startX == spans[i].startX && prev.startY == spans[i].startY &&
+            prev.endX == spans[i].endX && prev.endY == spans[i].endY)
+        {
+          reused[k] = true;
+          indices[i] = old[k];
+          break;
+        }
+      }
+    for (size_t k = 0; k < old.size(); ++k)
+      if (!reused[k])
+        released.push_back(old[k]);
+    for (size_t i = 0; i < spans.size(); ++i)
     {
-      // out of bounds
-      if (p.x < lim_min.x || p.y < lim_min.y || p.x >= lim_max.x || p.y >= lim_max.y)
-        return;
-      size_t idx = coord_to_idx(p.x, p.y, dd.width);
-      // not empty
-      if (dd.tiles[idx] == dungeon::wall)
-        return;
-      float edgeWeight = 1.f;
-      float gScore = getG(curPos) + 1.f * edgeWeight; // we're exactly 1 unit away
-      if (gScore < getG(p))
+      if (indices[i] != ~size_t(0))
+        continue;
+      if (!released.empty())
       {
-        prev[idx] = curPos;
-        g[idx] = gScore;
-        f[idx] = gScore + heuristic(p, to);
+        indices[i] = released.back();
+        released.pop_back();
       }
-      bool found = std::find(openList.begin(), openList.end(), p) != openList.end();
-      if (!found)
-        openList.emplace_back(p);
-    };
-    checkNeighbour({curPos.x + 1, curPos.y + 0});
-    checkNeighbour({curPos.x - 1, curPos.y + 0});
-    checkNeighbour({curPos.x + 0, curPos.y + 1});
-    checkNeighbour({curPos.x + 0, curPos.y - 1});
+      else if (!dp.freePortals.empty())
+      {
+        indices[i] = dp.freePortals.back();
+        dp.freePortals.pop_back();
+      }
+      else
+      {
+        indices[i] = dp.portals.size();
+        dp.portals.emplace_back();
+      }
+      PathPortal &portal = dp.portals[indices[i]];
+      portal.startX = spans[i].startX;
+      portal.startY = spans[i].startY;
+      portal.endX = spans[i].endX;
+      portal.endY = spans[i].endY;
+    }
+  }
+  for (size_t idx : released)
+  {
+    dp.portals[idx].conns.clear();
+    dp.freePortals.push_back(idx);
   }
-  // empty path
-  return std::vector<IVec2>();
-}
 
+  // cluster lists in build order: top, left, right, bottom border
+  auto portals_on = [&](size_t tidx, bool left, std::vector<size_t> &list)
+  {
+    auto it = borderPortals.find({tidx, left});
+    if (it != borderPortals.end())
+      list.insert(list.end(), it->second.begin(), it->second.end());
+    else
+      for (size_t idx : dp.tilePortalsIndices[tidx])
+        if (is_on(dp.portals[idx], tidx, left))
+          list.push_back(idx);
+  };
+  std::vector<std::vector<size_t>> lists(dirty.size());
+  for (size_t d = 0; d < dirty.size(); ++d)
+  {
+    const size_t tidx = dirty[d];
+    const size_t x = tidx % width;
+    const size_t y = tidx / width;
+    std::vector<size_t> &list = lists[d];
+    if (y > 0)
+      portals_on(tidx, false, list);
+    if (x > 0)
+      portals_on(tidx, true, list);
+    if (x + 1 < width)
+      portals_on(tidx + 1, true, list);
+    if (y + 1 < height)
+      portals_on(tidx + width, false, list);
+  }
+  std::vector<uint32_t> dist;
+  std::vector<uint32_t> queue;
+  for (size_t d = 0; d < dirty.size(); ++d)
+  {
+    const size_t tidx = dirty[d];
+    connect_cluster(dd, dp.portals, lists[d], tidx, width, split, dp.clusterEdges[tidx], dp.clusterDists[tidx], dist, queue);
+    dp.tilePortalsIndices[tidx] = std::move(lists[d]);
+  }
+
+  // every portal of a dirty cluster gets its connections merged again from both of its clusters
+  std::vector<size_t> touched;
+  for (size_t tidx : dirty)
+    touched.insert(touched.end(), dp.tilePortalsIndices[tidx].begin(), dp.tilePortalsIndices[tidx].end());
+  std::sort(touched.begin(), touched.end());
+  touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+  for (size_t idx : touched)
+  {
+    PathPortal &portal = dp.portals[idx];
+    portal.conns.clear();
+    const size_t clusters[2] = {std::min(cluster_of(portal.startX, portal.startY), cluster_of(portal.endX, portal.endY)),
+                                std::max(cluster_of(portal.startX, portal.startY), cluster_of(portal.endX, portal.endY))};
+    for (size_t tidx : clusters)
+      for (const ClusterEdge &edge : dp.clusterEdges[tidx])
+      {
+        if (edge.first == idx)
+          portal.conns.push_back({edge.second, edge.score});
+        else if (edge.second == idx)
+          portal.conns.push_back({edge.first, edge.score});
+      }
+  }
+  dp.revision += 1;
+  return dirty.size();
+}
 
-void prebuild_map(flecs::world &ecs)
+void prebuild_map(flecs::world &ecs, const char *portalCache)
 {
   auto mapQuery = ecs.query<const DungeonData>();
 
@@ -107,135 +446,15 @@ void prebuild_map(flecs::world &ecs)
   {
     mapQuery.each([&](flecs::entity e, const DungeonData &dd)
     {
-      // go through each super tile
-      const size_t width = dd.width / splitTiles;
-      const size_t height = dd.height / splitTiles;
-
-      auto check_border = [&](size_t xx, size_t yy,
-                              size_t dir_x, size_t dir_y,
-                              int offs_x, int offs_y,
-                              std::vector<PathPortal> &portals)
-      {
-        int spanFrom = -1;
-        int spanTo = -1;
-        for (size_t i = 0; i < splitTiles; ++i)
-        {
-          size_t x = xx * splitTiles + i * dir_x;
-          size_t y = yy * splitTiles + i * dir_y;
-          size_t nx = x + offs_x;
-          size_t ny = y + offs_y;
-          if (dd.tiles[y * dd.width + x] != dungeon::wall &&
-              dd.tiles[ny * dd.width + nx] != dungeon::wall)
-          {
-            if (spanFrom < 0)
-              spanFrom = i;
-            spanTo = i;
-          }
-          else if (spanFrom >= 0)
-          {
-            // write span
-            portals.push_back({xx * splitTiles + spanFrom * dir_x + offs_x,
-                               yy * splitTiles + spanFrom * dir_y + offs_y,
-                               xx * splitTiles + spanTo * dir_x,
-                               yy * splitTiles + spanTo * dir_y});
-            spanFrom = -1;
-          }
-        }
-        if (spanFrom >= 0)
-        {
-          portals.push_back({xx * splitTiles + spanFrom * dir_x + offs_x,
-                             yy * splitTiles + spanFrom * dir_y + offs_y,
-                             xx * splitTiles + spanTo * dir_x,
-                             yy * splitTiles + spanTo * dir_y});
-        }
-      };
-
-      std::vector<PathPortal> portals;
-      std::vector<std::vector<size_t>> tilePortalsIndices;
-
-      auto push_portals = [&](size_t x, size_t y,
-                              int offs_x, int offs_y,
-                              const std::vector<PathPortal> &new_portals)
+      DungeonPortals portals = portalCache ? load_or_build_portals(dd, splitTiles, portalCache) : build_portals(dd, splitTiles);
+      // a map too big for the frozen layout gets no FrozenPortalGraph, the hierarchical finder skips it
+      FrozenPortalGraph graph;
+      if (freeze_portals(portals, dd, graph))
       {
-        for (const PathPortal &portal : new_portals)
-        {
-          size_t idx = portals.size();
-          portals.push_back(portal);
-          tilePortalsIndices[y * width + x].push_back(idx);
-          tilePortalsIndices[(y + offs_y) * width + x + offs_x].push_back(idx);
-        }
-      };
-      for (size_t y = 0; y < height; ++y)
-        for (size_t x = 0; x < width; ++x)
-        {
-          tilePortalsIndices.push_back(std::vector<size_t>{});
-          // check top
-          if (y > 0)
-          {
-            std::vector<PathPortal> topPortals;
-            check_border(x, y, 1, 0, 0, -1, topPortals);
-            push_portals(x, y, 0, -1, topPortals);
-          }
-          // left
-          if (x > 0)
-          {
-            std::vector<PathPortal> leftPortals;
-            check_border(x, y, 0, 1, -1, 0, leftPortals);
-            push_portals(x, y, -1, 0, leftPortals);
-          }
-        }
-      for (size_t tidx = 0; tidx < tilePortalsIndices.size(); ++tidx)
-      {
-        const std::vector<size_t> &indices = tilePortalsIndices[tidx];
-        size_t x = tidx % width;
-        size_t y = tidx / width;
-        IVec2 limMin{int((x + 0) * splitTiles), int((y + 0) * splitTiles)};
-        IVec2 limMax{int((x + 1) * splitTiles), int((y + 1) * splitTiles)};
-        for (size_t i = 0; i < indices.size(); ++i)
-        {
-          PathPortal &firstPortal = portals[indices[i]];
-          for (size_t j = i + 1; j < indices.size(); ++j)
-          {
-            PathPortal &secondPortal = portals[indices[j]];
-            // check path from i to j
-            // check each position (to find closest dist) (could be made more optimal)
-            bool noPath = false;
-            size_t minDist = 0xffffffff;
-            for (size_t fromY = std::max(firstPortal.startY, size_t(limMin.y));
-                        fromY <= std::min(firstPortal.endY, size_t(limMax.y - 1)) && !noPath; ++fromY)
-            {
-              for (size_t fromX = std::max(firstPortal.startX, size_t(limMin.x));
-                          fromX <= std::min(firstPortal.endX, size_t(limMax.x - 1)) && !noPath; ++fromX)
-              {
-                for (size_t toY = std::max(secondPortal.startY, size_t(limMin.y));
-                            toY <= std::min(secondPortal.endY, size_t(limMax.y - 1)) && !noPath; ++toY)
-                {
-                  for (size_t toX = std::max(secondPortal.startX, size_t(limMin.x));
-                              toX <= std::min(secondPortal.endX, size_t(limMax.x - 1)) && !noPath; ++toX)
-                  {
-                    IVec2 from{int(fromX), int(fromY)};
-                    IVec2 to{int(toX), int(toY)};
-                    std::vector<IVec2> path = find_path_a_star(dd, from, to, limMin, limMax);
-                    if (path.empty() && from != to)
-                    {
-                      noPath = true; // if we found that there's no path at all - we can break out
-                      break;
-                    }
-                    minDist = std::min(minDist, path.size());
-                  }
-                }
-              }
-            }
-            // write pathable data and length
-            if (noPath)
-              continue;
-            firstPortal.conns.push_back({indices[j], float(minDist)});
-            secondPortal.conns.push_back({indices[i], float(minDist)});
-          }
-        }
+        e.set(build_portal_landmarks(graph));
+        e.set(std::move(graph));
       }
-      e.set(DungeonPortals{splitTiles, portals, tilePortalsIndices});
+      e.set(std::move(portals));
     });
   });
 }
-
@@ -1,6 +1,8 @@
 #pragma once
 #include <flecs.h>
+#include "math.h"
 #include <vector>
+#include <cstdint>
 
 struct PortalConnection
 {
@@ -15,12 +17,53 @@ struct PathPortal
   std::vector<PortalConnection> conns;
 };
 
+// edge between two portals of the same cluster, score is the path length in cells
+struct ClusterEdge
+{
+  size_t first;
+  size_t second;
+  float score;
+};
+
 struct DungeonPortals
 {
   size_t tileSplit;
   std::vector<PathPortal> portals;
   std::vector<std::vector<size_t>> tilePortalsIndices;
+  // intra-cluster edges of every cluster, PathPortal::conns are merged from these in cluster order
+  std::vector<std::vector<ClusterEdge>> clusterEdges;
+  // BFS distance from every portal of a cluster to every cell of it: tileSplit * tileSplit cells
+  // per portal, row by row, portals in tilePortalsIndices order. See cluster_dist.
+  std::vector<std::vector<uint8_t>> clusterDists;
+  uint8_t distBytes = 1; // per cell, 2 once a cluster has more cells than a byte can count
+  std::vector<size_t> freePortals; // slots dropped by repair_portals, in no cluster and unconnected
+  uint32_t revision = 0;           // bumped by every repair, users of conns have to reconnect
 };
 
-void prebuild_map(flecs::world &ecs);
+// unreachable cell in DungeonPortals::clusterDists
+constexpr uint32_t noClusterDist = 0xffff;
+
+// distance from the k-th portal of cluster to its cell local (y * tileSplit + x)
+inline uint32_t cluster_dist(const DungeonPortals &dp, size_t cluster, size_t k, size_t local)
+{
+  const uint8_t *field = dp.clusterDists[cluster].data() + (k * dp.tileSplit * dp.tileSplit + local) * dp.distBytes;
+  if (dp.distBytes == 1)
+    return field[0] == 0xff ? noClusterDist : field[0];
+  return uint32_t(field[0]) | uint32_t(field[1]) << 8;
+}
+
+struct DungeonData;
+
+// builds the portal graph for a single dungeon, doesn't touch ecs.
+// Clusters are connected on up to `threads` threads (0 - hardware concurrency),
+// the result doesn't depend on the thread count.
+DungeonPortals build_portals(const DungeonData &dd, size_t splitTiles, size_t threads = 0);
+// Patches the graph after tiles changed: clusters holding changed cells get their border portals
+// detected again, they and their neighbours get new intra-cluster edges. Portals that kept their
+// span keep their index, new ones reuse freed slots. Returns the number of clusters rebuilt.
+size_t repair_portals(DungeonPortals &dp, const DungeonData &dd, const std::vector<IVec2> &changedCells);
+// sets DungeonPortals, its FrozenPortalGraph and their PortalLandmarks on every dungeon.
+// With a portalCache file the portals are loaded from it when it matches the map and
+// written to it otherwise, nullptr builds them every time
+void prebuild_map(flecs::world &ecs, const char *portalCache = nullptr);
 
@@ -0,0 +1,333 @@
+#include "portalCache.h"
+#include "ecsTypes.h"
+#include "landmarks.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#ifdef _WIN32
+#include <memory>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+// ClusterEdge without the size_t padding
+struct CacheEdge
+{
+  uint32_t first;
+  uint32_t second;
+  float score;
+};
+
+constexpr char cacheMagic[4] = {'W', '7', 'P', 'C'};
+
+size_t align8(size_t offset)
+{
+  return (offset + 7) & ~size_t(7);
+}
+}
+
+bool save_portal_cache(const char *path, const DungeonData &dd, const DungeonPortals &dp)
+{
+  FrozenPortalGraph graph;
+  if (!freeze_portals(dp, dd, graph))
+    return false;
+  std::vector<uint32_t> clusterEdgeOffsets;
+  std::vector<CacheEdge> clusterEdges;
+  for (const std::vector<ClusterEdge> &edges : dp.clusterEdges)
+  {
+    clusterEdgeOffsets.push_back(uint32_t(clusterEdges.size()));
+    for (const ClusterEdge &edge : edges)
+      clusterEdges.push_back({uint32_t(edge.first), uint32_t(edge.second), edge.score});
+  }
+  clusterEdgeOffsets.push_back(uint32_t(clusterEdges.size()));
+  std::vector<uint64_t> distOffsets;
+  size_t distsSize = 0;
+  for (const std::vector<uint8_t> &fields : dp.clusterDists)
+  {
+    distOffsets.push_back(distsSize);
+    distsSize += fields.size();
+  }
+  distOffsets.push_back(distsSize);
+  std::vector<uint32_t> freePortals(dp.freePortals.begin(), dp.freePortals.end());
+
+  PortalCacheHeader header{};
+  memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+  header.version = portalCacheVersion;
+  header.tilesHash = hash_tiles(dd);
+  header.width = uint32_t(dd.width);
+  header.height = uint32_t(dd.height);
+  header.tileSplit = uint32_t(dp.tileSplit);
+  header.distBytes = dp.distBytes;
+  header.portalCount = uint32_t(graph.portals.size());
+  header.edgeCount = uint32_t(graph.edgeTargets.size());
+  header.clusterCount = uint32_t(dp.tilePortalsIndices.size());
+  header.clusterPortalCount = uint32_t(graph.clusterPortals.size());
+  header.clusterEdgeCount = uint32_t(clusterEdges.size());
+  header.freePortalCount = uint32_t(freePortals.size());
+  header.revision = dp.revision;
+
+  // sections in file order, the header is patched with their offsets on the way
+  struct Section
+  {
+    uint64_t *offset;
+    const void *data;
+    size_t size;
+  };
+  const Section sections[] = {
+    {&header.tilesOffset, dd.tiles.data(), dd.tiles.size()},
+    {&header.portalsOffset, graph.portals.data(), graph.portals.size() * sizeof(FrozenPortalGraph::Portal)},
+    {&header.edgeOffsetsOffset, graph.edgeOffsets.data(), graph.edgeOffsets.size() * sizeof(uint32_t)},
+    {&header.edgeTargetsOffset, graph.edgeTargets.data(), graph.edgeTargets.size() * sizeof(uint32_t)},
+    {&header.edgeCostsOffset, graph.edgeCosts.data(), graph.edgeCosts.size() * sizeof(uint16_t)},
+    {&header.clusterOffsetsOffset, graph.clusterOffsets.data(), graph.clusterOffsets.size() * sizeof(uint32_t)},
+    {&header.clusterPortalsOffset, graph.clusterPortals.data(), graph.clusterPortals.size() * sizeof(uint32_t)},
+    {&header.clusterEdgeOffsetsOffset, clusterEdgeOffsets.data(), clusterEdgeOffsets.size() * sizeof(uint32_t)},
+    {&header.clusterEdgesOffset, clusterEdges.data(), clusterEdges.size() * sizeof(CacheEdge)},
+    {&header.freePortalsOffset, freePortals.data(), freePortals.size() * sizeof(uint32_t)},
+    {&header.distOffsetsOffset, distOffsets.data(), distOffsets.size() * sizeof(uint64_t)},
+    {&header.distsOffset, nullptr, distsSize},
+  };
+  size_t offset = align8(sizeof(PortalCacheHeader));
+  for (const Section &section : sections)
+  {
+    *section.offset = offset;
+    offset = align8(offset + section.size);
+  }
+  header.fileSize = offset;
+
+  std::vector<uint8_t> file(offset, 0);
+  memcpy(file.data(), &header, sizeof(header));
+  for (const Section &section : sections)
+    if (section.data && section.size > 0)
+      memcpy(file.data() + *section.offset, section.data, section.size);
+  for (size_t tidx = 0; tidx < dp.clusterDists.size(); ++tidx)
+    if (!dp.clusterDists[tidx].empty())
+      memcpy(file.data() + header.distsOffset + distOffsets[tidx], dp.clusterDists[tidx].data(), dp.clusterDists[tidx].size());
+
+  // written aside and renamed, a reader never maps a half written cache
+  const std::string tmpPath = std::string(path) + ".tmp";
+  FILE *out = fopen(tmpPath.c_str(), "wb");
+  if (!out)
+    return false;
+  const bool written = fwrite(file.data(), 1, file.size(), out) == file.size();
+  if (fclose(out) != 0 || !written)
+  {
+    remove(tmpPath.c_str());
+    return false;
+  }
+  remove(path);
+  return rename(tmpPath.c_str(), path) == 0;
+}
+
+MappedPortalCache::~MappedPortalCache()
+{
+  close();
+}
+
+void MappedPortalCache::close()
+{
+  if (!m_data)
+    return;
+#ifdef _WIN32
+  delete[] m_data;
+#else
+  if (m_mapped)
+    munmap(const_cast<uint8_t *>(m_data), m_size);
+  else
+    delete[] m_data;
+#endif
+  m_data = nullptr;
+  m_size = 0;
+  m_mapped = false;
+  m_graph = PortalGraphView{};
+}
+
+bool MappedPortalCache::open(const char *path, const DungeonData &dd, size_t splitTiles)
+{
+  close();
+#ifdef _WIN32
+  // no mmap here, the file is read into one buffer instead
+  FILE *in = fopen(path, "rb");
+  if (!in)
+    return false;
+  fseek(in, 0, SEEK_END);
+  const long size = ftell(in);
+  fseek(in, 0, SEEK_SET);
+  if (size <= 0)
+  {
+    fclose(in);
+    return false;
+  }
+  std::unique_ptr<uint8_t[]> buffer(new uint8_t[size_t(size)]);
+  const bool read = fread(buffer.get(), 1, size_t(size), in) == size_t(size);
+  fclose(in);
+  if (!read)
+    return false;
+  m_data = buffer.release();
+  m_size = size_t(size);
+#else
+  const int fd = ::open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0)
+  {
+    ::close(fd);
+    return false;
+  }
+  void *data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED)
+    return false;
+  m_data = static_cast<const uint8_t *>(data);
+  m_size = size_t(st.st_size);
+  m_mapped = true;
+#endif
+
+  auto fail = [&]()
+  {
+    close();
+    return false;
+  };
+  if (m_size < sizeof(PortalCacheHeader))
+    return fail();
+  auto section_fits = [&](uint64_t offset, uint64_t size)
+  {
+    return offset % 8 == 0 && offset <= m_size && size <= m_size - offset;
+  };
+  PortalCacheHeader header;
+  memcpy(&header, m_data, sizeof(header));
+  if (memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.version != portalCacheVersion ||
+      header.fileSize != m_size || header.width != dd.width || header.height != dd.height ||
+      header.tileSplit != splitTiles || header.clusterCount != (dd.width / splitTiles) * (dd.height / splitTiles) ||
+      (header.distBytes != 1 && header.distBytes != 2))
+    return fail();
+  // a stale cache of an edited map is the usual mismatch, the hash finds it before anything is read
+  // and the stored tiles rule out a collision
+  if (header.tilesHash != hash_tiles(dd))
+    return fail();
+  if (!section_fits(header.tilesOffset, dd.tiles.size()) || memcmp(m_data + header.tilesOffset, dd.tiles.data(), dd.tiles.size()) != 0)
+    return fail();
+
+  const uint64_t portals = header.portalCount;
+  const uint64_t clusters = header.clusterCount;
+  if (!section_fits(header.portalsOffset, portals * sizeof(FrozenPortalGraph::Portal)) ||
+      !section_fits(header.edgeOffsetsOffset, (portals + 1) * sizeof(uint32_t)) ||
+      !section_fits(header.edgeTargetsOffset, uint64_t(header.edgeCount) * sizeof(uint32_t)) ||
+      !section_fits(header.edgeCostsOffset, uint64_t(header.edgeCount) * sizeof(uint16_t)) ||
+      !section_fits(header.clusterOffsetsOffset, (clusters + 1) * sizeof(uint32_t)) ||
+      !section_fits(header.clusterPortalsOffset, uint64_t(header.clusterPortalCount) * sizeof(uint32_t)) ||
+      !section_fits(header.clusterEdgeOffsetsOffset, (clusters + 1) * sizeof(uint32_t)) ||
+      !section_fits(header.clusterEdgesOffset, uint64_t(header.clusterEdgeCount) * sizeof(CacheEdge)) ||
+      !section_fits(header.freePortalsOffset, uint64_t(header.freePortalCount) * sizeof(uint32_t)) ||
+      !section_fits(header.distOffsetsOffset, (clusters + 1) * sizeof(uint64_t)))
+    return fail();
+
+  m_graph.tileSplit = header.tileSplit;
+  m_graph.clustersWidth = dd.width / splitTiles;
+  m_graph.portalCount = header.portalCount;
+  m_graph.clusterCount = header.clusterCount;
+  m_graph.portals = reinterpret_cast<const FrozenPortalGraph::Portal *>(m_data + header.portalsOffset);
+  m_graph.edgeOffsets = reinterpret_cast<const uint32_t *>(m_data + header.edgeOffsetsOffset);
+  m_graph.edgeTargets = reinterpret_cast<const uint32_t *>(m_data + header.edgeTargetsOffset);
+  m_graph.edgeCosts = reinterpret_cast<const uint16_t *>(m_data + header.edgeCostsOffset);
+  m_graph.clusterOffsets = reinterpret_cast<const uint32_t *>(m_data + header.clusterOffsetsOffset);
+  m_graph.clusterPortals = reinterpret_cast<const uint32_t *>(m_data + header.clusterPortalsOffset);
+
+  // the searches index with these without checks, so a damaged file must not get that far
+  const uint32_t *clusterEdgeOffsets = reinterpret_cast<const uint32_t *>(m_data + header.clusterEdgeOffsetsOffset);
+  const uint64_t *distOffsets = reinterpret_cast<const uint64_t *>(m_data + header.distOffsetsOffset);
+  if (m_graph.edgeOffsets[portals] != header.edgeCount || m_graph.clusterOffsets[clusters] != header.clusterPortalCount ||
+      clusterEdgeOffsets[clusters] != header.clusterEdgeCount || !section_fits(header.distsOffset, distOffsets[clusters]))
+    return fail();
+  for (uint64_t i = 0; i < portals; ++i)
+    if (m_graph.edgeOffsets[i] > m_graph.edgeOffsets[i + 1])
+      return fail();
+  for (uint32_t e = 0; e < header.edgeCount; ++e)
+    if (m_graph.edgeTargets[e] >= portals)
+      return fail();
+  const size_t fieldSize = splitTiles * splitTiles * header.distBytes;
+  for (uint64_t c = 0; c < clusters; ++c)
+  {
+    const uint32_t clusterSize = m_graph.clusterOffsets[c + 1] - m_graph.clusterOffsets[c];
+    if (m_graph.clusterOffsets[c] > m_graph.clusterOffsets[c + 1] || clusterEdgeOffsets[c] > clusterEdgeOffsets[c + 1] ||
+        distOffsets[c] > distOffsets[c + 1] || distOffsets[c + 1] - distOffsets[c] != clusterSize * fieldSize)
+      return fail();
+  }
+  for (uint32_t i = 0; i < header.clusterPortalCount; ++i)
+    if (m_graph.clusterPortals[i] >= portals)
+      return fail();
+  const CacheEdge *clusterEdges = reinterpret_cast<const CacheEdge *>(m_data + header.clusterEdgesOffset);
+  for (uint32_t e = 0; e < header.clusterEdgeCount; ++e)
+    if (clusterEdges[e].first >= portals || clusterEdges[e].second >= portals)
+      return fail();
+  const uint32_t *freePortals = reinterpret_cast<const uint32_t *>(m_data + header.freePortalsOffset);
+  for (uint32_t i = 0; i < header.freePortalCount; ++i)
+    if (freePortals[i] >= portals)
+      return fail();
+  return true;
+}
+
+DungeonPortals MappedPortalCache::to_portals() const
+{
+  DungeonPortals dp{};
+  if (!m_data)
+    return dp;
+  PortalCacheHeader header;
+  memcpy(&header, m_data, sizeof(header));
+  const PortalGraphView &graph = m_graph;
+  dp.tileSplit = graph.tileSplit;
+  dp.distBytes = uint8_t(header.distBytes);
+  dp.revision = header.revision;
+  dp.portals.resize(graph.portalCount);
+  for (size_t i = 0; i < graph.portalCount; ++i)
+  {
+    const FrozenPortalGraph::Portal &portal = graph.portals[i];
+    dp.portals[i].startX = portal.startX;
+    dp.portals[i].startY = portal.startY;
+    dp.portals[i].endX = portal.endX;
+    dp.portals[i].endY = portal.endY;
+  }
+  const uint32_t *clusterEdgeOffsets = reinterpret_cast<const uint32_t *>(m_data + header.clusterEdgeOffsetsOffset);
+  const CacheEdge *clusterEdges = reinterpret_cast<const CacheEdge *>(m_data + header.clusterEdgesOffset);
+  const uint64_t *distOffsets = reinterpret_cast<const uint64_t *>(m_data + header.distOffsetsOffset);
+  const uint8_t *dists = m_data + header.distsOffset;
+  dp.tilePortalsIndices.resize(graph.clusterCount);
+  dp.clusterEdges.resize(graph.clusterCount);
+  dp.clusterDists.resize(graph.clusterCount);
+  for (size_t tidx = 0; tidx < graph.clusterCount; ++tidx)
+  {
+    dp.tilePortalsIndices[tidx].assign(graph.clusterPortals + graph.clusterOffsets[tidx], graph.clusterPortals + graph.clusterOffsets[tidx + 1]);
+    std::vector<ClusterEdge> &edges = dp.clusterEdges[tidx];
+    edges.reserve(clusterEdgeOffsets[tidx + 1] - clusterEdgeOffsets[tidx]);
+    for (uint32_t e = clusterEdgeOffsets[tidx]; e < clusterEdgeOffsets[tidx + 1]; ++e)
+    {
+      edges.push_back({clusterEdges[e].first, clusterEdges[e].second, clusterEdges[e].score});
+      // cluster order, same as the merge in build_portals
+      dp.portals[clusterEdges[e].first].conns.push_back({clusterEdges[e].second, clusterEdges[e].score});
+      dp.portals[clusterEdges[e].second].conns.push_back({clusterEdges[e].first, clusterEdges[e].score});
+    }
+    dp.clusterDists[tidx].assign(dists + distOffsets[tidx], dists + distOffsets[tidx + 1]);
+  }
+  const uint32_t *freePortals = reinterpret_cast<const uint32_t *>(m_data + header.freePortalsOffset);
+  dp.freePortals.assign(freePortals, freePortals + header.freePortalCount);
+  return dp;
+}
+
+DungeonPortals load_or_build_portals(const DungeonData &dd, size_t splitTiles, const char *cachePath, bool *fromCache)
+{
+  MappedPortalCache cache;
+  const bool hit = cache.open(cachePath, dd, splitTiles);
+  if (fromCache)
+    *fromCache = hit;
+  if (hit)
+    return cache.to_portals();
+  DungeonPortals dp = build_portals(dd, splitTiles);
+  save_portal_cache(cachePath, dd, dp);
+  return dp;
+}
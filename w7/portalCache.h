@@ -0,0 +1,76 @@
+#pragma once
+#include "portalGraph.h"
+#include <cstdint>
+#include <cstddef>
+
+struct DungeonData;
+
+// Prebuilt portal graph on disk. A header, then flat arrays: the tiles it was built from, the
+// FrozenPortalGraph arrays, the cluster edges and distance fields of DungeonPortals.
+// Every array starts 8 byte aligned, offsets are from the start of the file.
+// Native byte order, the file is a cache and not meant to move between machines.
+struct PortalCacheHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t tilesHash;         // hash_tiles, same as DungeonLandmarks
+  uint32_t width;
+  uint32_t height;
+  uint32_t tileSplit;
+  uint32_t distBytes;
+  uint32_t portalCount;
+  uint32_t edgeCount;         // directed, both sides of every cluster edge
+  uint32_t clusterCount;
+  uint32_t clusterPortalCount;
+  uint32_t clusterEdgeCount;
+  uint32_t freePortalCount;
+  uint32_t revision;          // DungeonPortals::revision at save time
+  uint32_t reserved;          // zero, keeps the offsets below 8 byte aligned
+  uint64_t fileSize;
+  uint64_t tilesOffset;
+  uint64_t portalsOffset;
+  uint64_t edgeOffsetsOffset;
+  uint64_t edgeTargetsOffset;
+  uint64_t edgeCostsOffset;
+  uint64_t clusterOffsetsOffset;
+  uint64_t clusterPortalsOffset;
+  uint64_t clusterEdgeOffsetsOffset;
+  uint64_t clusterEdgesOffset;
+  uint64_t freePortalsOffset;
+  uint64_t distOffsetsOffset; // clusterCount + 1 offsets into the dists
+  uint64_t distsOffset;
+};
+
+// bumped on every layout change, older files are rebuilt
+constexpr uint32_t portalCacheVersion = 1;
+
+bool save_portal_cache(const char *path, const DungeonData &dd, const DungeonPortals &dp);
+
+// Read-only mapping of a cache file, graph() points straight into it.
+class MappedPortalCache
+{
+  const uint8_t *m_data = nullptr;
+  size_t m_size = 0;
+  bool m_mapped = false; // false - m_data is a heap copy where mmap isn't available
+  PortalGraphView m_graph;
+
+  void close();
+public:
+  MappedPortalCache() = default;
+  MappedPortalCache(const MappedPortalCache &) = delete;
+  MappedPortalCache &operator=(const MappedPortalCache &) = delete;
+  ~MappedPortalCache();
+
+  // false if the file is missing, truncated, of another version or built from other tiles
+  bool open(const char *path, const DungeonData &dd, size_t splitTiles);
+  bool is_open() const { return m_data != nullptr; }
+  size_t file_size() const { return m_size; }
+  const PortalGraphView &graph() const { return m_graph; }
+  // a mutable DungeonPortals with the same indices, copied out without searching.
+  // This is a copy of every array, only graph() reads the mapping in place
+  DungeonPortals to_portals() const;
+};
+
+// DungeonPortals from the cache if it matches dd, otherwise built and written back to it.
+// The cache only saves the BFS passes of the build, the result is copied out with to_portals()
+DungeonPortals load_or_build_portals(const DungeonData &dd, size_t splitTiles, const char *cachePath, bool *fromCache = nullptr);
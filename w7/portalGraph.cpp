@@ -0,0 +1,294 @@
+#include "portalGraph.h"
+#include "searchContext.h"
+#include "ecsTypes.h"
+#include <algorithm>
+#include <cstdlib>
+
+bool freeze_portals(const DungeonPortals &dp, const DungeonData &dd, FrozenPortalGraph &graph)
+{
+  // coordinates and costs are stored as uint16, indices and offsets as uint32
+  if (dd.width > 0xffff || dd.height > 0xffff || dp.portals.size() > 0xffffffff)
+    return false;
+  size_t edgeCount = 0;
+  for (const std::vector<ClusterEdge> &edges : dp.clusterEdges)
+    for (const ClusterEdge &edge : edges)
+    {
+      if (edge.score > 65535.f)
+        return false;
+      edgeCount += 2;
+    }
+  if (edgeCount > 0xffffffff)
+    return false;
+
+  graph = FrozenPortalGraph{};
+  graph.tileSplit = dp.tileSplit;
+  graph.clustersWidth = dd.width / dp.tileSplit;
+  graph.revision = dp.revision;
+  const size_t count = dp.portals.size();
+  graph.portals.resize(count);
+
+  std::vector<uint32_t> degree(count + 1, 0);
+  for (const std::vector<ClusterEdge> &edges : dp.clusterEdges)
+    for (const ClusterEdge &edge : edges)
+    {
+      degree[edge.first] += 1;
+      degree[edge.second] += 1;
+    }
+  graph.edgeOffsets.resize(count + 1);
+  uint32_t offset = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    graph.edgeOffsets[i] = offset;
+    offset += degree[i];
+  }
+  graph.edgeOffsets[count] = offset;
+  graph.edgeTargets.resize(offset);
+  graph.edgeCosts.resize(offset);
+  // cluster order, same as PathPortal::conns
+  std::vector<uint32_t> fill(graph.edgeOffsets.begin(), graph.edgeOffsets.end() - 1);
+  for (const std::vector<ClusterEdge> &edges : dp.clusterEdges)
+    for (const ClusterEdge &edge : edges)
+    {
+      graph.edgeTargets[fill[edge.first]] = uint32_t(edge.second);
+      graph.edgeCosts[fill[edge.first]++] = uint16_t(edge.score);
+      graph.edgeTargets[fill[edge.second]] = uint32_t(edge.first);
+      graph.edgeCosts[fill[edge.second]++] = uint16_t(edge.score);
+    }
+
+  // only listed portals get their coordinates, freed slots may hold anything and stay zero
+  graph.clusterOffsets.reserve(dp.tilePortalsIndices.size() + 1);
+  for (size_t tidx = 0; tidx < dp.tilePortalsIndices.size(); ++tidx)
+  {
+    graph.clusterOffsets.push_back(uint32_t(graph.clusterPortals.size()));
+    for (size_t idx : dp.tilePortalsIndices[tidx])
+    {
+      const PathPortal &portal = dp.portals[idx];
+      graph.portals[idx] = {uint16_t(portal.startX), uint16_t(portal.startY), uint16_t(portal.endX), uint16_t(portal.endY)};
+      graph.clusterPortals.push_back(uint32_t(idx));
+    }
+  }
+  graph.clusterOffsets.push_back(uint32_t(graph.clusterPortals.size()));
+  return true;
+}
+
+PortalGraphView view_portals(const FrozenPortalGraph &graph)
+{
+  const size_t clusterCount = graph.clusterOffsets.empty() ? 0 : graph.clusterOffsets.size() - 1;
+  return PortalGraphView{graph.tileSplit, graph.clustersWidth, graph.portals.size(), clusterCount,
+                         graph.portals.data(), graph.edgeOffsets.data(), graph.edgeTargets.data(), graph.edgeCosts.data(),
+                         graph.clusterOffsets.data(), graph.clusterPortals.data()};
+}
+
+size_t FrozenPortalGraph::memory_bytes() const
+{
+  return portals.capacity() * sizeof(Portal) + edgeOffsets.capacity() * sizeof(uint32_t) +
+         edgeTargets.capacity() * sizeof(uint32_t) + edgeCosts.capacity() * sizeof(uint16_t) +
+         clusterOffsets.capacity() * sizeof(uint32_t) + clusterPortals.capacity() * sizeof(uint32_t);
+}
+
+size_t portals_memory_bytes(const DungeonPortals &dp)
+{
+  size_t bytes = dp.portals.capacity() * sizeof(PathPortal) + dp.tilePortalsIndices.capacity() * sizeof(std::vector<size_t>) +
+                 dp.clusterEdges.capacity() * sizeof(std::vector<ClusterEdge>) + dp.freePortals.capacity() * sizeof(size_t);
+  for (const PathPortal &portal : dp.portals)
+    bytes += portal.conns.capacity() * sizeof(PortalConnection);
+  for (const std::vector<size_t> &indices : dp.tilePortalsIndices)
+    bytes += indices.capacity() * sizeof(size_t);
+  for (const std::vector<ClusterEdge> &edges : dp.clusterEdges)
+    bytes += edges.capacity() * sizeof(ClusterEdge);
+  return bytes;
+}
+
+size_t cluster_dists_memory_bytes(const DungeonPortals &dp)
+{
+  size_t bytes = dp.clusterDists.capacity() * sizeof(std::vector<uint8_t>);
+  for (const std::vector<uint8_t> &fields : dp.clusterDists)
+    bytes += fields.capacity();
+  return bytes;
+}
+
+void PortalLandmarks::add_edge(uint32_t *row, size_t portal, float score) const
+{
+  const uint32_t *through = dists_of(portal);
+  for (size_t l = 0; l < count; ++l)
+    if (through[l] != unknown)
+      row[l] = std::min(row[l], through[l] + uint32_t(score));
+}
+
+float PortalLandmarks::heuristic(const uint32_t *from, const uint32_t *to) const
+{
+  uint32_t best = 0;
+  for (size_t l = 0; l < count; ++l)
+    if (from[l] != unknown && to[l] != unknown)
+      best = std::max(best, from[l] > to[l] ? from[l] - to[l] : to[l] - from[l]);
+  return float(best);
+}
+
+// Dijkstra over the CSR edges, portals it doesn't reach stay unknown
+static void portal_dists(SearchContext &ctx, const FrozenPortalGraph &graph, uint32_t source, std::vector<uint32_t> &dist)
+{
+  dist.assign(graph.portal_count(), PortalLandmarks::unknown);
+  ctx.begin(graph.portal_count(), 1);
+  ctx.set(source, 0.f, -1);
+  ctx.open.push(source, {0.f, 0.f});
+  while (!ctx.open.empty())
+  {
+    const uint32_t cur = ctx.open.pop();
+    ctx.close(cur);
+    const float curG = ctx.g(cur);
+    dist[cur] = uint32_t(curG);
+    for (uint32_t e = graph.edgeOffsets[cur]; e < graph.edgeOffsets[cur + 1]; ++e)
+    {
+      const uint32_t next = graph.edgeTargets[e];
+      const float gScore = curG + float(graph.edgeCosts[e]);
+      if (!ctx.is_closed(next) && gScore < ctx.g(next))
+      {
+        ctx.set(next, gScore, int(cur));
+        ctx.open.update(next, {gScore, gScore});
+      }
+    }
+  }
+}
+
+PortalLandmarks build_portal_landmarks(const FrozenPortalGraph &graph, size_t count)
+{
+  PortalLandmarks res;
+  res.revision = graph.revision;
+  res.portalCount = graph.portal_count();
+  // slots freed by a repair aren't listed by any cluster and never become landmarks
+  std::vector<bool> live(res.portalCount, false);
+  for (uint32_t idx : graph.clusterPortals)
+    live[idx] = true;
+  const auto seed = std::find(live.begin(), live.end(), true);
+  if (seed == live.end() || count == 0)
+    return res;
+
+  SearchContext ctx;
+  std::vector<uint32_t> dist;
+  portal_dists(ctx, graph, uint32_t(seed - live.begin()), dist);
+  std::vector<uint32_t> closest = dist; // distance to the nearest landmark so far
+
+  std::vector<std::vector<uint32_t>> tables;
+  for (size_t l = 0; l < count; ++l)
+  {
+    // farthest-point selection, same as build_landmarks
+    size_t farthest = res.portalCount;
+    for (size_t i = 0; i < res.portalCount; ++i)
+      if (live[i] && closest[i] != PortalLandmarks::unknown && (farthest == res.portalCount || closest[i] > closest[farthest]))
+        farthest = i;
+    if (farthest == res.portalCount || closest[farthest] == 0)
+      break;
+    portal_dists(ctx, graph, uint32_t(farthest), dist);
+    for (size_t i = 0; i < res.portalCount; ++i)
+      closest[i] = l == 0 ? dist[i] : std::min(closest[i], dist[i]);
+    tables.push_back(dist);
+  }
+
+  res.count = tables.size();
+  res.dists.resize(res.portalCount * res.count);
+  for (size_t i = 0; i < res.portalCount; ++i)
+    for (size_t l = 0; l < res.count; ++l)
+      res.dists[i * res.count + l] = tables[l][i];
+  return res;
+}
+
+// A* with the portal landmark bound. It is consistent, so a closed portal is final.
+template<typename Graph>
+static bool search(SearchContext &ctx, const Graph &graph, const PortalLandmarks *landmarks, uint32_t from, uint32_t to,
+                   std::vector<uint32_t> &path, size_t *expanded)
+{
+  path.clear();
+  const size_t count = graph.count();
+  if (from >= count || to >= count)
+    return false;
+  auto h = [&](uint32_t portal) { return landmarks ? landmarks->heuristic(portal, to) : 0.f; };
+  ctx.begin(count, 1);
+  size_t numExpanded = 0;
+  ctx.set(from, 0.f, -1);
+  ctx.open.push(from, {h(from), 0.f});
+  bool found = false;
+  while (!ctx.open.empty())
+  {
+    const uint32_t cur = ctx.open.pop();
+    if (cur == to)
+    {
+      found = true;
+      break;
+    }
+    ctx.close(cur);
+    numExpanded += 1;
+    const float curG = ctx.g(cur);
+    graph.for_each_edge(cur, [&](uint32_t next, float cost)
+    {
+      if (ctx.is_closed(next))
+        return;
+      const float gScore = curG + cost;
+      if (gScore < ctx.g(next))
+      {
+        ctx.set(next, gScore, int(cur));
+        ctx.open.update(next, {gScore + h(next), gScore});
+      }
+    });
+  }
+  if (expanded)
+    *expanded = numExpanded;
+  if (!found)
+    return false;
+  for (int i = int(to); i >= 0; i = ctx.prev(size_t(i)))
+    path.push_back(uint32_t(i));
+  std::reverse(path.begin(), path.end());
+  return true;
+}
+
+namespace
+{
+struct FrozenAccess
+{
+  const PortalGraphView &graph;
+
+  size_t count() const { return graph.portalCount; }
+  template<typename Fn>
+  void for_each_edge(uint32_t portal, Fn &&fn) const
+  {
+    for (uint32_t e = graph.edgeOffsets[portal]; e < graph.edgeOffsets[portal + 1]; ++e)
+      fn(graph.edgeTargets[e], float(graph.edgeCosts[e]));
+  }
+};
+
+struct BuilderAccess
+{
+  const DungeonPortals &dp;
+
+  size_t count() const { return dp.portals.size(); }
+  template<typename Fn>
+  void for_each_edge(uint32_t portal, Fn &&fn) const
+  {
+    for (const PortalConnection &conn : dp.portals[portal].conns)
+      fn(uint32_t(conn.connIdx), conn.score);
+  }
+};
+}
+
+bool find_portal_path(SearchContext &ctx, const FrozenPortalGraph &graph, uint32_t from, uint32_t to,
+                      std::vector<uint32_t> &path, const PortalLandmarks *landmarks, size_t *expanded)
+{
+  if (landmarks && landmarks->revision != graph.revision)
+    landmarks = nullptr;
+  return find_portal_path(ctx, view_portals(graph), from, to, path, landmarks, expanded);
+}
+
+bool find_portal_path(SearchContext &ctx, const PortalGraphView &graph, uint32_t from, uint32_t to,
+                      std::vector<uint32_t> &path, const PortalLandmarks *landmarks, size_t *expanded)
+{
+  if (landmarks && landmarks->portalCount != graph.portalCount)
+    landmarks = nullptr;
+  return search(ctx, FrozenAccess{graph}, landmarks, from, to, path, expanded);
+}
+
+bool find_portal_path(SearchContext &ctx, const DungeonPortals &dp, uint32_t from, uint32_t to,
+                      std::vector<uint32_t> &path, const PortalLandmarks *landmarks, size_t *expanded)
+{
+  if (landmarks && (landmarks->revision != dp.revision || landmarks->portalCount != dp.portals.size()))
+    landmarks = nullptr;
+  return search(ctx, BuilderAccess{dp}, landmarks, from, to, path, expanded);
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "pathfinder.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class SearchContext;
+
+// Frozen compressed-sparse-row copy of DungeonPortals for the abstract search.
+// DungeonPortals stays the mutable builder (build_portals, repair_portals), freeze it again
+// after edits. Portal indices are the same as in the builder, portals freed by a repair are
+// left without edges.
+struct FrozenPortalGraph
+{
+  struct Portal
+  {
+    uint16_t startX, startY;
+    uint16_t endX, endY;
+  };
+
+  size_t tileSplit = 0;
+  size_t clustersWidth = 0; // clusters per row
+  uint32_t revision = 0; // of the DungeonPortals it was frozen from
+  std::vector<Portal> portals;
+  std::vector<uint32_t> edgeOffsets;    // portal i has edges [edgeOffsets[i], edgeOffsets[i + 1])
+  std::vector<uint32_t> edgeTargets;
+  std::vector<uint16_t> edgeCosts;      // path length in cells, like PortalConnection::score
+  std::vector<uint32_t> clusterOffsets; // cluster c has portals [clusterOffsets[c], clusterOffsets[c + 1])
+  std::vector<uint32_t> clusterPortals;
+
+  size_t portal_count() const { return portals.size(); }
+  size_t memory_bytes() const;
+};
+
+// The same arrays without owning them, over a FrozenPortalGraph or a mapped portal cache
+struct PortalGraphView
+{
+  size_t tileSplit = 0;
+  size_t clustersWidth = 0;
+  size_t portalCount = 0;
+  size_t clusterCount = 0;
+  const FrozenPortalGraph::Portal *portals = nullptr;
+  const uint32_t *edgeOffsets = nullptr;    // portalCount + 1
+  const uint32_t *edgeTargets = nullptr;
+  const uint16_t *edgeCosts = nullptr;
+  const uint32_t *clusterOffsets = nullptr; // clusterCount + 1
+  const uint32_t *clusterPortals = nullptr;
+};
+
+PortalGraphView view_portals(const FrozenPortalGraph &graph);
+
+// Coordinates and costs have to fit uint16, so maps up to 65535 cells a side.
+// Returns false and leaves graph untouched if dp doesn't fit the layout.
+bool freeze_portals(const DungeonPortals &dp, const DungeonData &dd, FrozenPortalGraph &graph);
+// heap usage of the builder, for comparison. Distance fields are counted apart, the frozen graph has none
+size_t portals_memory_bytes(const DungeonPortals &dp);
+// heap usage of DungeonPortals::clusterDists
+size_t cluster_dists_memory_bytes(const DungeonPortals &dp);
+
+// ALT bound for searches over the portal graph. Moving along a portal's span costs nothing
+// there, so a cell distance between two spans (their rectangle gap or a cell landmark bound)
+// can exceed the portal path. These tables hold graph distances from a few landmark portals,
+// and |d(L, a) - d(L, b)| is a consistent bound in the graph metric itself.
+// Build them again whenever the graph is frozen again.
+struct PortalLandmarks
+{
+  static constexpr uint32_t unknown = 0xffffffff;
+
+  size_t count = 0;
+  size_t portalCount = 0;
+  uint32_t revision = 0;       // of the graph they were built from
+  std::vector<uint32_t> dists; // [portal * count + landmark]
+
+  const uint32_t *dists_of(size_t portal) const { return dists.data() + portal * count; }
+  // row of a node outside the graph (a query's start or end): starts all unknown and
+  // takes every edge of the node
+  void add_edge(uint32_t *row, size_t portal, float score) const;
+  // lower bound on the graph distance between two rows, 0 if no landmark reaches both
+  float heuristic(const uint32_t *from, const uint32_t *to) const;
+  float heuristic(size_t from, size_t to) const { return heuristic(dists_of(from), dists_of(to)); }
+};
+
+constexpr size_t defaultPortalLandmarkCount = 8;
+
+// farthest-point landmarks over the live portals, one Dijkstra over the CSR edges from each
+PortalLandmarks build_portal_landmarks(const FrozenPortalGraph &graph, size_t count = defaultPortalLandmarkCount);
+
+// A* between two portals, path is from first. Without landmarks (or with tables of another
+// graph) the bound is 0 and the search is Dijkstra. The DungeonPortals overload runs the same
+// search over the builder.
+bool find_portal_path(SearchContext &ctx, const FrozenPortalGraph &graph, uint32_t from, uint32_t to,
+                      std::vector<uint32_t> &path, const PortalLandmarks *landmarks = nullptr, size_t *expanded = nullptr);
+bool find_portal_path(SearchContext &ctx, const PortalGraphView &graph, uint32_t from, uint32_t to,
+                      std::vector<uint32_t> &path, const PortalLandmarks *landmarks = nullptr, size_t *expanded = nullptr);
+bool find_portal_path(SearchContext &ctx, const DungeonPortals &dp, uint32_t from, uint32_t to,
+                      std::vector<uint32_t> &path, const PortalLandmarks *landmarks = nullptr, size_t *expanded = nullptr);
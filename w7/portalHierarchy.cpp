@@ -0,0 +1,409 @@
+#include "portalHierarchy.h"
+#include "ecsTypes.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+static constexpr uint32_t npos = 0xffffffff;
+static constexpr uint32_t infDist = 0xffffffff;
+
+// cluster of `level` holding the DungeonPortals cluster (x, y)
+static uint32_t level_cluster(const PortalLevel &level, size_t x, size_t y)
+{
+  return uint32_t((y / level.span) * level.clustersWidth + x / level.span);
+}
+
+static uint32_t cell_cluster(const PortalHierarchy &hier, size_t level, IVec2 cell)
+{
+  return level_cluster(hier.levels[level], size_t(cell.x) / hier.tileSplit, size_t(cell.y) / hier.tileSplit);
+}
+
+// cluster of level + 1 a cluster of `level` belongs to
+static uint32_t parent_cluster(const PortalHierarchy &hier, size_t level, uint32_t cluster)
+{
+  const PortalLevel &cur = hier.levels[level];
+  const size_t x = cluster % cur.clustersWidth;
+  const size_t y = cluster / cur.clustersWidth;
+  return uint32_t((y / hier.factor) * hier.levels[level + 1].clustersWidth + x / hier.factor);
+}
+
+size_t PortalLevel::memory_bytes() const
+{
+  return edgeOffsets.capacity() * sizeof(uint32_t) + edges.capacity() * sizeof(LevelEdge) +
+         clusterOffsets.capacity() * sizeof(uint32_t) + clusterPortals.capacity() * sizeof(uint32_t);
+}
+
+size_t PortalHierarchy::memory_bytes(size_t levelCount) const
+{
+  size_t bytes = 0;
+  for (size_t i = 0; i < std::min(levelCount, levels.size()); ++i)
+    bytes += levels[i].memory_bytes();
+  return bytes;
+}
+
+// counting sort of (portal, edge) pairs into the CSR arrays of the level
+static void fill_edges(PortalLevel &level, size_t count, const std::vector<std::pair<uint32_t, LevelEdge>> &edges)
+{
+  level.edgeOffsets.assign(count + 1, 0);
+  for (const auto &edge : edges)
+    level.edgeOffsets[edge.first + 1] += 1;
+  for (size_t i = 0; i < count; ++i)
+    level.edgeOffsets[i + 1] += level.edgeOffsets[i];
+  level.edges.resize(edges.size());
+  std::vector<uint32_t> fill(level.edgeOffsets.begin(), level.edgeOffsets.end() - 1);
+  for (const auto &edge : edges)
+    level.edges[fill[edge.first]++] = edge.second;
+}
+
+PortalHierarchy build_portal_hierarchy(const DungeonPortals &dp, const DungeonData &dd, size_t levelCount, size_t factor)
+{
+  PortalHierarchy hier;
+  hier.tileSplit = dp.tileSplit;
+  hier.factor = std::max<size_t>(factor, 2);
+  hier.revision = dp.revision;
+  const size_t count = dp.portals.size();
+  const size_t width = dd.width / dp.tileSplit;
+  const size_t height = dd.height / dp.tileSplit;
+
+  // level 0 is the cluster edge buffers in CSR form
+  PortalLevel &base = hier.levels.emplace_back();
+  base.clustersWidth = width;
+  base.clustersHeight = height;
+  std::vector<std::pair<uint32_t, LevelEdge>> edges;
+  for (size_t tidx = 0; tidx < dp.clusterEdges.size(); ++tidx)
+    for (const ClusterEdge &edge : dp.clusterEdges[tidx])
+    {
+      edges.push_back({uint32_t(edge.first), {uint32_t(edge.second), uint32_t(tidx), edge.score}});
+      edges.push_back({uint32_t(edge.second), {uint32_t(edge.first), uint32_t(tidx), edge.score}});
+    }
+  fill_edges(base, count, edges);
+  std::vector<bool> live(count, false);
+  for (const std::vector<size_t> &indices : dp.tilePortalsIndices)
+  {
+    base.clusterOffsets.push_back(uint32_t(base.clusterPortals.size()));
+    for (size_t idx : indices)
+    {
+      base.clusterPortals.push_back(uint32_t(idx));
+      if (!live[idx])
+        ++base.portalCount;
+      live[idx] = true;
+    }
+  }
+  base.clusterOffsets.push_back(uint32_t(base.clusterPortals.size()));
+
+  MultiLevelPathFinder scratch;
+  scratch.m_start_idx = uint32_t(count);
+  scratch.m_end_idx = uint32_t(count + 1);
+  scratch.m_prevCluster.resize(count + 2);
+  scratch.m_goalStamp.resize(count + 2, 0);
+  scratch.m_goalScore.resize(count + 2);
+  std::vector<size_t> promoted;
+  for (size_t idx = 0; idx < count; ++idx)
+    if (live[idx])
+      promoted.push_back(idx);
+  for (size_t k = 1; k < levelCount; ++k)
+  {
+    const PortalLevel &below = hier.levels[k - 1];
+    PortalLevel level;
+    level.span = below.span * hier.factor;
+    level.clustersWidth = (width + level.span - 1) / level.span;
+    level.clustersHeight = (height + level.span - 1) / level.span;
+    // portals still on a border at this level, listed by both of their clusters
+    std::vector<std::vector<uint32_t>> buckets(level.clustersWidth * level.clustersHeight);
+    std::vector<size_t> next;
+    for (size_t idx : promoted)
+    {
+      const PathPortal &portal = dp.portals[idx];
+      const uint32_t first = level_cluster(level, portal.startX / dp.tileSplit, portal.startY / dp.tileSplit);
+      const uint32_t second = level_cluster(level, portal.endX / dp.tileSplit, portal.endY / dp.tileSplit);
+      if (first == second)
+        continue;
+      buckets[first].push_back(uint32_t(idx));
+      buckets[second].push_back(uint32_t(idx));
+      next.push_back(idx);
+    }
+    promoted = std::move(next);
+    level.portalCount = promoted.size();
+    for (const std::vector<uint32_t> &bucket : buckets)
+    {
+      level.clusterOffsets.push_back(uint32_t(level.clusterPortals.size()));
+      level.clusterPortals.insert(level.clusterPortals.end(), bucket.begin(), bucket.end());
+    }
+    level.clusterOffsets.push_back(uint32_t(level.clusterPortals.size()));
+    hier.levels.push_back(std::move(level));
+
+    // one search over the level below per portal and cluster, it stays inside the cluster
+    edges.clear();
+    for (uint32_t cluster = 0; cluster < buckets.size(); ++cluster)
+      for (uint32_t from : buckets[cluster])
+      {
+        scratch.m_seeds.assign(1, {from, 0.f, -1, 0});
+        scratch.search(hier, dp, k - 1, cluster, npos, nullptr);
+        for (uint32_t to : buckets[cluster])
+          if (to != from && scratch.m_ctx.g(to) != std::numeric_limits<float>::max())
+            edges.push_back({from, {to, cluster, scratch.m_ctx.g(to)}});
+      }
+    fill_edges(hier.levels.back(), count, edges);
+  }
+  return hier;
+}
+
+const PathPortal &MultiLevelPathFinder::get_portal(const DungeonPortals &dp, size_t portal_idx) const
+{
+  if (portal_idx == m_start_idx)
+    return m_start_portal;
+  if (portal_idx == m_end_idx)
+    return m_end_portal;
+  return dp.portals[portal_idx];
+}
+
+void MultiLevelPathFinder::set_goal_edges(const std::vector<VirtualEdge> &edges)
+{
+  if (++m_goalGeneration == 0)
+  {
+    std::fill(m_goalStamp.begin(), m_goalStamp.end(), 0);
+    m_goalGeneration = 1;
+  }
+  for (const VirtualEdge &edge : edges)
+  {
+    m_goalStamp[edge.portal] = m_goalGeneration;
+    m_goalScore[edge.portal] = edge.score;
+  }
+}
+
+// A* (Dijkstra without a target or landmarks) over one level from m_seeds. region is a cluster of
+// level + 1 the search must stay in, npos for the whole map. Edges into the goal come from set_goal_edges.
+// The landmarks hold level 0 distances and an edge of any level is a path over level 0, so the
+// bound stays consistent on every level.
+bool MultiLevelPathFinder::search(const PortalHierarchy &hier, const DungeonPortals &dp, size_t level, uint32_t region,
+                                  uint32_t target, std::vector<Step> *path)
+{
+  const PortalLevel &graph = hier.levels[level];
+  const size_t count = dp.portals.size();
+  const uint32_t goalCluster = target == m_end_idx ? cell_cluster(hier, level, IVec2{int(m_end_portal.startX), int(m_end_portal.startY)}) : 0;
+  auto h = [&](uint32_t node)
+  {
+    if (!m_landmarks || target == npos || node >= count)
+      return 0.f;
+    return m_landmarks->heuristic(m_landmarks->dists_of(node), target == m_end_idx ? m_goalRow.data() : m_landmarks->dists_of(target));
+  };
+
+  m_ctx.begin(count + 2, 1);
+  for (const Seed &seed : m_seeds)
+    if (seed.g < m_ctx.g(seed.node))
+    {
+      m_ctx.set(seed.node, seed.g, seed.prev);
+      m_prevCluster[seed.node] = seed.cluster;
+      m_ctx.open.update(seed.node, {seed.g + h(seed.node), seed.g});
+    }
+  bool found = false;
+  while (!m_ctx.open.empty())
+  {
+    const uint32_t cur = m_ctx.open.pop();
+    if (cur == target)
+    {
+      found = true;
+      break;
+    }
+    m_ctx.close(cur);
+    m_last_expanded += 1;
+    const float curG = m_ctx.g(cur);
+    auto relax = [&](uint32_t next, float score, uint32_t cluster)
+    {
+      const float gScore = curG + score;
+      if (!m_ctx.is_closed(next) && gScore < m_ctx.g(next))
+      {
+        m_ctx.set(next, gScore, int(cur));
+        m_prevCluster[next] = cluster;
+        m_ctx.open.update(next, {gScore + h(next), gScore});
+      }
+    };
+    if (cur >= count)
+      continue;
+    for (uint32_t e = graph.edgeOffsets[cur]; e < graph.edgeOffsets[cur + 1]; ++e)
+    {
+      const LevelEdge &edge = graph.edges[e];
+      if (region == npos || parent_cluster(hier, level, edge.cluster) == region)
+        relax(edge.target, edge.score, edge.cluster);
+    }
+    if (target == m_end_idx && m_goalStamp[cur] == m_goalGeneration)
+      relax(m_end_idx, m_goalScore[cur], goalCluster);
+  }
+  if (found && path)
+  {
+    path->clear();
+    for (int i = int(target); i >= 0; i = m_ctx.prev(size_t(i)))
+      path->push_back({uint32_t(i), m_prevCluster[size_t(i)]});
+    std::reverse(path->begin(), path->end());
+  }
+  return found;
+}
+
+// Edges from a cell to the portals of its cluster on every level up to topLevel: BFS inside its
+// DungeonPortals cluster, then a search over each level inside the cluster of the next one.
+void MultiLevelPathFinder::connect_cell(const PortalHierarchy &hier, const DungeonPortals &dp, const DungeonData &dd, IVec2 cell,
+                                        std::vector<std::vector<VirtualEdge>> &edges, size_t topLevel, uint32_t self)
+{
+  const size_t split = dp.tileSplit;
+  edges.resize(hier.levels.size());
+  for (std::vector<VirtualEdge> &levelEdges : edges)
+    levelEdges.clear();
+
+  const IVec2 limMin{int(size_t(cell.x) / split * split), int(size_t(cell.y) / split * split)};
+  m_dist.assign(split * split, infDist);
+  m_queue.clear();
+  if (dd.tiles[size_t(cell.y) * dd.width + size_t(cell.x)] != dungeon::wall)
+  {
+    const uint32_t local = uint32_t(size_t(cell.y - limMin.y) * split + size_t(cell.x - limMin.x));
+    m_dist[local] = 0;
+    m_queue.push_back(local);
+  }
+  for (size_t head = 0; head < m_queue.size(); ++head)
+  {
+    const uint32_t cur = m_queue[head];
+    const int x = int(cur % split);
+    const int y = int(cur / split);
+    auto visit = [&](int nx, int ny)
+    {
+      if (nx < 0 || ny < 0 || nx >= int(split) || ny >= int(split))
+        return;
+      const size_t local = size_t(ny) * split + size_t(nx);
+      if (m_dist[local] != infDist || dd.tiles[size_t(limMin.y + ny) * dd.width + size_t(limMin.x + nx)] == dungeon::wall)
+        return;
+      m_dist[local] = m_dist[cur] + 1;
+      m_queue.push_back(uint32_t(local));
+    };
+    visit(x + 1, y);
+    visit(x - 1, y);
+    visit(x, y + 1);
+    visit(x, y - 1);
+  }
+  // every cell of a portal inside the cluster or none is reachable, scores are in path cells
+  const uint32_t baseCluster = cell_cluster(hier, 0, cell);
+  const PortalLevel &base = hier.levels[0];
+  for (uint32_t i = base.clusterOffsets[baseCluster]; i < base.clusterOffsets[baseCluster + 1]; ++i)
+  {
+    const PathPortal &portal = dp.portals[base.clusterPortals[i]];
+    uint32_t minDist = infDist;
+    for (size_t y = std::max(portal.startY, size_t(limMin.y)); y <= std::min(portal.endY, size_t(limMin.y) + split - 1); ++y)
+      for (size_t x = std::max(portal.startX, size_t(limMin.x)); x <= std::min(portal.endX, size_t(limMin.x) + split - 1); ++x)
+        minDist = std::min(minDist, m_dist[(y - size_t(limMin.y)) * split + (x - size_t(limMin.x))]);
+    if (minDist != infDist)
+      edges[0].push_back({base.clusterPortals[i], float(minDist + 1)});
+  }
+
+  for (size_t k = 1; k <= topLevel; ++k)
+  {
+    m_seeds.clear();
+    const uint32_t belowCluster = cell_cluster(hier, k - 1, cell);
+    for (const VirtualEdge &edge : edges[k - 1])
+      m_seeds.push_back({edge.portal, edge.score, int(self), belowCluster});
+    const uint32_t cluster = cell_cluster(hier, k, cell);
+    search(hier, dp, k - 1, cluster, npos, nullptr);
+    const PortalLevel &level = hier.levels[k];
+    for (uint32_t i = level.clusterOffsets[cluster]; i < level.clusterOffsets[cluster + 1]; ++i)
+    {
+      const uint32_t portal = level.clusterPortals[i];
+      if (m_ctx.g(portal) != std::numeric_limits<float>::max())
+        edges[k].push_back({portal, m_ctx.g(portal)});
+    }
+  }
+}
+
+bool MultiLevelPathFinder::find_path(const PortalHierarchy &hier, const DungeonPortals &dp, const DungeonData &dd, IVec2 from, IVec2 to,
+                                     size_t levelCount, const PortalLandmarks *landmarks)
+{
+  m_path.clear();
+  // tables of another graph would bound with the wrong portals, search without them
+  m_landmarks = landmarks && landmarks->revision == dp.revision && landmarks->portalCount == dp.portals.size() ? landmarks : nullptr;
+  m_last_expanded = 0;
+  m_last_level = 0;
+  assert(hier.revision == dp.revision);
+  const size_t split = dp.tileSplit;
+  auto inGrid = [&](IVec2 cell)
+  {
+    return cell.x >= 0 && cell.y >= 0 && size_t(cell.x) < dd.width / split * split && size_t(cell.y) < dd.height / split * split;
+  };
+  if (hier.levels.empty() || !inGrid(from) || !inGrid(to))
+    return false;
+  const size_t levels = levelCount == 0 ? hier.levels.size() : std::min(levelCount, hier.levels.size());
+
+  const size_t count = dp.portals.size();
+  m_start_idx = uint32_t(count);
+  m_end_idx = uint32_t(count + 1);
+  m_prevCluster.resize(count + 2);
+  m_goalStamp.resize(count + 2, 0);
+  m_goalScore.resize(count + 2);
+  m_start_portal.startX = m_start_portal.endX = size_t(from.x);
+  m_start_portal.startY = m_start_portal.endY = size_t(from.y);
+  m_end_portal.startX = m_end_portal.endX = size_t(to.x);
+  m_end_portal.startY = m_end_portal.endY = size_t(to.y);
+
+  // the coarsest level where start and goal are in different clusters
+  size_t top = 0;
+  for (size_t k = levels; k-- > 1;)
+    if (cell_cluster(hier, k, from) != cell_cluster(hier, k, to))
+    {
+      top = k;
+      break;
+    }
+  m_last_level = top;
+
+  connect_cell(hier, dp, dd, from, m_startEdges, top, m_start_idx);
+  // same cluster: the start BFS still sits in m_dist and gives the direct edge
+  float direct = -1.f;
+  if (cell_cluster(hier, 0, from) == cell_cluster(hier, 0, to))
+  {
+    const uint32_t d = m_dist[(size_t(to.y) % split) * split + size_t(to.x) % split];
+    direct = d == infDist ? -1.f : float(d + 1);
+  }
+  connect_cell(hier, dp, dd, to, m_goalEdges, top, m_end_idx);
+  // landmark row of the goal from its level 0 edges, the tightest of its levels
+  if (m_landmarks)
+  {
+    m_goalRow.assign(m_landmarks->count, PortalLandmarks::unknown);
+    for (const VirtualEdge &edge : m_goalEdges[0])
+      m_landmarks->add_edge(m_goalRow.data(), edge.portal, edge.score);
+  }
+
+  m_seeds.clear();
+  const uint32_t startCluster = cell_cluster(hier, top, from);
+  for (const VirtualEdge &edge : m_startEdges[top])
+    m_seeds.push_back({edge.portal, edge.score, int(m_start_idx), startCluster});
+  if (direct >= 0.f)
+    m_seeds.push_back({m_end_idx, direct, int(m_start_idx), startCluster});
+  set_goal_edges(m_goalEdges[top]);
+  if (!search(hier, dp, top, npos, m_end_idx, &m_steps))
+    return false;
+
+  // every edge of level k is a path over level k - 1 inside its cluster
+  for (size_t k = top; k > 0; --k)
+  {
+    m_nextSteps.assign(1, m_steps.front());
+    for (size_t i = 1; i < m_steps.size(); ++i)
+    {
+      const uint32_t u = m_steps[i - 1].node;
+      const uint32_t v = m_steps[i].node;
+      m_seeds.clear();
+      if (u == m_start_idx)
+      {
+        const uint32_t belowCluster = cell_cluster(hier, k - 1, from);
+        for (const VirtualEdge &edge : m_startEdges[k - 1])
+          m_seeds.push_back({edge.portal, edge.score, int(m_start_idx), belowCluster});
+      }
+      else
+        m_seeds.push_back({u, 0.f, -1, 0});
+      if (v == m_end_idx)
+        set_goal_edges(m_goalEdges[k - 1]);
+      if (!search(hier, dp, k - 1, m_steps[i].cluster, v, &m_subSteps))
+        return false; // can't happen, the edge was built from this very search
+      m_nextSteps.insert(m_nextSteps.end(), m_subSteps.begin() + 1, m_subSteps.end());
+    }
+    std::swap(m_steps, m_nextSteps);
+  }
+  m_path.reserve(m_steps.size());
+  for (const Step &step : m_steps)
+    m_path.push_back(int(step.node));
+  return true;
+}
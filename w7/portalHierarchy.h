@@ -0,0 +1,118 @@
+#pragma once
+#include "pathfinder.h"
+#include "portalGraph.h"
+#include "searchContext.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+struct DungeonData;
+
+// edge of one hierarchy level, cluster is the cluster of that level it runs inside
+struct LevelEdge
+{
+  uint32_t target;
+  uint32_t cluster;
+  float score;
+};
+
+// Level k groups factor^k x factor^k clusters of DungeonPortals into one. Its portals are the
+// border portals of DungeonPortals whose two sides end up in different level k clusters, its
+// edges are shortest paths over level k - 1 that stay inside one level k cluster.
+struct PortalLevel
+{
+  size_t span = 1;         // DungeonPortals clusters per side of a cluster
+  size_t clustersWidth = 0;
+  size_t clustersHeight = 0;
+  size_t portalCount = 0;
+  std::vector<uint32_t> edgeOffsets;    // indexed by DungeonPortals portal, empty if not on this level
+  std::vector<LevelEdge> edges;
+  std::vector<uint32_t> clusterOffsets; // cluster c has portals [clusterOffsets[c], clusterOffsets[c + 1])
+  std::vector<uint32_t> clusterPortals;
+
+  size_t memory_bytes() const;
+};
+
+// Level 0 is DungeonPortals itself in the same layout. Rebuild after repair_portals.
+struct PortalHierarchy
+{
+  size_t tileSplit = 0;
+  size_t factor = 0;
+  uint32_t revision = 0; // of the DungeonPortals it was built from
+  std::vector<PortalLevel> levels;
+
+  // bytes of the first `levelCount` levels
+  size_t memory_bytes(size_t levelCount) const;
+};
+
+PortalHierarchy build_portal_hierarchy(const DungeonPortals &dp, const DungeonData &dd, size_t levelCount, size_t factor = 3);
+
+// Query over a PortalHierarchy: connects start and goal to the coarsest level that separates
+// them, searches there and refines every edge level by level down to DungeonPortals.
+// The result has the same shape as HierarchicalPathFinder::get_path: DungeonPortals indices with
+// a virtual start and end portal right past them. Reentrant like HierarchicalPathFinder.
+// Only the benchmark builds a hierarchy for now, the game still searches the one level graph.
+class MultiLevelPathFinder
+{
+  struct VirtualEdge
+  {
+    uint32_t portal;
+    float score;
+  };
+  struct Seed
+  {
+    uint32_t node;
+    float g;
+    int prev;
+    uint32_t cluster;
+  };
+  struct Step
+  {
+    uint32_t node;
+    uint32_t cluster; // of the edge leading to node, on the level of the path
+  };
+
+  SearchContext m_ctx;
+  std::vector<uint32_t> m_prevCluster;
+  std::vector<uint32_t> m_goalStamp; // == m_goalGeneration if the node has an edge into the goal
+  std::vector<float> m_goalScore;
+  uint32_t m_goalGeneration = 0;
+  std::vector<std::vector<VirtualEdge>> m_startEdges; // per level
+  std::vector<std::vector<VirtualEdge>> m_goalEdges;
+  std::vector<Seed> m_seeds;
+  std::vector<Step> m_steps;
+  std::vector<Step> m_subSteps;
+  std::vector<Step> m_nextSteps;
+  std::vector<uint32_t> m_dist;
+  std::vector<uint32_t> m_queue;
+  PathPortal m_start_portal;
+  PathPortal m_end_portal;
+  uint32_t m_start_idx = 0;
+  uint32_t m_end_idx = 0;
+  std::vector<int> m_path;
+  size_t m_last_expanded = 0;
+  size_t m_last_level = 0;
+  const PortalLandmarks *m_landmarks = nullptr;
+  std::vector<uint32_t> m_goalRow; // landmark row of the virtual end
+
+  // the build runs the same level search
+  friend PortalHierarchy build_portal_hierarchy(const DungeonPortals &dp, const DungeonData &dd, size_t levelCount, size_t factor);
+
+  bool search(const PortalHierarchy &hier, const DungeonPortals &dp, size_t level, uint32_t region, uint32_t target,
+              std::vector<Step> *path);
+  void connect_cell(const PortalHierarchy &hier, const DungeonPortals &dp, const DungeonData &dd, IVec2 cell,
+                    std::vector<std::vector<VirtualEdge>> &edges, size_t topLevel, uint32_t self);
+  void set_goal_edges(const std::vector<VirtualEdge> &edges);
+
+public:
+  // levelCount caps the levels used, 0 - all of them. landmarks bound every level search,
+  // without them (or built for another graph) the searches are Dijkstra
+  bool find_path(const PortalHierarchy &hier, const DungeonPortals &dp, const DungeonData &dd, IVec2 from, IVec2 to,
+                 size_t levelCount = 0, const PortalLandmarks *landmarks = nullptr);
+  const std::vector<int> &get_path() const { return m_path; }
+  const PathPortal &get_portal(const DungeonPortals &dp, size_t portal_idx) const;
+  // nodes expanded by every search of the last query, climbing and refinement included
+  size_t last_expanded() const { return m_last_expanded; }
+  // level the last query searched on
+  size_t last_level() const { return m_last_level; }
+};
@@ -98,22 +98,26 @@ static void register_roguelike_systems(flecs::world &ecs)
       {
         to = ceil_mouse_pos;
       }
-      auto dungeonQuery = ecs.query<DungeonPortals, DungeonData>();
-      dungeonQuery.each([&](DungeonPortals &dp, DungeonData &dd) {
-        h_pathfinder.find_path(dp, dd, from, to);
-        std::vector<IVec2> detailed_path = h_pathfinder.get_detailed_path(ceil_mouse_pos, dp, dd);
-        size_t from_i = 0;
-        size_t to_i = 0;
-        for (int i = 1; i < detailed_path.size(); ++i) {
-          from_i = to_i;
-          to_i = i;
-          const IVec2& from = detailed_path[from_i];
-          const IVec2& to   = detailed_path[to_i];
-          Vector2 fromCenter{(from.x + from.x + 1) * tile_size * 0.5f,
-                            (from.y + from.y + 1) * tile_size * 0.5f};
-          Vector2 toCenter{(to.x + to.x + 1) * tile_size * 0.5f,
-                          (to.y + to.y + 1) * tile_size * 0.5f};
-          DrawLineEx(fromCenter, toCenter, 3.f, BLUE);
+      auto dungeonQuery = ecs.query<DungeonPortals, const FrozenPortalGraph, const PortalLandmarks, DungeonData>();
+      dungeonQuery.each([&](DungeonPortals &dp, const FrozenPortalGraph &graph, const PortalLandmarks &landmarks, DungeonData &dd) {
+        h_pathfinder.find_path(dp, graph, dd, from, to, &landmarks);
+        // the whole way from the mouse to the end, a chunk of cells at a time
+        HierarchicalPathCursor cursor(h_pathfinder, dp, dd, ceil_mouse_pos);
+        IVec2 cells[64];
+        IVec2 prev{-1, -1};
+        for (size_t count = cursor.next(cells, 64); count > 0; count = cursor.next(cells, 64)) {
+          for (size_t i = 0; i < count; ++i) {
+            const IVec2& from = prev;
+            const IVec2& to   = cells[i];
+            prev = cells[i];
+            if (from == IVec2{-1, -1})
+              continue;
+            Vector2 fromCenter{(from.x + from.x + 1) * tile_size * 0.5f,
+                              (from.y + from.y + 1) * tile_size * 0.5f};
+            Vector2 toCenter{(to.x + to.x + 1) * tile_size * 0.5f,
+                            (to.y + to.y + 1) * tile_size * 0.5f};
+            DrawLineEx(fromCenter, toCenter, 3.f, BLUE);
+          }
         }
       });
 
@@ -131,8 +135,8 @@ static void register_roguelike_systems(flecs::world &ecs)
       for (int i = 1; i < path.size(); ++i) {
         from_i = to_i;
         to_i = i;
-        const PathPortal& from = dp.portals[path[from_i]];
-        const PathPortal& to   = dp.portals[path[to_i]];
+        const PathPortal& from = h_pathfinder.get_portal(dp, path[from_i]);
+        const PathPortal& to   = h_pathfinder.get_portal(dp, path[to_i]);
         Vector2 fromCenter{(from.startX + from.endX + 1) * tile_size * 0.5f,
                           (from.startY + from.endY + 1) * tile_size * 0.5f};
         Vector2 toCenter{(to.startX + to.endX + 1) * tile_size * 0.5f,
@@ -218,7 +222,7 @@ void init_shoot_em_up(flecs::world &ecs)
   create_player(ecs, walkableTile * tile_size, "swordsman_tex");
 }
 
-void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
+void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h, const char *portalCache)
 {
   flecs::entity wallTex = ecs.entity("wall_tex")
     .set(Texture2D{LoadTexture("assets/wall.png")});
@@ -248,7 +252,7 @@ void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
     }
   ecs.entity("camera")
   .set(HierarchicalPathFinder{});
-  prebuild_map(ecs);
+  prebuild_map(ecs, portalCache);
 }
 
 void process_game(flecs::world &ecs)
@@ -3,5 +3,5 @@
 
 void init_shoot_em_up(flecs::world &ecs);
 void process_game(flecs::world &ecs);
-void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h);
-
+// portalCache - file for the prebuilt portal graph, see prebuild_map
+void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h, const char *portalCache = nullptr);